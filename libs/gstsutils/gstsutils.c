@@ -33,6 +33,7 @@
 */
 
 #include <string.h>
+#include <glib/gstdio.h>
 #include "gstsutils.h"
 
 typedef struct _GstsutilsData
@@ -51,6 +52,18 @@ struct _GstsutilsEntry
   GstsutilsGroup ** group;
   gint num;
 };
+struct _GstsutilsCoreCache
+{
+  /* used from the streaming threads of any element instance */
+  GMutex lock;
+  GKeyFile * keyfile;
+  gchar * filename;
+  gboolean dirty;
+};
+
+#define GSTSUTILS_CORE_CACHE_KEY_SIZE "size"
+#define GSTSUTILS_CORE_CACHE_KEY_MTIME "mtime"
+#define GSTSUTILS_CORE_CACHE_KEY_LOADABLE "loadable"
 
 static gboolean
 g_string_to_boolean (const gchar * str)
@@ -734,3 +747,148 @@ void gstsutils_load_default_property(gstsutils_property * table,GstObject* dec,
       return;
 }
 
+
+GstsutilsCoreCache *gstsutils_core_cache_open (const gchar * env_name,
+    const gchar * name)
+{
+  GstsutilsCoreCache *cache;
+  const gchar *filename = NULL;
+
+  if (env_name)
+    filename = g_getenv (env_name);
+
+  /* set but empty disables the cache */
+  if (filename && filename[0] == '\0')
+    return NULL;
+
+  cache = g_new0 (GstsutilsCoreCache, 1);
+  g_mutex_init (&cache->lock);
+  if (filename)
+    cache->filename = g_strdup (filename);
+  else
+    cache->filename = g_build_filename (g_get_user_cache_dir (),
+        "gstreamer-1.0", name, NULL);
+
+  cache->keyfile = g_key_file_new ();
+  if (!g_key_file_load_from_file (cache->keyfile, cache->filename,
+          G_KEY_FILE_NONE, NULL))
+    GST_DEBUG ("core cache %s is empty", cache->filename);
+
+  return cache;
+}
+
+gboolean gstsutils_core_cache_lookup (GstsutilsCoreCache * cache,
+    const gchar * libname, gboolean * loadable)
+{
+  GStatBuf st;
+  GError *error = NULL;
+  guint64 size;
+  gint64 mtime = 0;
+  gboolean value = FALSE;
+
+  if (libname == NULL || !g_path_is_absolute (libname))
+    return FALSE;
+
+  /* a missing library can not be loaded, no need to try */
+  if (g_stat (libname, &st) != 0) {
+    *loadable = FALSE;
+    return TRUE;
+  }
+
+  if (cache == NULL)
+    return FALSE;
+
+  g_mutex_lock (&cache->lock);
+  size = g_key_file_get_uint64 (cache->keyfile, libname,
+      GSTSUTILS_CORE_CACHE_KEY_SIZE, &error);
+  if (!error)
+    mtime = g_key_file_get_int64 (cache->keyfile, libname,
+        GSTSUTILS_CORE_CACHE_KEY_MTIME, &error);
+  if (!error)
+    value = g_key_file_get_boolean (cache->keyfile, libname,
+        GSTSUTILS_CORE_CACHE_KEY_LOADABLE, &error);
+  g_mutex_unlock (&cache->lock);
+  if (error) {
+    g_error_free (error);
+    return FALSE;
+  }
+
+  if (size != (guint64) st.st_size || mtime != (gint64) st.st_mtime)
+    return FALSE;
+
+  /* written by older versions, a dependency may have been installed
+   * since then */
+  if (!value)
+    return FALSE;
+
+  *loadable = value;
+  return TRUE;
+}
+
+void gstsutils_core_cache_store (GstsutilsCoreCache * cache,
+    const gchar * libname, gboolean loadable)
+{
+  GStatBuf st;
+
+  if (cache == NULL || libname == NULL || !g_path_is_absolute (libname))
+    return;
+
+  if (g_stat (libname, &st) != 0)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  if (loadable) {
+    g_key_file_set_uint64 (cache->keyfile, libname,
+        GSTSUTILS_CORE_CACHE_KEY_SIZE, st.st_size);
+    g_key_file_set_int64 (cache->keyfile, libname,
+        GSTSUTILS_CORE_CACHE_KEY_MTIME, st.st_mtime);
+    g_key_file_set_boolean (cache->keyfile, libname,
+        GSTSUTILS_CORE_CACHE_KEY_LOADABLE, TRUE);
+    cache->dirty = TRUE;
+  } else if (g_key_file_remove_group (cache->keyfile, libname, NULL)) {
+    /* the size and mtime of the core do not change when one of its
+     * dependencies is installed, so a failure is probed again */
+    cache->dirty = TRUE;
+  }
+  g_mutex_unlock (&cache->lock);
+}
+
+void gstsutils_core_cache_sync (GstsutilsCoreCache * cache)
+{
+  gchar *dirname;
+  GError *error = NULL;
+
+  if (cache == NULL)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  if (!cache->dirty) {
+    g_mutex_unlock (&cache->lock);
+    return;
+  }
+
+  dirname = g_path_get_dirname (cache->filename);
+  g_mkdir_with_parents (dirname, 0755);
+  g_free (dirname);
+
+  /* read only root file systems are common, the cache is only a hint */
+  if (!g_key_file_save_to_file (cache->keyfile, cache->filename, &error)) {
+    GST_DEBUG ("can not write core cache %s: %s", cache->filename,
+        error->message);
+    g_error_free (error);
+  }
+  cache->dirty = FALSE;
+  g_mutex_unlock (&cache->lock);
+}
+
+void gstsutils_core_cache_close (GstsutilsCoreCache * cache)
+{
+  if (cache == NULL)
+    return;
+
+  gstsutils_core_cache_sync (cache);
+  g_key_file_free (cache->keyfile);
+  g_free (cache->filename);
+  g_mutex_clear (&cache->lock);
+  g_free (cache);
+}
@@ -124,6 +124,27 @@ gboolean gstsutils_get_value_by_index(GstsutilsGroup *group,int index, gchar** k
 gboolean gstsutils_get_value_by_key(GstsutilsGroup *group,gchar * key, gchar**value_out);
 void gstsutils_deinit_entry (GstsutilsEntry * entry);
 
+/* persistent record of which core libraries could be loaded, keyed by
+ * path, size and mtime, so registries do not dlopen every library of
+ * their config on each start. Only successes are kept, a failure may
+ * be a missing dependency and is probed again. env_name names an
+ * environment variable overriding the cache file, empty to disable; by
+ * default the file is name in the user cache dir. Thread safe. */
+typedef struct _GstsutilsCoreCache GstsutilsCoreCache;
+
+GstsutilsCoreCache *gstsutils_core_cache_open (const gchar * env_name,
+    const gchar * name);
+/* TRUE if the result for libname is known, relative names are never
+ * cached as dlopen searches for them */
+gboolean gstsutils_core_cache_lookup (GstsutilsCoreCache * cache,
+    const gchar * libname, gboolean * loadable);
+/* storing FALSE forgets libname */
+void gstsutils_core_cache_store (GstsutilsCoreCache * cache,
+    const gchar * libname, gboolean loadable);
+/* write back if anything was stored */
+void gstsutils_core_cache_sync (GstsutilsCoreCache * cache);
+void gstsutils_core_cache_close (GstsutilsCoreCache * cache);
+
 
 
 
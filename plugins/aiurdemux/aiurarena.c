@@ -0,0 +1,308 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurarena.c
+ *
+ * Description:    Implementation of per demuxer memory arena. Small
+ *                 parser core allocations are carved from slabs of the
+ *                 instance, larger ones go to the heap but are tracked,
+ *                 everything is released when the arena is freed.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+#include "aiurarena.h"
+
+GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
+#define GST_CAT_DEFAULT aiurdemux_debug
+
+#define AIUR_ARENA_CLASS_SIZE(cls) \
+  ((gsize)1 << ((cls) + AIUR_ARENA_MIN_SHIFT))
+
+#define AIUR_ARENA_LARGE (-1)
+
+typedef struct _AiurArenaChunk AiurArenaChunk;
+
+/* header in front of every block handed to the core */
+struct _AiurArenaChunk
+{
+  AiurArena *arena;             /* NULL for unmanaged heap block */
+  AiurArenaChunk *next;         /* free list or large list */
+  AiurArenaChunk *prev;         /* large list */
+  guint32 size;
+  gint32 cls;
+};
+
+#define AIUR_ARENA_HEADER_SIZE ((sizeof (AiurArenaChunk) + 15) & ~15)
+
+#define AIUR_ARENA_CHUNK_DATA(chunk) \
+  ((gpointer)((guint8 *)(chunk) + AIUR_ARENA_HEADER_SIZE))
+#define AIUR_ARENA_DATA_CHUNK(ptr) \
+  ((AiurArenaChunk *)((guint8 *)(ptr) - AIUR_ARENA_HEADER_SIZE))
+
+struct _AiurArena
+{
+  GMutex lock;
+  AiurArenaChunk *free_list[AIUR_ARENA_CLASSES];
+  GSList *slabs;
+  AiurArenaChunk *large;
+
+  AiurArenaStats stats;
+};
+
+static GPrivate aiur_arena_current = G_PRIVATE_INIT (NULL);
+
+static gint
+aiur_arena_size_to_class (gsize size)
+{
+  gint cls = 0;
+
+  while (AIUR_ARENA_CLASS_SIZE (cls) < size) {
+    cls++;
+    if (cls >= AIUR_ARENA_CLASSES)
+      return AIUR_ARENA_LARGE;
+  }
+  return cls;
+}
+
+/* called with lock, carve a new slab into the free list of cls */
+static gboolean
+aiur_arena_grow (AiurArena * arena, gint cls)
+{
+  gsize stride = AIUR_ARENA_HEADER_SIZE + AIUR_ARENA_CLASS_SIZE (cls);
+  guint8 *slab, *p;
+
+  slab = g_try_malloc (AIUR_ARENA_SLAB_SIZE);
+  if (slab == NULL)
+    return FALSE;
+
+  arena->slabs = g_slist_prepend (arena->slabs, slab);
+  arena->stats.slab_bytes += AIUR_ARENA_SLAB_SIZE;
+
+  for (p = slab; p + stride <= slab + AIUR_ARENA_SLAB_SIZE; p += stride) {
+    AiurArenaChunk *chunk = (AiurArenaChunk *) p;
+    chunk->arena = arena;
+    chunk->cls = cls;
+    chunk->next = arena->free_list[cls];
+    arena->free_list[cls] = chunk;
+  }
+
+  return TRUE;
+}
+
+static gpointer
+aiur_arena_alloc (AiurArena * arena, gsize size)
+{
+  AiurArenaChunk *chunk;
+  gint cls;
+
+  if (arena == NULL) {
+    chunk = g_try_malloc (AIUR_ARENA_HEADER_SIZE + size);
+    if (chunk == NULL)
+      return NULL;
+    chunk->arena = NULL;
+    chunk->cls = AIUR_ARENA_LARGE;
+    chunk->size = size;
+    return AIUR_ARENA_CHUNK_DATA (chunk);
+  }
+
+  cls = aiur_arena_size_to_class (size);
+
+  g_mutex_lock (&arena->lock);
+  if (cls == AIUR_ARENA_LARGE) {
+    chunk = g_try_malloc (AIUR_ARENA_HEADER_SIZE + size);
+    if (chunk == NULL)
+      goto fail;
+    chunk->arena = arena;
+    chunk->cls = AIUR_ARENA_LARGE;
+    chunk->prev = NULL;
+    chunk->next = arena->large;
+    if (arena->large)
+      arena->large->prev = chunk;
+    arena->large = chunk;
+    arena->stats.large_allocs++;
+  } else {
+    if ((arena->free_list[cls] == NULL) && (!aiur_arena_grow (arena, cls)))
+      goto fail;
+    chunk = arena->free_list[cls];
+    arena->free_list[cls] = chunk->next;
+    arena->stats.small_allocs++;
+  }
+  chunk->size = size;
+
+  arena->stats.current += size;
+  if (arena->stats.current > arena->stats.peak)
+    arena->stats.peak = arena->stats.current;
+  g_mutex_unlock (&arena->lock);
+
+  return AIUR_ARENA_CHUNK_DATA (chunk);
+
+fail:
+  g_mutex_unlock (&arena->lock);
+  return NULL;
+}
+
+AiurArena *
+aiur_arena_new (void)
+{
+  AiurArena *arena = g_new0 (AiurArena, 1);
+
+  g_mutex_init (&arena->lock);
+
+  return arena;
+}
+
+void
+aiur_arena_free (AiurArena * arena)
+{
+  AiurArenaChunk *chunk;
+
+  if (arena == NULL)
+    return;
+
+  if (arena->stats.current) {
+    GST_WARNING ("core memory arena released with %" G_GUINT64_FORMAT
+        " bytes in use", arena->stats.current);
+  }
+  GST_INFO ("core memory arena peak %" G_GUINT64_FORMAT " slabs %"
+      G_GUINT64_FORMAT " small %" G_GUINT64_FORMAT " large %"
+      G_GUINT64_FORMAT, arena->stats.peak, arena->stats.slab_bytes, arena->stats.small_allocs,
+      arena->stats.large_allocs);
+
+  while ((chunk = arena->large)) {
+    arena->large = chunk->next;
+    g_free (chunk);
+  }
+  g_slist_free_full (arena->slabs, g_free);
+
+  g_mutex_clear (&arena->lock);
+  g_free (arena);
+}
+
+void
+aiur_arena_get_stats (AiurArena * arena, AiurArenaStats * stats)
+{
+  if ((arena == NULL) || (stats == NULL))
+    return;
+
+  g_mutex_lock (&arena->lock);
+  *stats = arena->stats;
+  g_mutex_unlock (&arena->lock);
+}
+
+void
+aiur_arena_set_current (AiurArena * arena)
+{
+  g_private_set (&aiur_arena_current, arena);
+}
+
+gpointer
+aiur_arena_malloc (gsize size)
+{
+  return aiur_arena_alloc (g_private_get (&aiur_arena_current), size);
+}
+
+gpointer
+aiur_arena_calloc (gsize n_elements, gsize size)
+{
+  gpointer ptr;
+
+  if ((size) && (n_elements > G_MAXSIZE / size))
+    return NULL;
+
+  ptr = aiur_arena_malloc (n_elements * size);
+  if (ptr)
+    memset (ptr, 0, n_elements * size);
+
+  return ptr;
+}
+
+gpointer
+aiur_arena_realloc (gpointer ptr, gsize size)
+{
+  AiurArenaChunk *chunk;
+  gpointer new_ptr;
+
+  if (ptr == NULL)
+    return aiur_arena_malloc (size);
+
+  chunk = AIUR_ARENA_DATA_CHUNK (ptr);
+
+  /* still fits in its size class */
+  if ((chunk->arena) && (chunk->cls != AIUR_ARENA_LARGE)
+      && (size <= AIUR_ARENA_CLASS_SIZE (chunk->cls))) {
+    g_mutex_lock (&chunk->arena->lock);
+    chunk->arena->stats.current += size;
+    chunk->arena->stats.current -= chunk->size;
+    if (chunk->arena->stats.current > chunk->arena->stats.peak)
+      chunk->arena->stats.peak = chunk->arena->stats.current;
+    chunk->size = size;
+    g_mutex_unlock (&chunk->arena->lock);
+    return ptr;
+  }
+
+  /* stay in the arena of the block, not of the calling thread */
+  new_ptr = aiur_arena_alloc (chunk->arena, size);
+  if (new_ptr == NULL)
+    return NULL;
+
+  memcpy (new_ptr, ptr, MIN (size, chunk->size));
+  aiur_arena_release (ptr);
+
+  return new_ptr;
+}
+
+void
+aiur_arena_release (gpointer ptr)
+{
+  AiurArenaChunk *chunk;
+  AiurArena *arena;
+
+  if (ptr == NULL)
+    return;
+
+  chunk = AIUR_ARENA_DATA_CHUNK (ptr);
+  arena = chunk->arena;
+
+  if (arena == NULL) {
+    g_free (chunk);
+    return;
+  }
+
+  g_mutex_lock (&arena->lock);
+  arena->stats.current -= chunk->size;
+  if (chunk->cls == AIUR_ARENA_LARGE) {
+    if (chunk->prev)
+      chunk->prev->next = chunk->next;
+    else
+      arena->large = chunk->next;
+    if (chunk->next)
+      chunk->next->prev = chunk->prev;
+    g_mutex_unlock (&arena->lock);
+    g_free (chunk);
+    return;
+  }
+  chunk->next = arena->free_list[chunk->cls];
+  arena->free_list[chunk->cls] = chunk;
+  g_mutex_unlock (&arena->lock);
+}
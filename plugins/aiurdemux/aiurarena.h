@@ -0,0 +1,67 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurarena.h
+ *
+ * Description:    Head file of per demuxer memory arena serving the
+ *                 parser core memory callbacks
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __AIURARENA_H__
+#define __AIURARENA_H__
+#include <gst/gst.h>
+
+/* small size classes are powers of 2 from 16 to 2048 bytes */
+#define AIUR_ARENA_MIN_SHIFT 4
+#define AIUR_ARENA_MAX_SHIFT 11
+#define AIUR_ARENA_CLASSES (AIUR_ARENA_MAX_SHIFT - AIUR_ARENA_MIN_SHIFT + 1)
+#define AIUR_ARENA_SLAB_SIZE 65536
+
+typedef struct _AiurArena AiurArena;
+
+typedef struct
+{
+  guint64 current;              /* bytes requested and not freed */
+  guint64 peak;
+  guint64 slab_bytes;
+  guint64 small_allocs;
+  guint64 large_allocs;
+} AiurArenaStats;
+
+AiurArena *aiur_arena_new (void);
+/* release every slab and large block, whatever is still in use */
+void aiur_arena_free (AiurArena * arena);
+void aiur_arena_get_stats (AiurArena * arena, AiurArenaStats * stats);
+
+/* arena used by allocations from the calling thread, NULL for system heap.
+ * The callbacks carry no context, so the thread calling into the core
+ * selects the arena; blocks remember their arena for free and realloc. */
+void aiur_arena_set_current (AiurArena * arena);
+
+gpointer aiur_arena_malloc (gsize size);
+gpointer aiur_arena_calloc (gsize n_elements, gsize size);
+gpointer aiur_arena_realloc (gpointer ptr, gsize size);
+void aiur_arena_release (gpointer ptr);
+
+#endif /* __AIURARENA_H__ */
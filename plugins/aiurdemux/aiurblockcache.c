@@ -0,0 +1,426 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurblockcache.c
+ *
+ * Description:    Implementation of block read-ahead cache for pull mode
+ *                 reads. Small parser reads are served from an LRU of
+ *                 aligned blocks, sequential access triggers read-ahead
+ *                 of following blocks on a worker thread.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+#include "aiurblockcache.h"
+
+GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
+#define GST_CAT_DEFAULT aiurdemux_debug
+
+enum
+{
+  AIUR_BLOCK_FREE = 0,
+  AIUR_BLOCK_LOADING,
+  AIUR_BLOCK_READY,
+};
+
+typedef struct
+{
+  guint64 index;
+  guint8 *data;
+  guint size;
+  gint state;
+  guint64 stamp;
+  gboolean prefetched;
+} AiurBlock;
+
+struct _AiurBlockCache
+{
+  guint block_size;
+  guint n_blocks;
+  AiurBlock *blocks;
+
+  AiurBlockCacheFillFunc fill;
+  gpointer user_data;
+
+  GMutex lock;
+  GCond cond;
+  guint64 tick;
+
+  /* bumped by invalidate, loads started before are dropped on arrival */
+  guint generation;
+
+  /* sequential pattern detection */
+  guint64 last_index;
+  gboolean has_last;
+
+  /* pending read-ahead request */
+  guint ra_depth;
+  guint64 ra_start;
+  guint ra_count;
+  gboolean quit;
+  gboolean paused;
+  gboolean ra_loading;
+  GThread *thread;
+
+  AiurBlockCacheStats stats;
+};
+
+static AiurBlock *
+aiur_block_cache_lookup (AiurBlockCache * cache, guint64 index)
+{
+  guint i;
+
+  for (i = 0; i < cache->n_blocks; i++) {
+    AiurBlock *block = &cache->blocks[i];
+    if ((block->state != AIUR_BLOCK_FREE) && (block->index == index))
+      return block;
+  }
+  return NULL;
+}
+
+/* least recently used block which is not in loading or being read */
+static AiurBlock *
+aiur_block_cache_victim (AiurBlockCache * cache)
+{
+  AiurBlock *victim = NULL;
+  guint i;
+
+  for (i = 0; i < cache->n_blocks; i++) {
+    AiurBlock *block = &cache->blocks[i];
+
+    if (block->state == AIUR_BLOCK_FREE)
+      return block;
+    if (block->state == AIUR_BLOCK_LOADING)
+      continue;
+    if (cache->has_last && (block->index == cache->last_index))
+      continue;
+    if ((victim == NULL) || (block->stamp < victim->stamp))
+      victim = block;
+  }
+  return victim;
+}
+
+/* called with lock, which is released during the fill */
+static gboolean
+aiur_block_cache_load (AiurBlockCache * cache, AiurBlock * block,
+    guint64 index)
+{
+  guint generation = cache->generation;
+  gint size;
+
+  block->index = index;
+  block->state = AIUR_BLOCK_LOADING;
+  block->prefetched = FALSE;
+  block->size = 0;
+
+  g_mutex_unlock (&cache->lock);
+  size = cache->fill (cache->user_data, index * cache->block_size,
+      block->data, cache->block_size);
+  g_mutex_lock (&cache->lock);
+
+  if (generation != cache->generation) {
+    /* invalidated while loading, the data may predate a flush */
+    block->state = AIUR_BLOCK_FREE;
+  } else if (size > 0) {
+    block->size = size;
+    block->state = AIUR_BLOCK_READY;
+    block->stamp = ++cache->tick;
+  } else {
+    block->state = AIUR_BLOCK_FREE;
+  }
+  g_cond_broadcast (&cache->cond);
+
+  return (block->state == AIUR_BLOCK_READY);
+}
+
+static gpointer
+aiur_block_cache_readahead_thread (gpointer data)
+{
+  AiurBlockCache *cache = (AiurBlockCache *) data;
+
+  g_mutex_lock (&cache->lock);
+  while (!cache->quit) {
+    AiurBlock *block;
+    guint64 index;
+
+    if ((cache->ra_count == 0) || cache->paused) {
+      g_cond_wait (&cache->cond, &cache->lock);
+      continue;
+    }
+
+    index = cache->ra_start++;
+    cache->ra_count--;
+
+    if (aiur_block_cache_lookup (cache, index))
+      continue;
+
+    block = aiur_block_cache_victim (cache);
+    if (block == NULL)
+      continue;
+
+    cache->ra_loading = TRUE;
+    if (aiur_block_cache_load (cache, block, index)) {
+      block->prefetched = TRUE;
+      cache->stats.readaheads++;
+    } else {
+      /* eos, upstream failure or invalidated, stop the current request */
+      cache->ra_count = 0;
+    }
+    cache->ra_loading = FALSE;
+    g_cond_broadcast (&cache->cond);
+  }
+  g_mutex_unlock (&cache->lock);
+
+  return NULL;
+}
+
+static void
+aiur_block_cache_check_sequence (AiurBlockCache * cache, guint64 index)
+{
+  gboolean sequential;
+
+  if (cache->has_last && (index == cache->last_index))
+    return;
+
+  sequential = (cache->has_last && (index == cache->last_index + 1));
+  cache->last_index = index;
+  cache->has_last = TRUE;
+
+  if (sequential && cache->ra_depth && !cache->paused) {
+    cache->ra_start = index + 1;
+    cache->ra_count = cache->ra_depth;
+    g_cond_broadcast (&cache->cond);
+  } else {
+    cache->ra_count = 0;
+  }
+}
+
+AiurBlockCache *
+aiur_block_cache_new (guint block_size, guint blocks,
+    AiurBlockCacheFillFunc fill, gpointer user_data)
+{
+  AiurBlockCache *cache;
+  guint i;
+
+  if ((block_size == 0) || (blocks == 0) || (fill == NULL))
+    return NULL;
+
+  cache = g_new0 (AiurBlockCache, 1);
+
+  cache->block_size = block_size;
+  cache->n_blocks = blocks;
+  cache->fill = fill;
+  cache->user_data = user_data;
+
+  cache->blocks = g_new0 (AiurBlock, blocks);
+  for (i = 0; i < blocks; i++) {
+    cache->blocks[i].data = g_malloc (block_size);
+  }
+
+  g_mutex_init (&cache->lock);
+  g_cond_init (&cache->cond);
+
+  /* keep at least half of the blocks for random access */
+  cache->ra_depth = blocks / 4;
+  if ((cache->ra_depth == 0) && (blocks > 1))
+    cache->ra_depth = 1;
+
+  if (cache->ra_depth) {
+    cache->thread = g_thread_new ("aiur_readahead",
+        aiur_block_cache_readahead_thread, cache);
+  }
+
+  GST_INFO ("block cache created, %d blocks of %d bytes, read-ahead %d",
+      blocks, block_size, cache->ra_depth);
+
+  return cache;
+}
+
+void
+aiur_block_cache_free (AiurBlockCache * cache)
+{
+  guint i;
+
+  if (cache == NULL)
+    return;
+
+  if (cache->thread) {
+    g_mutex_lock (&cache->lock);
+    cache->quit = TRUE;
+    g_cond_broadcast (&cache->cond);
+    g_mutex_unlock (&cache->lock);
+    g_thread_join (cache->thread);
+    cache->thread = NULL;
+  }
+
+  GST_INFO ("block cache hits %lld misses %lld read-ahead %lld (used %lld) bypass %lld",
+      cache->stats.hits, cache->stats.misses, cache->stats.readaheads,
+      cache->stats.readahead_hits, cache->stats.bypass);
+
+  for (i = 0; i < cache->n_blocks; i++) {
+    g_free (cache->blocks[i].data);
+  }
+  g_free (cache->blocks);
+
+  g_cond_clear (&cache->cond);
+  g_mutex_clear (&cache->lock);
+
+  g_free (cache);
+}
+
+gint64
+aiur_block_cache_read (AiurBlockCache * cache, guint64 offset,
+    guint8 * buffer, guint size)
+{
+  guint64 copied = 0;
+  gint ret;
+
+  if ((cache == NULL) || (buffer == NULL))
+    return -1;
+
+  /* large reads gain nothing from staging, read them directly */
+  if (size >= cache->block_size) {
+    g_mutex_lock (&cache->lock);
+    cache->stats.bypass++;
+    cache->has_last = FALSE;
+    cache->ra_count = 0;
+    g_mutex_unlock (&cache->lock);
+
+    ret = cache->fill (cache->user_data, offset, buffer, size);
+    return (ret > 0) ? ret : 0;
+  }
+
+  g_mutex_lock (&cache->lock);
+
+  while (copied < size) {
+    guint64 addr = offset + copied;
+    guint64 index = addr / cache->block_size;
+    guint pos = addr % cache->block_size;
+    guint len;
+    AiurBlock *block;
+
+    block = aiur_block_cache_lookup (cache, index);
+    while (block && (block->state == AIUR_BLOCK_LOADING)) {
+      g_cond_wait (&cache->cond, &cache->lock);
+      block = aiur_block_cache_lookup (cache, index);
+    }
+
+    if (block) {
+      cache->stats.hits++;
+      if (block->prefetched) {
+        cache->stats.readahead_hits++;
+        block->prefetched = FALSE;
+      }
+    } else {
+      cache->stats.misses++;
+      block = aiur_block_cache_victim (cache);
+      if (block == NULL) {
+        /* every block is busy, read the rest directly */
+        g_mutex_unlock (&cache->lock);
+        ret = cache->fill (cache->user_data, addr, buffer + copied,
+            size - copied);
+        g_mutex_lock (&cache->lock);
+        if (ret > 0)
+          copied += ret;
+        break;
+      }
+      if (!aiur_block_cache_load (cache, block, index))
+        break;
+    }
+
+    aiur_block_cache_check_sequence (cache, index);
+
+    if (block->size <= pos)
+      break;
+
+    len = MIN (block->size - pos, size - copied);
+    memcpy (buffer + copied, block->data + pos, len);
+    copied += len;
+    block->stamp = ++cache->tick;
+
+    /* short block means end of stream */
+    if (block->size < cache->block_size)
+      break;
+  }
+
+  g_mutex_unlock (&cache->lock);
+
+  return copied;
+}
+
+/* called with lock */
+static void
+aiur_block_cache_drop_locked (AiurBlockCache * cache)
+{
+  guint i;
+
+  /* loading blocks are freed when their fill returns */
+  cache->generation++;
+  for (i = 0; i < cache->n_blocks; i++) {
+    if (cache->blocks[i].state == AIUR_BLOCK_READY)
+      cache->blocks[i].state = AIUR_BLOCK_FREE;
+  }
+  cache->has_last = FALSE;
+  cache->ra_count = 0;
+}
+
+void
+aiur_block_cache_invalidate (AiurBlockCache * cache)
+{
+  if (cache == NULL)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  aiur_block_cache_drop_locked (cache);
+  g_mutex_unlock (&cache->lock);
+}
+
+void
+aiur_block_cache_pause (AiurBlockCache * cache, gboolean paused)
+{
+  if (cache == NULL)
+    return;
+
+  g_mutex_lock (&cache->lock);
+  cache->paused = paused;
+  if (paused) {
+    aiur_block_cache_drop_locked (cache);
+    /* the upstream read in progress must be done before we return */
+    while (cache->ra_loading)
+      g_cond_wait (&cache->cond, &cache->lock);
+  }
+  g_cond_broadcast (&cache->cond);
+  g_mutex_unlock (&cache->lock);
+}
+
+void
+aiur_block_cache_get_stats (AiurBlockCache * cache,
+    AiurBlockCacheStats * stats)
+{
+  if ((cache == NULL) || (stats == NULL))
+    return;
+
+  g_mutex_lock (&cache->lock);
+  *stats = cache->stats;
+  g_mutex_unlock (&cache->lock);
+}
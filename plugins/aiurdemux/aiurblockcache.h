@@ -0,0 +1,68 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurblockcache.h
+ *
+ * Description:    Head file of block read-ahead cache for pull mode
+ *                 reads of unified parser gstreamer plugin
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __AIURBLOCKCACHE_H__
+#define __AIURBLOCKCACHE_H__
+#include <gst/gst.h>
+
+#define AIUR_BLOCK_CACHE_BLOCK_SIZE 65536
+#define AIUR_BLOCK_CACHE_BLOCKS 16
+
+/* fill data of [offset, offset+size) into data, return bytes filled,
+ * 0 or negative on eos/error. Called from reader and read-ahead thread. */
+typedef gint (*AiurBlockCacheFillFunc) (gpointer user_data, guint64 offset,
+    guint8 * data, guint size);
+
+typedef struct _AiurBlockCache AiurBlockCache;
+
+typedef struct
+{
+  guint64 hits;
+  guint64 misses;
+  guint64 readaheads;
+  guint64 readahead_hits;
+  guint64 bypass;
+} AiurBlockCacheStats;
+
+AiurBlockCache *aiur_block_cache_new (guint block_size, guint blocks,
+    AiurBlockCacheFillFunc fill, gpointer user_data);
+void aiur_block_cache_free (AiurBlockCache * cache);
+
+gint64 aiur_block_cache_read (AiurBlockCache * cache, guint64 offset,
+    guint8 * buffer, guint size);
+/* drop cached blocks, loads in progress are dropped when they return */
+void aiur_block_cache_invalidate (AiurBlockCache * cache);
+/* pausing invalidates and waits for a read-ahead in progress, no read-ahead
+ * is issued until resumed. Reads of the caller still fill blocks. */
+void aiur_block_cache_pause (AiurBlockCache * cache, gboolean paused);
+void aiur_block_cache_get_stats (AiurBlockCache * cache,
+    AiurBlockCacheStats * stats);
+
+#endif /* __AIURBLOCKCACHE_H__ */
@@ -21,11 +21,18 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "aiurcontent.h"
+#include "aiuridxtab.h"
+#include "aiurarena.h"
 
 GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
 #define GST_CAT_DEFAULT aiurdemux_debug
 
+#define AIUR_CONTENT_FINGERPRINT_SIZE 65536
+
 typedef struct{
   const gchar *protocol;
   guint32 flags;
@@ -50,6 +57,9 @@ typedef struct
   gint64 offset;
   gboolean seekable;
   void *cache;
+  /* window of the mapping advised to the kernel for this handle */
+  gint64 advise_start;
+  gint64 advise_end;
 } AiurDemuxContentDesc;
 
 struct _AiurContent
@@ -65,8 +75,37 @@ struct _AiurContent
     gint64 duration;
 
     gchar * index_file;
+    gboolean index_file_checked;
+    gchar * fingerprint;
+    gboolean fingerprint_checked;
+
+    /* local file read without a sink pad, e.g. by the probe */
+    gboolean local;
+    gint fd;
+
+    /* read only view of a local file upstream reads from */
+    guint8 *map;
+    gsize map_size;
+    gboolean map_owner;
+    guint map_readahead;
+    glong page_size;
     GstPad *sinkpad;
     GstAiurStreamCache *stream_cache;
+    AiurBlockCache *block_cache;
+    AiurSamplePool *sample_pool;
+
+    /* reader progress of index build context */
+    volatile gint read_progress;
+    volatile gint cancelled;
+    /* a read failed or came back short before the end, sticky */
+    volatile gint read_error;
+
+    /* bytes the core may still read, streaming thread only */
+    gboolean read_limited;
+    guint64 read_limit;
+    gboolean read_limit_hit;
+
+    AiurContentIoStats io_stats;
 };
 
 /* memory callbacks */
@@ -80,7 +119,7 @@ aiurcontent_callback_malloc (uint32 size)
     GST_WARNING ("Try mallo 0 size buffer, maybe a core parser bug!");
   }
 
-  memory = g_try_malloc (size);
+  memory = aiur_arena_malloc (size);
   return memory;
 }
 
@@ -95,11 +134,7 @@ aiurcontent_callback_calloc (uint32 numElements, uint32 size)
     GST_WARNING ("Try callo 0 size buffer, maybe a core parser bug!");
   }
 
-  memory = g_try_malloc (numElements * size);
-
-  if (memory) {
-    memset (memory, 0, numElements * size);
-  }
+  memory = aiur_arena_calloc (numElements, size);
 
   return memory;
 }
@@ -115,7 +150,7 @@ aiurcontent_callback_realloc (void *ptr, uint32 size)
     GST_WARNING ("Try realloc 0 size buffer, maybe a core parser bug!");
   }
 
-  memory = g_try_realloc (ptr, size);
+  memory = aiur_arena_realloc (ptr, size);
 
   return memory;
 }
@@ -125,7 +160,7 @@ void
 aiurcontent_callback_free (void *ptr)
 {
   if (ptr) {
-    g_free (ptr);
+    aiur_arena_release (ptr);
   } else {
     GST_WARNING ("Try free NULL buffer, maybe a core parser bug!");
   }
@@ -164,27 +199,37 @@ aiurcontent_callback_close_pull (FslFileHandle handle, void *context)
 }
 
 
-uint32
-aiurcontent_callback_read_pull (FslFileHandle handle, void *buffer, uint32 size,
-    void *context)
+static gint
+aiurcontent_pull_data (gpointer user_data, guint64 offset, guint8 * data,
+    guint size)
 {
   GstBuffer *gstbuffer = NULL;
-  AiurDemuxContentDesc *content = (AiurDemuxContentDesc *) handle;
-  AiurContent *pContent = (AiurContent *) context;
+  AiurContent *pContent = (AiurContent *) user_data;
   GstFlowReturn ret;
-  gint32 read_size = 0;
+  gint read_size = 0;
   GstMapInfo map;
-  if ((content == NULL) || (size == 0))
+
+  /* read-ahead may go past the end */
+  if ((pContent->length > 0) && (offset >= (guint64) pContent->length))
     return 0;
 
-  ret = gst_pad_pull_range (pContent->sinkpad, content->offset,
-      size, &gstbuffer);
+  if (pContent->map) {
+    read_size = MIN ((guint64) size, pContent->map_size - offset);
+    memcpy (data, pContent->map + offset, read_size);
+    return read_size;
+  }
+
+  if (pContent->local) {
+    read_size = pread (pContent->fd, data, size, offset);
+    return (read_size > 0) ? read_size : 0;
+  }
+
+  ret = gst_pad_pull_range (pContent->sinkpad, offset, size, &gstbuffer);
 
   if (ret == GST_FLOW_OK) {
     gst_buffer_map (gstbuffer, &map, GST_MAP_READ);
-    read_size = map.size;
-    content->offset += read_size;
-    memcpy (buffer, map.data, read_size);
+    read_size = MIN (map.size, size);
+    memcpy (data, map.data, read_size);
     gst_buffer_unmap (gstbuffer, &map);
     gst_buffer_unref (gstbuffer);
   } else {
@@ -194,6 +239,86 @@ aiurcontent_callback_read_pull (FslFileHandle handle, void *buffer, uint32 size,
   return read_size;
 }
 
+/* advise the kernel to read ahead of this handle, again once it has
+ * consumed half of the window or moved out of it */
+static void
+aiurcontent_map_advise (AiurContent * pContent, AiurDemuxContentDesc * content)
+{
+  gint64 start, end;
+
+  if ((pContent->map_readahead == 0)
+      || ((content->offset >= content->advise_start)
+          && (content->offset + pContent->map_readahead / 2 <
+              content->advise_end)))
+    return;
+
+  start = content->offset & ~((gint64) pContent->page_size - 1);
+  end = MIN (content->offset + pContent->map_readahead,
+      (gint64) pContent->map_size);
+  if (end <= start)
+    return;
+
+  madvise (pContent->map + start, end - start, MADV_WILLNEED);
+  content->advise_start = start;
+  content->advise_end = end;
+  pContent->io_stats.advises++;
+}
+
+uint32
+aiurcontent_callback_read_pull (FslFileHandle handle, void *buffer, uint32 size,
+    void *context)
+{
+  AiurDemuxContentDesc *content = (AiurDemuxContentDesc *) handle;
+  AiurContent *pContent = (AiurContent *) context;
+  gint64 read_size = 0;
+  if ((content == NULL) || (size == 0))
+    return 0;
+
+  if (g_atomic_int_get (&pContent->cancelled)) {
+    g_atomic_int_set (&pContent->read_error, TRUE);
+    return 0;
+  }
+
+  /* refused on purpose, not an error of the file */
+  if (pContent->read_limited) {
+    if (size > pContent->read_limit) {
+      pContent->read_limit_hit = TRUE;
+      return 0;
+    }
+    pContent->read_limit -= size;
+  }
+
+  if (pContent->map)
+    aiurcontent_map_advise (pContent, content);
+
+  if (pContent->block_cache)
+    read_size = aiur_block_cache_read (pContent->block_cache,
+        content->offset, buffer, size);
+  else
+    read_size = aiurcontent_pull_data (pContent, content->offset, buffer, size);
+
+  if (read_size < 0)
+    read_size = 0;
+
+  /* flushing or failing upstream reads look like a short read */
+  if ((read_size < size) && ((pContent->length <= 0)
+          || (content->offset + read_size < pContent->length)))
+    g_atomic_int_set (&pContent->read_error, TRUE);
+
+  content->offset += read_size;
+
+  pContent->io_stats.reads++;
+  pContent->io_stats.read_bytes += read_size;
+
+  if ((pContent->length > 0)
+      && (content->offset * 100 / pContent->length >
+          g_atomic_int_get (&pContent->read_progress)))
+    g_atomic_int_set (&pContent->read_progress,
+        content->offset * 100 / pContent->length);
+
+  return read_size;
+}
+
 
 int32
 aiurcontent_callback_seek_pull (FslFileHandle handle, int64 offset,
@@ -236,6 +361,9 @@ aiurcontent_callback_seek_pull (FslFileHandle handle, int64 offset,
     content->offset = newoffset;
   }
 
+  if (context)
+    ((AiurContent *) context)->io_stats.seeks++;
+
   return ret;
 }
 
@@ -341,6 +469,9 @@ aiurcontent_callback_read_push (FslFileHandle handle, void *buffer, uint32 size,
       content->offset += readsize;
     }
 
+    pContent->io_stats.reads++;
+    pContent->io_stats.read_bytes += ret;
+
   }
 
   return ret;
@@ -357,6 +488,10 @@ aiurcontent_callback_seek_push (FslFileHandle handle, int64 offset,
   if (handle) {
     AiurDemuxContentDesc *content = (AiurDemuxContentDesc *) handle;
     int64 newoffset = content->offset;
+
+    if (context)
+      ((AiurContent *) context)->io_stats.seeks++;
+
     switch (whence) {
       case SEEK_SET:
         newoffset = offset;
@@ -462,7 +597,10 @@ aiurcontent_callback_request_buffer (uint32 stream_idx, uint32 * size,
     *size = AIURDEMUX_MIN_OUTPUT_BUFFER_SIZE;
   }
 
-  if (TRUE) {
+  if (pContent->sample_pool) {
+    gstbuf = aiur_sample_pool_acquire (pContent->sample_pool, *size);
+    *bufContext = gstbuf;
+  } else if (TRUE) {
     gstbuf = gst_buffer_new_and_alloc (*size);
     *bufContext = gstbuf;
   } else {
@@ -526,6 +664,63 @@ bail:
 
 }
 
+/* size plus crc32c of head and tail, survives moves and re-mounts */
+static gchar* aiurcontent_generate_fingerprint(AiurContent * pContent)
+{
+    guint64 length;
+    guint32 crc[2] = {0, 0};
+    guint64 offset[2];
+    guint8 *data;
+    guint size;
+    gint i;
+
+    if(pContent->length <= 0)
+        return NULL;
+
+    if(!pContent->local && (!pContent->sinkpad
+        || GST_PAD_MODE (pContent->sinkpad) != GST_PAD_MODE_PULL))
+        return NULL;
+
+    length = pContent->length;
+    size = MIN (length, AIUR_CONTENT_FINGERPRINT_SIZE);
+    offset[0] = 0;
+    offset[1] = length - size;
+
+    data = g_malloc (size);
+
+    for (i = 0; i < 2; i++) {
+        if (aiurcontent_pull_data (pContent, offset[i], data, size) != size) {
+            g_free (data);
+            return NULL;
+        }
+        crc[i] = aiurdemux_crc32c (0, data, size);
+    }
+
+    g_free (data);
+
+    return g_strdup_printf ("%016llx-%08x-%08x", length, crc[0], crc[1]);
+}
+
+static gchar* aiurcontent_get_fingerprint(AiurContent * pContent)
+{
+    if(!pContent->fingerprint_checked){
+        pContent->fingerprint_checked = TRUE;
+        pContent->fingerprint = aiurcontent_generate_fingerprint(pContent);
+    }
+
+    return pContent->fingerprint;
+}
+
+static gchar* aiurcontent_get_cache_dir(void)
+{
+    gchar *prefix = (gchar *)getenv ("HOME");
+
+    if (prefix == NULL)
+        prefix = "";
+
+    return g_strdup_printf ("%s/.aiur", prefix);
+}
+
 static void
 aiurcontent_check_adaptive_playback (AiurContent *pContent)
 {
@@ -565,7 +760,6 @@ static void aiurcontent_query_content_info (AiurContent *pContent)
 {
   GstQuery *q;
   GstFormat fmt;
-  gchar *prefix;
 
   GstPad *pad = pContent->sinkpad;
 
@@ -618,24 +812,6 @@ static void aiurcontent_query_content_info (AiurContent *pContent)
 
   gst_object_unref (GST_OBJECT_CAST (pad));
 
-  prefix = (gchar *)getenv ("HOME");
-
-  if (prefix == NULL)
-    prefix = "";
-
-  prefix = g_strdup_printf ("%s/.aiur", prefix);
-
-
-  pContent->index_file = aiurcontent_generate_idx_file(pContent,prefix);
-
-
-    if (pContent->index_file) {
-      umask (0);
-      if (mkdir (prefix, 0777))
-        GST_DEBUG("can not mkdir %s ", prefix);
-    }
-  g_free (prefix);
-
 }
 static void aiurcontent_set_flag (AiurContent *pContent)
 {
@@ -698,12 +874,24 @@ void aiurcontent_release(AiurContent *pContent)
     if(pContent == NULL)
         return;
 
+    if(pContent->block_cache)
+        aiur_block_cache_free (pContent->block_cache);
+
     if(pContent->uri)
         g_free (pContent->uri);
 
     if(pContent->index_file)
         g_free (pContent->index_file);
 
+    if(pContent->fingerprint)
+        g_free (pContent->fingerprint);
+
+    if(pContent->local && pContent->fd >= 0)
+        close (pContent->fd);
+
+    if(pContent->map && pContent->map_owner)
+        munmap (pContent->map, pContent->map_size);
+
     if(pContent)
         g_free(pContent);
 }
@@ -778,6 +966,280 @@ int aiurcontent_init(AiurContent * pContent,GstPad *sinkpad,GstAiurStreamCache *
     aiurcontent_set_flag(pContent);
 
 
+    return 0;
+}
+int aiurcontent_init_file(AiurContent * pContent,const gchar *location)
+{
+    struct stat st;
+    gchar *uri;
+
+    if(!pContent || location == NULL)
+        return -1;
+
+    pContent->fd = open (location, O_RDONLY);
+    if(pContent->fd < 0)
+        return -1;
+
+    if(fstat (pContent->fd, &st) || !S_ISREG (st.st_mode)){
+        close (pContent->fd);
+        pContent->fd = -1;
+        return -1;
+    }
+
+    pContent->local = TRUE;
+    pContent->length = st.st_size;
+    pContent->seekable = TRUE;
+
+    uri = gst_filename_to_uri (location, NULL);
+    if(uri){
+        pContent->uri = g_uri_unescape_string (uri, NULL);
+        g_free (uri);
+    }
+
+    aiurcontent_set_flag(pContent);
+
+    return 0;
+}
+/* TRUE when the uri source feeds the sink pad itself, through bins and
+ * typefind only, so the file holds the bytes a pull would return */
+static gboolean aiurcontent_upstream_is_source(AiurContent * pContent)
+{
+    GstPad *pad, *next;
+    GstElement *element;
+    GstElementFactory *factory;
+    gboolean ret = FALSE;
+
+    if(!pContent->sinkpad)
+        return FALSE;
+
+    pad = gst_pad_get_peer (pContent->sinkpad);
+    while(pad){
+        if(GST_IS_GHOST_PAD (pad)){
+            /* source pad of a bin */
+            next = gst_ghost_pad_get_target (GST_GHOST_PAD (pad));
+            gst_object_unref (pad);
+            pad = next;
+            continue;
+        }
+        if(GST_IS_PROXY_PAD (pad)){
+            /* inside of a bin sink pad */
+            GstProxyPad *ghost = gst_proxy_pad_get_internal (GST_PROXY_PAD (pad));
+            gst_object_unref (pad);
+            pad = NULL;
+            if(ghost){
+                pad = gst_pad_get_peer (GST_PAD (ghost));
+                gst_object_unref (ghost);
+            }
+            continue;
+        }
+
+        element = gst_pad_get_parent_element (pad);
+        gst_object_unref (pad);
+        pad = NULL;
+        if(!element)
+            break;
+
+        factory = gst_element_get_factory (element);
+        if(factory && !strcmp (GST_OBJECT_NAME (factory), "typefind")){
+            GstPad *sink = gst_element_get_static_pad (element, "sink");
+            if(sink){
+                pad = gst_pad_get_peer (sink);
+                gst_object_unref (sink);
+            }
+        }else if(GST_IS_URI_HANDLER (element)
+            && gst_uri_handler_get_uri_type (GST_URI_HANDLER (element)) == GST_URI_SRC){
+            gchar *uri = gst_uri_handler_get_uri (GST_URI_HANDLER (element));
+            if(uri){
+                gchar *unescaped = g_uri_unescape_string (uri, NULL);
+                ret = (unescaped && !strcmp (unescaped, pContent->uri));
+                g_free (unescaped);
+                g_free (uri);
+            }
+        }
+        gst_object_unref (element);
+    }
+
+    if(pad)
+        gst_object_unref (pad);
+
+    return ret;
+}
+int aiurcontent_enable_mmap(AiurContent * pContent,guint readahead)
+{
+    struct stat st;
+    const gchar *location;
+    void *map;
+    gint fd;
+
+    if(!pContent || !pContent->uri || pContent->length <= 0 || pContent->map)
+        return -1;
+
+    /* uri is unescaped already, only plain local paths are mapped */
+    if(!g_str_has_prefix (pContent->uri, "file:///"))
+        return -1;
+    location = pContent->uri + strlen ("file://");
+
+    /* an element in between may transform the bytes at the same size */
+    if(!aiurcontent_upstream_is_source (pContent)){
+        GST_DEBUG("%s is not read directly upstream, not mapped", location);
+        return -1;
+    }
+
+    fd = open (location, O_RDONLY);
+    if(fd < 0)
+        return -1;
+
+    /* must be the file upstream reads, a growing or replaced file stays
+     * on the pad */
+    if(fstat (fd, &st) || !S_ISREG (st.st_mode)
+        || st.st_size != pContent->length
+        || (guint64) st.st_size > G_MAXSIZE){
+        close (fd);
+        return -1;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if(map == MAP_FAILED){
+        GST_DEBUG("can not map %s", location);
+        return -1;
+    }
+
+    pContent->map = map;
+    pContent->map_size = st.st_size;
+    pContent->map_owner = TRUE;
+    pContent->map_readahead = readahead;
+    pContent->page_size = sysconf (_SC_PAGESIZE);
+
+    /* read-ahead is advised per handle, fault-around would only guess */
+    if(readahead)
+        madvise (map, st.st_size, MADV_RANDOM);
+
+    GST_INFO("serve reads of %s from a mapping", location);
+
+    return 0;
+}
+gboolean aiurcontent_is_mapped(AiurContent * pContent)
+{
+    if(!pContent)
+        return FALSE;
+
+    return (pContent->map != NULL);
+}
+int aiurcontent_enable_block_cache(AiurContent * pContent,guint block_size,guint blocks)
+{
+    if(!pContent)
+        return -1;
+
+    if(pContent->block_cache){
+        aiur_block_cache_free (pContent->block_cache);
+        pContent->block_cache = NULL;
+    }
+
+    if(block_size == 0 || blocks == 0)
+        return 0;
+
+    pContent->block_cache = aiur_block_cache_new (block_size, blocks,
+        aiurcontent_pull_data, pContent);
+
+    return (pContent->block_cache ? 0 : -1);
+}
+void aiurcontent_pause_read_ahead(AiurContent * pContent,gboolean paused)
+{
+    if(pContent)
+        aiur_block_cache_pause (pContent->block_cache, paused);
+}
+gboolean aiurcontent_get_block_cache_stats(AiurContent * pContent,AiurBlockCacheStats *stats)
+{
+    if(!pContent || !pContent->block_cache || !stats)
+        return FALSE;
+
+    aiur_block_cache_get_stats (pContent->block_cache, stats);
+    return TRUE;
+}
+AiurContent *aiurcontent_new_index_context(AiurContent * pContent)
+{
+    AiurContent *pIndex;
+
+    if(!pContent)
+        return NULL;
+
+    /* reads go to the pad or the shared mapping, no uri/index/cache is
+     * shared */
+    pIndex = g_new0 (AiurContent, 1);
+    pIndex->length = pContent->length;
+    pIndex->seekable = pContent->seekable;
+    pIndex->random_access = pContent->random_access;
+    pIndex->flags = pContent->flags;
+    pIndex->duration = pContent->duration;
+    pIndex->sinkpad = pContent->sinkpad;
+
+    /* the index context is released before the content */
+    pIndex->map = pContent->map;
+    pIndex->map_size = pContent->map_size;
+    pIndex->map_readahead = pContent->map_readahead;
+    pIndex->page_size = pContent->page_size;
+
+    return pIndex;
+}
+gint aiurcontent_get_read_progress(AiurContent * pContent)
+{
+    if(!pContent)
+        return 0;
+
+    return g_atomic_int_get (&pContent->read_progress);
+}
+gboolean aiurcontent_get_io_stats(AiurContent * pContent,AiurContentIoStats *stats)
+{
+    if(!pContent || !stats)
+        return FALSE;
+
+    *stats = pContent->io_stats;
+    return TRUE;
+}
+void aiurcontent_cancel(AiurContent * pContent)
+{
+    if(pContent)
+        g_atomic_int_set (&pContent->cancelled, TRUE);
+}
+gboolean aiurcontent_is_cancelled(AiurContent * pContent)
+{
+    if(!pContent)
+        return FALSE;
+
+    return g_atomic_int_get (&pContent->cancelled);
+}
+void aiurcontent_set_read_limit(AiurContent * pContent,gboolean limited,guint64 limit)
+{
+    if(!pContent)
+        return;
+
+    pContent->read_limited = limited;
+    pContent->read_limit = limit;
+    pContent->read_limit_hit = FALSE;
+}
+gboolean aiurcontent_read_limit_hit(AiurContent * pContent)
+{
+    if(!pContent)
+        return FALSE;
+
+    return pContent->read_limit_hit;
+}
+gboolean aiurcontent_has_read_error(AiurContent * pContent)
+{
+    if(!pContent)
+        return FALSE;
+
+    return g_atomic_int_get (&pContent->read_error);
+}
+int aiurcontent_set_sample_pool(AiurContent * pContent,AiurSamplePool *pool)
+{
+    if(!pContent)
+        return -1;
+
+    /* pool is owned by demuxer and outlives the content */
+    pContent->sample_pool = pool;
+
     return 0;
 }
 gboolean aiurcontent_is_live(AiurContent * pContent)
@@ -831,13 +1293,60 @@ gchar* aiurcontent_get_url(AiurContent * pContent)
 }
 gchar* aiurcontent_get_index_file(AiurContent * pContent)
 {
+    gchar *prefix;
+    gchar *fingerprint;
+
     if(!pContent)
         return NULL;
 
+    if(!pContent->index_file && !pContent->index_file_checked){
+        pContent->index_file_checked = TRUE;
+
+        prefix = aiurcontent_get_cache_dir();
+
+        fingerprint = aiurcontent_get_fingerprint(pContent);
+        if(fingerprint){
+            pContent->index_file = g_strdup_printf ("%s/%s.%s", prefix,
+                fingerprint, "aidx");
+        }else{
+            /* push mode can not read ahead, fall back to path key */
+            pContent->index_file = aiurcontent_generate_idx_file(pContent,prefix);
+        }
+
+        if (pContent->index_file) {
+            umask (0);
+            if (mkdir (prefix, 0777))
+                GST_DEBUG("can not mkdir %s ", prefix);
+        }
+        g_free (prefix);
+    }
+
     if(pContent->index_file)
         return pContent->index_file;
     else
         return NULL;
 
 }
+gchar* aiurcontent_get_probe_file(AiurContent * pContent)
+{
+    gchar *prefix;
+    gchar *fingerprint;
+    gchar *probe_file;
+
+    if(!pContent)
+        return NULL;
+
+    fingerprint = aiurcontent_get_fingerprint(pContent);
+    if(!fingerprint)
+        return NULL;
+
+    prefix = aiurcontent_get_cache_dir();
+    probe_file = g_strdup_printf ("%s/%s.%s", prefix, fingerprint, "aprobe");
 
+    umask (0);
+    if (mkdir (prefix, 0777))
+        GST_DEBUG("can not mkdir %s ", prefix);
+    g_free (prefix);
+
+    return probe_file;
+}
@@ -21,12 +21,23 @@
 #define __AIURCONTENT_H__
 #include <gst/gst.h>
 #include "aiurstreamcache.h"
+#include "aiurblockcache.h"
+#include "aiursamplepool.h"
 #include "fsl_parser.h"
 
 #define AIURDEMUX_MIN_OUTPUT_BUFFER_SIZE 8
 
 typedef struct _AiurContent AiurContent;
 
+/* file callbacks issued by the parser core */
+typedef struct
+{
+  guint64 reads;
+  guint64 read_bytes;
+  guint64 seeks;
+  guint64 advises;              /* read-ahead hints on a mapped file */
+} AiurContentIoStats;
+
 int aiurcontent_new(AiurContent **pContent);
 void aiurcontent_release(AiurContent *pContent);
 
@@ -37,6 +48,30 @@ int aiurcontent_get_memory_callback(AiurContent * pContent,ParserMemoryOps *mem_
 int aiurcontent_get_buffer_callback(AiurContent * pContent,ParserOutputBufferOps *file_cbks);
 
 int aiurcontent_init(AiurContent * pContent,GstPad *sinkpad,GstAiurStreamCache *stream_cache);
+/* read a local file directly, pull callbacks only */
+int aiurcontent_init_file(AiurContent * pContent,const gchar *location);
+/* serve pull reads of a local regular file from a mapping, readahead
+ * bytes are advised ahead of each handle; -1 keeps reads on the pad */
+int aiurcontent_enable_mmap(AiurContent * pContent,guint readahead);
+gboolean aiurcontent_is_mapped(AiurContent * pContent);
+int aiurcontent_enable_block_cache(AiurContent * pContent,guint block_size,guint blocks);
+/* no upstream read-ahead from the cache thread while the pad flushes or
+ * deactivates, returns once the one in progress is done */
+void aiurcontent_pause_read_ahead(AiurContent * pContent,gboolean paused);
+gboolean aiurcontent_get_block_cache_stats(AiurContent * pContent,AiurBlockCacheStats *stats);
+int aiurcontent_set_sample_pool(AiurContent * pContent,AiurSamplePool *pool);
+
+/* private pull context for a second parser instance, e.g. index build */
+AiurContent *aiurcontent_new_index_context(AiurContent * pContent);
+gint aiurcontent_get_read_progress(AiurContent * pContent);
+void aiurcontent_cancel(AiurContent * pContent);
+gboolean aiurcontent_is_cancelled(AiurContent * pContent);
+gboolean aiurcontent_has_read_error(AiurContent * pContent);
+/* pull mode reads of the core beyond limit bytes return nothing, for
+ * calls which must not read unbounded data */
+void aiurcontent_set_read_limit(AiurContent * pContent,gboolean limited,guint64 limit);
+gboolean aiurcontent_read_limit_hit(AiurContent * pContent);
+gboolean aiurcontent_get_io_stats(AiurContent * pContent,AiurContentIoStats *stats);
 
 gboolean aiurcontent_is_live(AiurContent * pContent);
 gboolean aiurcontent_is_seelable(AiurContent * pContent);
@@ -45,6 +80,8 @@ gboolean aiurcontent_is_adaptive_playback(AiurContent * pContent);
 gboolean aiurcontent_is_adaptive_vod(AiurContent * pContent);
 gchar* aiurcontent_get_url(AiurContent * pContent);
 gchar* aiurcontent_get_index_file(AiurContent * pContent);
+/* newly allocated, keyed by the same fingerprint as the index file */
+gchar* aiurcontent_get_probe_file(AiurContent * pContent);
 
 
 
@@ -36,6 +36,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
 
 #include "aiurdemux.h"
 
@@ -119,7 +122,7 @@ static GstsutilsOptionEntry g_aiurdemux_option_table[] = {
         G_STRUCT_OFFSET (AiurDemuxOption, program_mask),
       "0x0", "0", "0xffffffff"},
   {PROP_INTERLEAVE_QUEUE_SIZE, "interleave-queue-size", "interleave queue size",
-        "set length of interleave queue in bytes for file read mode only",
+        "set length of interleave queue in bytes for file read mode only, a track starving another one past it is ended. With queue-budget set this is a per stream backstop, the budget holds reading first",
         G_TYPE_UINT,
         G_STRUCT_OFFSET (AiurDemuxOption, interleave_queue_size),
       "10240000", "0", G_MAXUINT_STR},
@@ -143,6 +146,112 @@ static GstsutilsOptionEntry g_aiurdemux_option_table[] = {
             G_TYPE_INT,
             G_STRUCT_OFFSET (AiurDemuxOption, low_latency_tolerance),
          "-1", "-1", G_MAXINT_STR},
+    {PROP_STREAM_CACHE_PRESERVE_SIZE, "stream-cache-preserve-size",
+            "stream cache preserve size",
+            "set bytes kept behind read position in stream cache for short backward seek, push mode only",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, stream_cache_preserve_size),
+          "200010", "0", G_MAXINT_STR},
+    {PROP_BLOCK_CACHE_BLOCK_SIZE, "block-cache-block-size",
+            "block cache block size",
+            "set block size in bytes of read-ahead cache for pull mode",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, block_cache_block_size),
+          "65536", "512", "16777216"},
+    {PROP_BLOCK_CACHE_BLOCKS, "block-cache-blocks",
+            "block cache blocks",
+            "set number of blocks of read-ahead cache for pull mode (0 to disable)",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, block_cache_blocks),
+          "16", "0", "1024"},
+    {PROP_SAMPLE_POOL_BUDGET, "sample-pool-budget", "sample pool budget",
+            "set bytes of sample buffers kept for reuse (0 to disable the pool)",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, sample_pool_budget),
+          "8388608", "0", G_MAXUINT_STR},
+    {PROP_INDEX_CACHE_BUDGET, "index-cache-budget", "index cache budget",
+            "set total bytes of index files kept on disk, least recently used are removed first (0 for no limit)",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, index_cache_budget),
+          "67108864", "0", G_MAXUINT_STR},
+    {PROP_INDEX_BUILD_ASYNC, "index-build-async", "build index in background",
+            "start playback without index when no index file is found, and build the index on a low priority thread (pull mode only)",
+            G_TYPE_BOOLEAN,
+            G_STRUCT_OFFSET (AiurDemuxOption, index_build_async),
+          "false"},
+    {PROP_INTERLEAVE_TIME_SKEW, "interleave-time-skew", "interleave time skew",
+            "set time window in ms within which track mode reads are ordered by file offset (0 to read strictly by timestamp)",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, interleave_time_skew),
+          "0", "0", "10000"},
+    {PROP_PARTIAL_SAMPLE_CONTIGUOUS, "partial-sample-contiguous",
+            "partial sample contiguous",
+            "copy fragments of a partial sample into one memory block instead of chaining them, for downstream which can not handle multi-memory buffers",
+            G_TYPE_BOOLEAN,
+            G_STRUCT_OFFSET (AiurDemuxOption, partial_sample_contiguous),
+          "false"},
+    {PROP_DISABLE_UNLINKED_TRACKS, "disable-unlinked-tracks",
+            "disable unlinked tracks",
+            "stop reading tracks whose pad is not linked, read them again once linked",
+            G_TYPE_BOOLEAN,
+            G_STRUCT_OFFSET (AiurDemuxOption, disable_unlinked_tracks),
+          "false"},
+    {PROP_STREAM_CACHE_MAX_SKIP, "stream-cache-max-skip",
+            "stream cache max skip",
+            "set max bytes of forward gap read through instead of seeking upstream, the threshold follows upstream rate and seek cost below it, push mode only",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, stream_cache_max_skip),
+          "16777216", "0", G_MAXINT_STR},
+    {PROP_ADAPTIVE_LATENCY, "adaptive-latency", "adaptive latency",
+            "follow arrival jitter of live streams with the latency, streaming_latency is the upper bound",
+            G_TYPE_BOOLEAN,
+            G_STRUCT_OFFSET (AiurDemuxOption, adaptive_latency),
+          "true"},
+    {PROP_MIN_LATENCY, "min-latency", "min latency",
+            "set the lower bound in ms of the adaptive live latency",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, min_latency),
+          "40", "0", G_MAXUINT_STR},
+    {PROP_QUEUE_BUDGET, "queue-budget", "queue budget",
+            "set bytes held by interleave queues of all streams together, reading blocks while streams above their fair share drain, 0 to disable, file read mode only. interleave-queue-size still limits each stream",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, queue_budget),
+          "16777216", "0", G_MAXUINT_STR},
+    {PROP_MAX_IMAGE_TAG_SIZE, "max-image-tag-size", "max image tag size",
+            "set the largest cover art or other image tag in bytes to extract, in pull mode images are extracted after playback starts and the core may not read much more than this for one, 0 to disable image tags",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, max_image_tag_size),
+          "2097152", "0", G_MAXUINT_STR},
+    {PROP_PUSH_THREADS, "push-threads", "push threads",
+            "push every source pad from its own thread through a bounded queue, a slow consumer then holds back only its own pad",
+            G_TYPE_BOOLEAN,
+            G_STRUCT_OFFSET (AiurDemuxOption, push_threads),
+          "false"},
+    {PROP_PUSH_QUEUE_SIZE, "push-queue-size", "push queue size",
+            "set the buffers each push thread queue holds before reading blocks, push-threads only",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, push_queue_size),
+          "64", "1", G_MAXUINT_STR},
+    {PROP_PUSH_QUEUE_SKEW, "push-queue-skew", "push queue skew",
+            "set in ms how far audio or video push threads may run ahead of each other, 0 to disable, push-threads only",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, push_queue_skew),
+          "200", "0", G_MAXUINT_STR},
+    {PROP_TRICK_FPS, "trick-fps", "trick fps",
+            "set the key frames per second shown in fast forward and rewind, sync samples in between are skipped, lower when downstream is late, 0 to show all",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, trick_fps),
+          "15", "0", "120"},
+    {PROP_MMAP, "mmap", "mmap",
+            "serve pull mode reads of a local regular file from a memory mapping instead of the upstream pad, block cache is not used then. The file must not be truncated during playback, that faults the process",
+            G_TYPE_BOOLEAN,
+            G_STRUCT_OFFSET (AiurDemuxOption, mmap),
+          "false"},
+    {PROP_MMAP_READAHEAD, "mmap-readahead", "mmap readahead",
+            "set bytes advised to the kernel ahead of each read position in a mapped file (0 to leave read-ahead to the kernel)",
+            G_TYPE_UINT,
+            G_STRUCT_OFFSET (AiurDemuxOption, mmap_readahead),
+          "1048576", "0", "67108864"},
   {-1, NULL, NULL, NULL, 0, 0, NULL}    /* terminator */
 };
 
@@ -230,6 +339,12 @@ static void
 gst_aiurdemux_push_tags (GstAiurDemux * demux, AiurDemuxStream * stream);
 static void
 gst_aiurdemux_push_event (GstAiurDemux * demux, GstEvent * event);
+static GstFlowReturn
+aiurdemux_pad_push (GstAiurDemux * demux, AiurDemuxStream * stream,
+    GstBuffer * buffer);
+static gboolean
+aiurdemux_pad_push_event (GstAiurDemux * demux, AiurDemuxStream * stream,
+    GstEvent * event);
 
 
 static GstPadTemplate *gst_aiurdemux_sink_pad_template (void);
@@ -272,6 +387,98 @@ aiurdemux_select_programs (GstAiurDemux * demux);
 
 
 static GstTagList * aiurdemux_add_user_tags (GstAiurDemux * demux);
+static gboolean aiurdemux_trick_select (GstAiurDemux * demux,
+    AiurDemuxStream * stream);
+static gboolean aiurdemux_is_image_format (gint format);
+static void aiurdemux_add_image_tags (GstAiurDemux * demux);
+
+/* reads image user data entry i into list. The core has no size query,
+ * so in pull mode its reads are bounded by max-image-tag-size instead
+ * of reading a large image only to drop it. */
+static void
+aiurdemux_read_image_tag (GstAiurDemux * demux, gint i, GstTagList ** list)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+  FslParserHandle handle = demux->core_handle;
+  uint8 *userData = NULL;
+  uint32 userDataSize = 0;
+  UserDataFormat format = g_user_data_entry[i].format;
+  gboolean limit_hit = FALSE;
+  GstSample *sample;
+  int32 core_ret;
+
+  if (demux->pullbased)
+    aiurcontent_set_read_limit (demux->content_info, TRUE,
+        (guint64) demux->option.max_image_tag_size
+        + AIURDEMUX_IMAGE_TAG_SLACK);
+  core_ret = IParser->getMetaData (handle, g_user_data_entry[i].core_tag,
+      &format, &userData, &userDataSize);
+  if (demux->pullbased) {
+    limit_hit = aiurcontent_read_limit_hit (demux->content_info);
+    aiurcontent_set_read_limit (demux->content_info, FALSE, 0);
+  }
+
+  if ((limit_hit) || ((core_ret == PARSER_SUCCESS)
+          && (userDataSize > demux->option.max_image_tag_size))) {
+    GST_INFO_OBJECT (demux, "skip image tag larger than %d bytes",
+        demux->option.max_image_tag_size);
+    demux->image_tags_skipped++;
+    return;
+  }
+
+  if ((core_ret != PARSER_SUCCESS) || (userData == NULL)
+      || (userDataSize == 0) || (!aiurdemux_is_image_format (format)))
+    return;
+
+  sample = gst_tag_image_data_to_image_sample (userData,
+      userDataSize, GST_TAG_IMAGE_TYPE_UNDEFINED);
+  if (sample) {
+    if (*list == NULL)
+      *list = gst_tag_list_new_empty ();
+
+    gst_tag_list_add (*list, GST_TAG_MERGE_APPEND,
+        g_user_data_entry[i].gst_tag_name, sample, NULL);
+
+    GST_INFO_OBJECT (demux, g_user_data_entry[i].print_string, format,userDataSize);
+
+    demux->image_tags++;
+    demux->image_tag_bytes += userDataSize;
+    gst_sample_unref (sample);
+  }
+}
+
+/* called from the streaming thread in movie state in pull mode, the
+ * core is not reentrant so images are read between samples */
+static void
+aiurdemux_add_image_tags (GstAiurDemux * demux)
+{
+  GstTagList *list = NULL;
+  int i, n;
+
+  demux->image_tags_pending = FALSE;
+
+  for (i = 0; i < G_N_ELEMENTS (g_user_data_entry); i++) {
+    if (aiurdemux_is_image_format (g_user_data_entry[i].format))
+      aiurdemux_read_image_tag (demux, i, &list);
+  }
+
+  if (list == NULL)
+    return;
+
+  if (demux->tag_list) {
+    demux->tag_list = gst_tag_list_make_writable (demux->tag_list);
+    gst_tag_list_insert (demux->tag_list, list, GST_TAG_MERGE_APPEND);
+    gst_tag_list_unref (list);
+  } else {
+    demux->tag_list = list;
+  }
+
+  /* global tags go out again with the next buffer, after the segment */
+  for (n = 0; n < demux->n_streams; n++) {
+    if (demux->streams[n]->pad)
+      demux->streams[n]->send_global_tags = TRUE;
+  }
+}
 
 static int aiurdemux_parse_streams (GstAiurDemux * demux);
 static void aiurdemux_parse_video (GstAiurDemux * demux, AiurDemuxStream * stream,
@@ -290,10 +497,20 @@ static GstFlowReturn aiurdemux_read_buffer(GstAiurDemux * demux, uint32* track_i
 static GstFlowReturn aiurdemux_parse_vorbis_codec_data(GstAiurDemux * demux, AiurDemuxStream* stream);
 
 static gint aiurdemux_choose_next_stream (GstAiurDemux * demux);
+static void aiurdemux_queue_buffer (GstAiurDemux * demux,
+    AiurDemuxStream * stream, GstBuffer * buffer);
+static GstBuffer *aiurdemux_dequeue_buffer (GstAiurDemux * demux,
+    AiurDemuxStream * stream);
+static void aiurdemux_flush_queue (GstAiurDemux * demux,
+    AiurDemuxStream * stream);
+static AiurDemuxStream *aiurdemux_queue_over_budget (GstAiurDemux * demux);
+static void aiurdemux_update_seek_stat (GstAiurDemux * demux,
+    uint32 sample_size, uint64 usStartTime);
 
 static AiurDemuxStream * aiurdemux_trackidx_to_stream (GstAiurDemux * demux, guint32 stream_idx);
 static void
 aiurdemux_check_start_offset (GstAiurDemux * demux, AiurDemuxStream * stream);
+static gboolean aiurdemux_is_live_timing (GstAiurDemux * demux);
 static void
 aiurdemux_adjust_timestamp (GstAiurDemux * demux, AiurDemuxStream * stream,
     GstBuffer * buffer);
@@ -315,6 +532,15 @@ aiurdemux_combine_flows (GstAiurDemux * demux, AiurDemuxStream * stream,
     GstFlowReturn ret);
 
 static void aiurdemux_reset_stream (GstAiurDemux * demux, AiurDemuxStream * stream);
+static void aiurdemux_disable_stream (GstAiurDemux * demux,
+    AiurDemuxStream * stream);
+static void aiurdemux_pad_linked (GstPad * pad, GstPad * peer,
+    gpointer user_data);
+static void aiurdemux_check_relink (GstAiurDemux * demux);
+
+static void aiurdemux_startup_update (GstAiurDemux * demux, gint state);
+static void aiurdemux_startup_first_buffer (GstAiurDemux * demux,
+    AiurDemuxStream * stream);
 
 
 static gboolean
@@ -340,6 +566,10 @@ aiurdemux_send_pending_events (GstAiurDemux * demux);
 static void aiurdemux_release_resource (GstAiurDemux * demux);
 static GstFlowReturn gst_aiurdemux_close_core (GstAiurDemux * demux);
 
+static gboolean aiurdemux_start_index_build (GstAiurDemux * demux);
+static void aiurdemux_check_index_build (GstAiurDemux * demux);
+static void aiurdemux_stop_index_build (GstAiurDemux * demux);
+
 
 
 #define SUBTITLE_GAP_INTERVAL (GST_SECOND/5)
@@ -390,10 +620,210 @@ static void gst_aiurdemux_set_property (GObject * object, guint prop_id,
   }
 
 }
+/* key frames shown per second of running time, with object lock */
+static gdouble
+aiurdemux_trick_fps (GstAiurDemux * demux)
+{
+  GstClockTime span;
+
+  if ((demux->trick_frames < 2)
+      || (!GST_CLOCK_TIME_IS_VALID (demux->trick_first))
+      || (!GST_CLOCK_TIME_IS_VALID (demux->trick_last)))
+    return 0.0;
+
+  span = (demux->trick_last > demux->trick_first) ?
+      demux->trick_last - demux->trick_first :
+      demux->trick_first - demux->trick_last;
+  if (span == 0)
+    return 0.0;
+
+  return (gdouble) (demux->trick_frames - 1) * demux->trick_rate
+      * GST_SECOND / span;
+}
+
+static GstStructure *aiurdemux_get_stats (GstAiurDemux * demux)
+{
+  GstStructure *stats;
+  AiurBlockCacheStats block_stats;
+  AiurSamplePoolStats pool_stats;
+  GstAiurStreamCacheStats cache_stats;
+  AiurArenaStats arena_stats;
+  AiurContentIoStats io_stats;
+  gboolean mapped = FALSE;
+  guint64 seek_rate;
+
+  stats = gst_structure_new_empty ("aiurdemux-stats");
+
+  memset (&block_stats, 0, sizeof (block_stats));
+  memset (&io_stats, 0, sizeof (io_stats));
+  GST_OBJECT_LOCK (demux);
+  if (demux->content_info) {
+    aiurcontent_get_block_cache_stats (demux->content_info, &block_stats);
+    aiurcontent_get_io_stats (demux->content_info, &io_stats);
+    mapped = aiurcontent_is_mapped (demux->content_info);
+  }
+  GST_OBJECT_UNLOCK (demux);
+
+  gst_structure_set (stats,
+      "reads", G_TYPE_UINT64, io_stats.reads,
+      "read-bytes", G_TYPE_UINT64, io_stats.read_bytes,
+      "seeks", G_TYPE_UINT64, io_stats.seeks,
+      "mmap", G_TYPE_BOOLEAN, mapped,
+      "mmap-advises", G_TYPE_UINT64, io_stats.advises, NULL);
+
+  gst_structure_set (stats,
+      "block-cache-hits", G_TYPE_UINT64, block_stats.hits,
+      "block-cache-misses", G_TYPE_UINT64, block_stats.misses,
+      "block-cache-readaheads", G_TYPE_UINT64, block_stats.readaheads,
+      "block-cache-readahead-hits", G_TYPE_UINT64, block_stats.readahead_hits,
+      "block-cache-bypass", G_TYPE_UINT64, block_stats.bypass, NULL);
+
+  seek_rate = 0;
+  if (GST_CLOCK_TIME_IS_VALID (demux->sched_time_start)
+      && GST_CLOCK_TIME_IS_VALID (demux->sched_time_last)
+      && (demux->sched_time_last > demux->sched_time_start))
+    seek_rate = gst_util_uint64_scale (demux->sched_seek_bytes, GST_SECOND,
+        demux->sched_time_last - demux->sched_time_start);
+  gst_structure_set (stats,
+      "interleave-seeks", G_TYPE_UINT64, demux->sched_seeks,
+      "interleave-seek-bytes", G_TYPE_UINT64, demux->sched_seek_bytes,
+      "interleave-seek-bytes-per-second", G_TYPE_UINT64, seek_rate, NULL);
+
+  gst_structure_set (stats,
+      "live-latency", G_TYPE_UINT64, demux->live_latency,
+      "arrival-jitter", G_TYPE_UINT64, demux->live_jitter,
+      "latency-changes", G_TYPE_UINT64, demux->live_latency_changes, NULL);
+
+  gst_structure_set (stats,
+      "tracks-disabled", G_TYPE_UINT64, demux->tracks_disabled,
+      "tracks-reenabled", G_TYPE_UINT64, demux->tracks_reenabled, NULL);
+
+  gst_structure_set (stats,
+      "queue-bytes", G_TYPE_UINT64, demux->queued_bytes,
+      "queue-bytes-peak", G_TYPE_UINT64, demux->queued_bytes_peak,
+      "queue-drains", G_TYPE_UINT64, demux->queue_drains, NULL);
+
+  gst_structure_set (stats,
+      "image-tags", G_TYPE_UINT64, demux->image_tags,
+      "image-tag-bytes", G_TYPE_UINT64, demux->image_tag_bytes,
+      "image-tags-skipped", G_TYPE_UINT64, demux->image_tags_skipped, NULL);
+
+  GST_OBJECT_LOCK (demux);
+  gst_structure_set (stats,
+      "trick-frames", G_TYPE_UINT64, demux->trick_frames,
+      "trick-skips", G_TYPE_UINT64, demux->trick_skips,
+      "trick-fps", G_TYPE_DOUBLE, aiurdemux_trick_fps (demux), NULL);
+  GST_OBJECT_UNLOCK (demux);
+
+  GST_OBJECT_LOCK (demux);
+  arena_stats = demux->arena_stats;
+  if (demux->arena)
+    aiur_arena_get_stats (demux->arena, &arena_stats);
+  GST_OBJECT_UNLOCK (demux);
+  gst_structure_set (stats,
+      "core-memory-current", G_TYPE_UINT64, arena_stats.current,
+      "core-memory-peak", G_TYPE_UINT64, arena_stats.peak,
+      "core-memory-slab-bytes", G_TYPE_UINT64, arena_stats.slab_bytes,
+      "core-memory-small-allocs", G_TYPE_UINT64, arena_stats.small_allocs,
+      "core-memory-large-allocs", G_TYPE_UINT64, arena_stats.large_allocs,
+      NULL);
+
+  memset (&cache_stats, 0, sizeof (cache_stats));
+  gst_aiur_stream_cache_get_stats (demux->stream_cache, &cache_stats);
+  gst_structure_set (stats,
+      "stream-cache-seeks", G_TYPE_UINT64, cache_stats.cache_seeks,
+      "stream-cache-backward-seeks", G_TYPE_UINT64,
+      cache_stats.backward_seeks,
+      "stream-cache-skips", G_TYPE_UINT64, cache_stats.skips,
+      "stream-cache-skipped-bytes", G_TYPE_UINT64, cache_stats.skipped_bytes,
+      "stream-cache-upstream-seeks", G_TYPE_UINT64,
+      cache_stats.upstream_seeks,
+      "stream-cache-upstream-rate", G_TYPE_UINT64, cache_stats.upstream_rate,
+      "stream-cache-seek-cost", G_TYPE_UINT64, cache_stats.seek_cost,
+      "stream-cache-skip-threshold", G_TYPE_UINT64,
+      cache_stats.skip_threshold, NULL);
+
+  memset (&pool_stats, 0, sizeof (pool_stats));
+  aiur_sample_pool_get_stats (demux->sample_pool, &pool_stats);
+  gst_structure_set (stats,
+      "sample-pool-allocs", G_TYPE_UINT64, pool_stats.allocs,
+      "sample-pool-recycles", G_TYPE_UINT64, pool_stats.recycles,
+      "sample-pool-unpooled", G_TYPE_UINT64, pool_stats.unpooled,
+      "sample-pool-bytes", G_TYPE_UINT64, pool_stats.pooled_bytes, NULL);
+
+  GST_OBJECT_LOCK (demux);
+  aiur_pad_queue_group_get_stats (demux->pad_queues, stats);
+  GST_OBJECT_UNLOCK (demux);
+
+  return stats;
+}
+
+static const gchar *aiurdemux_state_names[AIURDEMUX_STATE_NUM] = {
+  "probe", "init", "header", "movie"
+};
+
+static GstStructure *aiurdemux_get_startup_stats (GstAiurDemux * demux)
+{
+  AiurDemuxStartupStat startup;
+  GstStructure *stats;
+  GstClockTime first_buffer = 0;
+  gchar *name;
+  gint i;
+
+  GST_OBJECT_LOCK (demux);
+  startup = demux->startup;
+  GST_OBJECT_UNLOCK (demux);
+
+  stats = gst_structure_new ("GstAiurDemuxStartup",
+      "complete", G_TYPE_BOOLEAN, startup.done, NULL);
+
+  for (i = 0; i < AIURDEMUX_STATE_NUM; i++) {
+    name = g_strdup_printf ("%s-time", aiurdemux_state_names[i]);
+    gst_structure_set (stats, name, G_TYPE_UINT64, startup.state_time[i],
+        NULL);
+    g_free (name);
+    name = g_strdup_printf ("%s-reads", aiurdemux_state_names[i]);
+    gst_structure_set (stats, name, G_TYPE_UINT64, startup.state_io[i].reads,
+        NULL);
+    g_free (name);
+    name = g_strdup_printf ("%s-read-bytes", aiurdemux_state_names[i]);
+    gst_structure_set (stats, name, G_TYPE_UINT64,
+        startup.state_io[i].read_bytes, NULL);
+    g_free (name);
+    name = g_strdup_printf ("%s-seeks", aiurdemux_state_names[i]);
+    gst_structure_set (stats, name, G_TYPE_UINT64, startup.state_io[i].seeks,
+        NULL);
+    g_free (name);
+  }
+
+  /* pads which sent nothing yet are GST_CLOCK_TIME_NONE */
+  for (i = 0; i < startup.n_pads; i++) {
+    name = g_strdup_printf ("%s-first-buffer", startup.pad_name[i]);
+    gst_structure_set (stats, name, G_TYPE_UINT64, startup.first_buffer[i],
+        NULL);
+    g_free (name);
+    if (GST_CLOCK_TIME_IS_VALID (startup.first_buffer[i])
+        && (startup.first_buffer[i] > first_buffer))
+      first_buffer = startup.first_buffer[i];
+  }
+  gst_structure_set (stats,
+      "first-buffer", G_TYPE_UINT64, first_buffer, NULL);
+
+  return stats;
+}
+
 static void gst_aiurdemux_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
   GstAiurDemux *self = GST_AIURDEMUX (object);
+  if (prop_id == PROP_STATS) {
+    g_value_take_boxed (value, aiurdemux_get_stats (self));
+    return;
+  }
+  if (prop_id == PROP_STARTUP_STATS) {
+    g_value_take_boxed (value, aiurdemux_get_startup_stats (self));
+    return;
+  }
   if (gstsutils_options_get_option (g_aiurdemux_option_table,
           (gchar *) & self->option, prop_id, value) == FALSE) {
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -421,6 +851,16 @@ static void gst_aiurdemux_class_init (GstAiurDemuxClass * klass)
   gstsutils_options_install_properties_by_options (g_aiurdemux_option_table,
       gobject_class);
 
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "statistics",
+        "runtime statistics of demuxer",
+        GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STARTUP_STATS,
+      g_param_spec_boxed ("startup-stats", "startup statistics",
+        "time, reads and seeks spent in each demuxer state and time to first buffer of each pad",
+        GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_pad_template (gstelement_class,
       gst_aiurdemux_sink_pad_template ());
   gst_element_class_add_pad_template (gstelement_class,
@@ -473,6 +913,8 @@ static void gst_aiurdemux_init (GstAiurDemux * demux)
   demux->stream_cache = gst_aiur_stream_cache_new (AIUR_STREAM_CACHE_SIZE,
     AIUR_STREAM_CACHE_SIZE_MAX, demux);
 
+  demux->sample_pool = aiur_sample_pool_new (AIUR_SAMPLE_POOL_BUDGET);
+
   g_mutex_init (&demux->runmutex);
   g_mutex_init (&demux->seekmutex);
   demux->play_mode = AIUR_PLAY_MODE_NORMAL;
@@ -493,6 +935,11 @@ static void gst_aiurdemux_finalize (GObject * object)
     demux->stream_cache = NULL;
   }
 
+  if (demux->sample_pool) {
+    aiur_sample_pool_free (demux->sample_pool);
+    demux->sample_pool = NULL;
+  }
+
   g_mutex_clear (&demux->runmutex);
   g_mutex_clear (&demux->seekmutex);
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -515,8 +962,46 @@ static GstStateChangeReturn gst_aiurdemux_change_state (GstElement * element,
       demux->media_offset = 0;
       demux->avg_diff = 0;
       demux->start_time = GST_CLOCK_TIME_NONE;
+      demux->live_latency = GST_MSECOND * demux->option.streaming_latency;
+      demux->live_latency_applied = demux->live_latency;
+      demux->live_jitter = 0;
+      demux->live_jitter_samples = 0;
+      demux->live_latency_changes = 0;
+      demux->sched_pos_valid = FALSE;
+      demux->sched_offset_valid = FALSE;
+      demux->sched_seek_bytes = 0;
+      demux->sched_seeks = 0;
+      demux->sched_time_start = GST_CLOCK_TIME_NONE;
+      demux->sched_time_last = GST_CLOCK_TIME_NONE;
+      demux->tracks_disabled = 0;
+      demux->tracks_reenabled = 0;
+      demux->queued_bytes = 0;
+      demux->queued_bytes_peak = 0;
+      demux->queue_drains = 0;
+      demux->queue_level = -1;
+      demux->image_tags_pending = FALSE;
+      demux->image_tags = 0;
+      demux->image_tag_bytes = 0;
+      demux->image_tags_skipped = 0;
+      GST_OBJECT_LOCK (demux);
+      memset (&demux->startup, 0, sizeof (demux->startup));
+      demux->startup.start = gst_util_get_timestamp ();
+      demux->startup.stamp = demux->startup.start;
+      GST_OBJECT_UNLOCK (demux);
       demux->tag_list = gst_tag_list_new_empty ();
       aiurcontent_new(&demux->content_info);
+      GST_OBJECT_LOCK (demux);
+      demux->arena = aiur_arena_new ();
+      memset (&demux->arena_stats, 0, sizeof (demux->arena_stats));
+      if (demux->option.push_threads)
+        demux->pad_queues = aiur_pad_queue_group_new (
+            demux->option.push_queue_size,
+            demux->option.push_queue_skew * GST_MSECOND);
+      GST_OBJECT_UNLOCK (demux);
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* before the pads deactivate, its reads would fail short */
+      aiurdemux_stop_index_build (demux);
       break;
     default:
       GST_LOG_OBJECT(demux,"change_state transition=%x",transition);
@@ -528,6 +1013,8 @@ static GstStateChangeReturn gst_aiurdemux_change_state (GstElement * element,
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
     {
+      AiurContent *content_info;
+
       GST_DEBUG_OBJECT(demux,"change_state PAUSED_TO_READY");
       demux->state = AIURDEMUX_STATE_PROBE;
       demux->pullbased = FALSE;
@@ -538,8 +1025,19 @@ static GstStateChangeReturn gst_aiurdemux_change_state (GstElement * element,
       aiurdemux_release_resource (demux);
 
       gst_aiurdemux_close_core (demux);
-      aiurcontent_release(demux->content_info);
+      GST_OBJECT_LOCK (demux);
+      aiur_pad_queue_group_free (demux->pad_queues);
+      demux->pad_queues = NULL;
+      content_info = demux->content_info;
       demux->content_info = NULL;
+      /* core is deleted, what it still holds has leaked */
+      aiur_arena_get_stats (demux->arena, &demux->arena_stats);
+      aiur_arena_free (demux->arena);
+      demux->arena = NULL;
+      GST_OBJECT_UNLOCK (demux);
+
+      /* joins the read-ahead thread, not under the object lock */
+      aiurcontent_release(content_info);
 
       gst_segment_init (&demux->segment, GST_FORMAT_TIME);
 
@@ -793,13 +1291,33 @@ static gboolean gst_aiurdemux_handle_src_event (GstPad * pad, GstObject * parent
       break;
 
     case GST_EVENT_QOS:
+    {
+      GstQOSType type;
+      gdouble proportion;
+      GstClockTimeDiff diff;
+      GstClockTime timestamp;
+
+      /* only trick modes pick what to send by how fast downstream is */
+      gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+      GST_OBJECT_LOCK (demux);
+      if (demux->play_mode != AIUR_PLAY_MODE_NORMAL)
+        demux->trick_proportion = proportion;
+      GST_OBJECT_UNLOCK (demux);
+      res = FALSE;
+      gst_event_unref (event);
+      break;
+    }
     case GST_EVENT_NAVIGATION:
       res = FALSE;
       gst_event_unref (event);
       break;
     case GST_EVENT_LATENCY:
       gst_event_parse_latency (event, &latency);
+      /* latency answered to the query which led to this event */
+      GST_OBJECT_LOCK (demux);
       demux->pipeline_latency = latency;
+      demux->live_latency_applied = demux->live_latency;
+      GST_OBJECT_UNLOCK (demux);
       GST_LOG_OBJECT(demux,"set pipeline latency to %lld", latency);
 
       res = gst_pad_event_default (pad,parent, event);
@@ -895,6 +1413,21 @@ gst_aiurdemux_handle_src_query (GstPad * pad, GstObject * parent, GstQuery * que
         res = TRUE;
       }
       break;
+    case GST_QUERY_LATENCY:
+    {
+      gboolean live;
+      GstClockTime min, max;
+
+      res = gst_pad_query_default (pad, parent, query);
+      if (res && aiurdemux_is_live_timing (demux)) {
+        gst_query_parse_latency (query, &live, &min, &max);
+        min += demux->live_latency;
+        if (GST_CLOCK_TIME_IS_VALID (max))
+          max += demux->live_latency;
+        gst_query_set_latency (query, live, min, max);
+      }
+      break;
+    }
     case GST_QUERY_SEGMENT:
       {
         GstFormat format;
@@ -936,7 +1469,7 @@ gst_aiurdemux_push_tags (GstAiurDemux * demux, AiurDemuxStream * stream)
         GST_DEBUG_PAD_NAME (stream->pad));
 
     if (G_UNLIKELY (stream->pending_tags)) {
-        gst_pad_push_event (stream->pad,
+        aiurdemux_pad_push_event (demux, stream,
             gst_event_new_tag (stream->pending_tags));
 
       stream->pending_tags = NULL;
@@ -945,7 +1478,7 @@ gst_aiurdemux_push_tags (GstAiurDemux * demux, AiurDemuxStream * stream)
     if (G_UNLIKELY (stream->send_global_tags && demux->tag_list)) {
       GST_DEBUG_OBJECT (demux, "Sending global tags %" GST_PTR_FORMAT,
           demux->tag_list);
-      gst_pad_push_event (stream->pad,
+      aiurdemux_pad_push_event (demux, stream,
           gst_event_new_tag (gst_tag_list_ref (demux->tag_list)));
       stream->send_global_tags = FALSE;
     }
@@ -953,6 +1486,51 @@ gst_aiurdemux_push_tags (GstAiurDemux * demux, AiurDemuxStream * stream)
   }
 }
 
+/* with push-threads the pad queue is made on the first push */
+static AiurPadQueue *
+aiurdemux_stream_pad_queue (GstAiurDemux * demux, AiurDemuxStream * stream)
+{
+  if ((demux->pad_queues == NULL) || (stream->pad == NULL))
+    return NULL;
+
+  if (stream->pad_queue == NULL) {
+    /* subtitles are sparse, they do not hold back audio or video */
+    stream->pad_queue = aiur_pad_queue_new (demux->pad_queues, stream->pad,
+        (stream->type == MEDIA_VIDEO) || (stream->type == MEDIA_AUDIO));
+  }
+
+  return stream->pad_queue;
+}
+
+/* push buffer on the pad of stream, or queue it for its push thread */
+static GstFlowReturn
+aiurdemux_pad_push (GstAiurDemux * demux, AiurDemuxStream * stream,
+    GstBuffer * buffer)
+{
+  AiurPadQueue *queue = aiurdemux_stream_pad_queue (demux, stream);
+
+  if (queue)
+    return aiur_pad_queue_push (queue, buffer);
+
+  return gst_pad_push (stream->pad, buffer);
+}
+
+/* serialized events stay in order with the buffers of the pad */
+static gboolean
+aiurdemux_pad_push_event (GstAiurDemux * demux, AiurDemuxStream * stream,
+    GstEvent * event)
+{
+  AiurPadQueue *queue;
+
+  if (GST_EVENT_IS_SERIALIZED (event)) {
+    queue = aiurdemux_stream_pad_queue (demux, stream);
+    if (queue)
+      return aiur_pad_queue_push_event (queue, event);
+  }
+
+  return gst_pad_push_event (stream->pad, event);
+}
+
 /* push event on all source pads; takes ownership of the event */
 static void
 gst_aiurdemux_push_event (GstAiurDemux * demux, GstEvent * event)
@@ -960,11 +1538,18 @@ gst_aiurdemux_push_event (GstAiurDemux * demux, GstEvent * event)
   gint n;
   //gboolean pushed_sucessfully = FALSE;
 
+  /* nothing queued before the flush may reach the pads after it */
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_START)
+    aiur_pad_queue_group_set_flushing (demux->pad_queues, TRUE);
+  else if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+    aiur_pad_queue_group_set_flushing (demux->pad_queues, FALSE);
+
   for (n = 0; n < demux->n_streams; n++) {
     GstPad *pad = demux->streams[n]->pad;
 
     if (pad) {
-      if (gst_pad_push_event (pad, gst_event_ref (event))) {
+      if (aiurdemux_pad_push_event (demux, demux->streams[n],
+              gst_event_ref (event))) {
         ;//pushed_sucessfully = TRUE;
       }
     }
@@ -1041,9 +1626,13 @@ static gboolean aiurdemux_sink_activate_pull (GstPad * sinkpad, GstObject * pare
 
   if (active) {
       demux->pullbased = TRUE;
+      aiurcontent_pause_read_ahead (demux->content_info, FALSE);
       return gst_pad_start_task (sinkpad,
           (GstTaskFunction) aiurdemux_pull_task, sinkpad, NULL);
   } else {
+      /* upstream must not be pulled from the read-ahead thread once
+       * the pad is deactivated */
+      aiurcontent_pause_read_ahead (demux->content_info, TRUE);
       return gst_pad_stop_task (sinkpad);
   }
 }
@@ -1095,9 +1684,13 @@ static void aiurdemux_pull_task (GstPad * pad)
 {
   GstAiurDemux *demux;
   GstFlowReturn ret = GST_FLOW_OK;
+  gint state;
 
   demux = GST_AIURDEMUX (gst_pad_get_parent (pad));
 
+  aiur_arena_set_current (demux->arena);
+
+  state = demux->state;
   switch (demux->state) {
     case AIURDEMUX_STATE_PROBE:
       ret = aiurdemux_loop_state_probe (demux);
@@ -1116,11 +1709,16 @@ static void aiurdemux_pull_task (GstPad * pad)
       goto invalid_state;
   }
 
+  if (!demux->startup.done)
+    aiurdemux_startup_update (demux, state);
+
   /* if something went wrong, pause */
   if (ret != GST_FLOW_OK)
     goto pause;
 
 done:
+  /* task threads are pooled, do not leave the arena to the next user */
+  aiur_arena_set_current (NULL);
   gst_object_unref (demux);
   return;
 
@@ -1148,6 +1746,9 @@ pause:
 static void aiurdemux_push_task (GstAiurDemux * demux)
 {
   GstFlowReturn ret = GST_FLOW_OK;
+  gint state = demux->state;
+
+  aiur_arena_set_current (demux->arena);
 
   switch (demux->state) {
     case AIURDEMUX_STATE_PROBE:
@@ -1167,11 +1768,15 @@ static void aiurdemux_push_task (GstAiurDemux * demux)
       goto invalid_state;
   }
 
+  if (!demux->startup.done)
+    aiurdemux_startup_update (demux, state);
+
   /* if something went wrong, pause */
   if (ret != GST_FLOW_OK)
     goto pause;
 
 done:
+  aiur_arena_set_current (NULL);
   return;
 
 invalid_state:
@@ -1286,8 +1891,27 @@ aiurdemux_loop_state_init (GstAiurDemux * demux)
   aiurcontent_get_buffer_callback(demux->content_info,buf_cbks);
 
 
+  if(!demux->pullbased){
+      gst_aiur_stream_cache_set_preserve_size(demux->stream_cache,
+          demux->option.stream_cache_preserve_size);
+      gst_aiur_stream_cache_set_max_skip(demux->stream_cache,
+          demux->option.stream_cache_max_skip);
+  }
+
   aiurcontent_init(demux->content_info,demux->sinkpad,demux->stream_cache);
 
+  aiur_sample_pool_set_budget(demux->sample_pool,
+      demux->option.sample_pool_budget);
+  aiurcontent_set_sample_pool(demux->content_info, demux->sample_pool);
+
+  /* a mapped file needs no read-ahead cache */
+  if(demux->pullbased && (!demux->option.mmap
+      || aiurcontent_enable_mmap(demux->content_info,
+          demux->option.mmap_readahead) != 0))
+      aiurcontent_enable_block_cache(demux->content_info,
+          demux->option.block_cache_block_size,
+          demux->option.block_cache_blocks);
+
 
   isLive = aiurcontent_is_live(demux->content_info);
 
@@ -1353,9 +1977,10 @@ static GstFlowReturn aiurdemux_loop_state_header (GstAiurDemux * demux)
     if(IParser == NULL || handle == NULL)
         break;
 
-    index_file = aiurcontent_get_index_file(demux->content_info);
+    if (demux->option.index_enabled)
+      index_file = aiurcontent_get_index_file(demux->content_info);
 
-      if ((demux->option.index_enabled) && index_file) {
+    if (index_file) {
     AiurIndexTable *idxtable =
         aiurdemux_import_idx_table (index_file);
     if (idxtable) {
@@ -1382,6 +2007,11 @@ static GstFlowReturn aiurdemux_loop_state_header (GstAiurDemux * demux)
 
   }
 
+    if (need_init_index && index_file && demux->option.index_build_async
+        && aiurdemux_start_index_build (demux)) {
+      need_init_index = FALSE;
+    }
+
     if (need_init_index && IParser->initializeIndex != NULL) {
       parser_result = IParser->initializeIndex(handle);
     }
@@ -1450,6 +2080,10 @@ static GstFlowReturn aiurdemux_loop_state_movie (GstAiurDemux * demux)
 
   GST_LOG_OBJECT(demux,"aiurdemux_loop_state_movie BEGIN");
 
+  if (demux->index_thread)
+    aiurdemux_check_index_build (demux);
+
+  aiurdemux_check_relink (demux);
 
   if (demux->pending_event) {
     aiurdemux_send_pending_events (demux);
@@ -1459,6 +2093,17 @@ static GstFlowReturn aiurdemux_loop_state_movie (GstAiurDemux * demux)
     }
   }
 
+  //extract image tags once playback has started
+  if (demux->image_tags_pending) {
+    gboolean started;
+
+    GST_OBJECT_LOCK (demux);
+    started = demux->startup.done;
+    GST_OBJECT_UNLOCK (demux);
+    if ((started) || (--demux->image_tags_wait == 0))
+      aiurdemux_add_image_tags (demux);
+  }
+
   //select a track to read
   track_idx = aiurdemux_choose_next_stream(demux);
 
@@ -1467,11 +2112,19 @@ static GstFlowReturn aiurdemux_loop_state_movie (GstAiurDemux * demux)
       aiurdemux_check_interleave_stream_eos(demux);
       stream = aiurdemux_trackidx_to_stream (demux, track_idx);
 
+      //hold reading while the queues are above budget
+      if ((stream->buf_queue) && (g_queue_is_empty (stream->buf_queue))) {
+        AiurDemuxStream *drain = aiurdemux_queue_over_budget (demux);
+        if (drain) {
+          stream = drain;
+          demux->queue_drains++;
+        }
+      }
+
       //push buffer from interleave queue
       if ((stream->buf_queue)
           && (!g_queue_is_empty (stream->buf_queue))) {
-        gstbuf = g_queue_pop_head (stream->buf_queue);
-        stream->buf_queue_size -= gst_buffer_get_size(gstbuf);//GST_BUFFER_SIZE (gstbuf);
+        gstbuf = aiurdemux_dequeue_buffer (demux, stream);
         ret = aiurdemux_push_pad_buffer (demux, stream, gstbuf);
         goto bail;
       }
@@ -1487,12 +2140,19 @@ static GstFlowReturn aiurdemux_loop_state_movie (GstAiurDemux * demux)
   //update time
   if (!stream || !stream->buffer)
     goto bail;
+
+  //skip key frames the trick mode rate does not show
+  if ((demux->play_mode != AIUR_PLAY_MODE_NORMAL)
+      && (stream->type == MEDIA_VIDEO)
+      && (!aiurdemux_trick_select (demux, stream))) {
+    gst_buffer_unref (stream->buffer);
+    stream->buffer = NULL;
+    AIUR_RESET_SAMPLE_STAT (stream->sample_stat);
+    goto bail;
+  }
     GST_LOG_OBJECT (demux, "CHECK track_idx=%d,usStartTime=%lld,sampleFlags=%x",track_idx,stream->sample_stat.start,stream->sample_stat.flag);
 
-  if((demux->seekable == FALSE)
-      && !aiurcontent_is_seelable(demux->content_info)
-      && !aiurcontent_is_random_access(demux->content_info)
-      && !aiurcontent_is_adaptive_playback (demux->content_info))
+  if (aiurdemux_is_live_timing (demux))
         aiurdemux_check_start_offset(demux, stream);
 
     aiurdemux_adjust_timestamp (demux, stream, stream->buffer);
@@ -1517,12 +2177,7 @@ static GstFlowReturn aiurdemux_loop_state_movie (GstAiurDemux * demux)
     }
     //push buffer to pad
     if (demux->interleave_queue_size) {
-     stream->buf_queue_size += gst_buffer_get_size(stream->buffer);
-     if (stream->buf_queue_size > stream->buf_queue_size_max) {
-       stream->buf_queue_size_max = stream->buf_queue_size;
-     }
-
-     g_queue_push_tail (stream->buf_queue, stream->buffer);
+     aiurdemux_queue_buffer (demux, stream, stream->buffer);
      stream->buffer = NULL;
     } else {
      ret = aiurdemux_push_pad_buffer (demux, stream, stream->buffer);
@@ -1785,6 +2440,15 @@ aiurdemux_select_programs (GstAiurDemux * demux)
 
 
 
+static gboolean
+aiurdemux_is_image_format (gint format)
+{
+  return ((USER_DATA_FORMAT_JPEG == format) ||
+      (USER_DATA_FORMAT_PNG == format) ||
+      (USER_DATA_FORMAT_BMP == format) ||
+      (USER_DATA_FORMAT_GIF == format));
+}
+
 static GstTagList *
 aiurdemux_add_user_tags (GstAiurDemux * demux)
 {
@@ -1808,6 +2472,21 @@ aiurdemux_add_user_tags (GstAiurDemux * demux)
 
       id = g_user_data_entry[i].core_tag;
       format = g_user_data_entry[i].format;
+
+      /* images may be large, leave them until playback has started.
+       * A core fed by push mode can not seek back to them later. */
+      if (aiurdemux_is_image_format (format)) {
+        if (demux->option.max_image_tag_size == 0)
+          continue;
+        if (demux->pullbased) {
+          demux->image_tags_pending = TRUE;
+          demux->image_tags_wait = AIURDEMUX_IMAGE_TAG_WAIT;
+        } else {
+          aiurdemux_read_image_tag (demux, i, &list);
+        }
+        continue;
+      }
+
       core_ret = IParser->getMetaData(handle,id, &format, &userData, &userDataSize);
       if ((core_ret == PARSER_SUCCESS) &&
           (userData != NULL) && (userDataSize > 0)) {
@@ -1873,21 +2552,6 @@ aiurdemux_add_user_tags (GstAiurDemux * demux)
 
             g_string_free (string, TRUE);
           }
-        } else if ((USER_DATA_FORMAT_JPEG == format) ||
-            (USER_DATA_FORMAT_PNG == format) ||
-            (USER_DATA_FORMAT_BMP == format) ||
-            (USER_DATA_FORMAT_GIF == format)) {
-            GstSample *sample = gst_tag_image_data_to_image_sample (userData,
-              userDataSize, GST_TAG_IMAGE_TYPE_UNDEFINED);
-          if (sample) {
-
-            gst_tag_list_add (list, GST_TAG_MERGE_APPEND,
-                g_user_data_entry[i].gst_tag_name, sample, NULL);
-
-            GST_INFO_OBJECT (demux, g_user_data_entry[i].print_string, format,userDataSize);
-
-            gst_sample_unref (sample);
-          }
         }
       }
     }
@@ -2046,6 +2710,8 @@ static int aiurdemux_parse_streams (GstAiurDemux * demux)
       gst_pad_use_fixed_caps (stream->pad);
       gst_pad_set_event_function (stream->pad, gst_aiurdemux_handle_src_event);
       gst_pad_set_query_function (stream->pad, gst_aiurdemux_handle_src_query);
+      g_signal_connect (stream->pad, "linked",
+          G_CALLBACK (aiurdemux_pad_linked), stream);
       gst_pad_set_active (stream->pad, TRUE);
 
 
@@ -2763,6 +3429,8 @@ static void aiurdemux_check_interleave_stream_eos (GstAiurDemux * demux)
   gboolean bQueueFull = FALSE;
   if(demux->n_streams <= 1)
       return;
+  /* the queue budget holds reading before a queue gets here, the per
+   * stream size stays as backstop if one grows past it anyway */
   for (n = 0; n < demux->n_streams; n++) {
       stream = demux->streams[n];
       if (!stream->valid) {
@@ -2928,7 +3596,7 @@ static GstFlowReturn aiurdemux_read_buffer (GstAiurDemux * demux, uint32* track_
         stream->last_start = stream->time_position;
         stream->last_stop = stream->time_position + SUBTITLE_GAP_INTERVAL;
 
-        gst_pad_push_event (stream->pad, gap);
+        aiurdemux_pad_push_event (demux, stream, gap);
         GST_INFO ("TEXT GAP event sent %d, time_position=%lld, "
             "last_start=%lld, last_stop=%lld\n", *track_idx,
             stream->time_position, stream->last_start, stream->last_stop);
@@ -2944,6 +3612,9 @@ static GstFlowReturn aiurdemux_read_buffer (GstAiurDemux * demux, uint32* track_
       goto beach;
     }
 
+    if (demux->sched_offset_valid)
+        aiurdemux_update_seek_stat (demux, buffer_size, usStartTime);
+
     if(gstbuf && gst_buffer_get_size(gstbuf) != buffer_size){
         gst_buffer_set_size(gstbuf,buffer_size);
     }
@@ -2961,7 +3632,7 @@ static GstFlowReturn aiurdemux_read_buffer (GstAiurDemux * demux, uint32* track_
       gst_caps_unref(stream->caps);
       stream->caps = caps;
 
-      gst_pad_set_caps (stream->pad, stream->caps);
+      aiurdemux_pad_push_event (demux, stream, gst_event_new_caps (stream->caps));
 
       return ret;
     }
@@ -2989,7 +3660,11 @@ static GstFlowReturn aiurdemux_read_buffer (GstAiurDemux * demux, uint32* track_
       stream->partial_sample = FALSE;
       sample_size = gst_adapter_available (stream->adapter);
       if(sample_size > 0){
-        stream->buffer = gst_adapter_take_buffer (stream->adapter, stream->adapter_buffer_size);
+        /* chain fragments as memory blocks, copy only if asked to */
+        if (demux->option.partial_sample_contiguous)
+          stream->buffer = gst_adapter_take_buffer (stream->adapter, stream->adapter_buffer_size);
+        else
+          stream->buffer = gst_adapter_take_buffer_fast (stream->adapter, stream->adapter_buffer_size);
 
         stream->adapter_buffer_size = 0;
         gst_adapter_clear (stream->adapter);
@@ -3081,15 +3756,15 @@ static GstFlowReturn aiurdemux_parse_vorbis_codec_data(GstAiurDemux * demux, Aiu
     GstBuffer *gstbuf;
     gstbuf = gst_buffer_new_and_alloc (len1);
     gst_buffer_fill(gstbuf,0,(guint8 *)(stream->codec_data.codec_data+header1),len1);
-    gst_pad_push (stream->pad, gstbuf);
+    aiurdemux_pad_push (demux, stream, gstbuf);
     gstbuf = NULL;
     gstbuf = gst_buffer_new_and_alloc (len2);
     gst_buffer_fill(gstbuf,0,(guint8 *)(stream->codec_data.codec_data+header2),len2);
-    gst_pad_push (stream->pad, gstbuf);
+    aiurdemux_pad_push (demux, stream, gstbuf);
     gstbuf = NULL;
     gstbuf = gst_buffer_new_and_alloc (len3);
     gst_buffer_fill(gstbuf,0,(guint8 *)(stream->codec_data.codec_data+header3),len3);
-    gst_pad_push (stream->pad, gstbuf);
+    aiurdemux_pad_push (demux, stream, gstbuf);
     GST_DEBUG_OBJECT (demux, "push vorbis codec buffer totalLen=%d,1=%d,2=%d,3=%d",
       stream->codec_data.length,header1,header2,header3);
   }
@@ -3097,11 +3772,231 @@ static GstFlowReturn aiurdemux_parse_vorbis_codec_data(GstAiurDemux * demux, Aiu
   return GST_FLOW_OK;
 }
 
+static gboolean
+aiurdemux_get_next_sample_offset (GstAiurDemux * demux,
+    AiurDemuxStream * stream, guint64 * offset)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+  uint64 sample_offset = 0;
+  uint64 last_index = 0;
+
+  if (IParser->getSampleInfo == NULL)
+    return FALSE;
+
+  if (IParser->getSampleInfo (demux->core_handle, stream->track_idx,
+          &sample_offset, &last_index) != PARSER_SUCCESS)
+    return FALSE;
+
+  *offset = sample_offset;
+  return TRUE;
+}
+
+/* among streams no more than interleave-time-skew ahead of the earliest
+ * one, pick the one whose next sample is closest to the read position */
+static gint
+aiurdemux_schedule_by_offset (GstAiurDemux * demux, gint track_index,
+    gint64 min_time)
+{
+  AiurDemuxStream *stream;
+  gint64 window = (gint64) demux->option.interleave_time_skew * GST_MSECOND;
+  guint64 offset, best_dist, dist;
+  gint n;
+
+  demux->sched_offset_valid = FALSE;
+
+  stream = aiurdemux_trackidx_to_stream (demux, track_index);
+  if ((stream == NULL)
+      || !aiurdemux_get_next_sample_offset (demux, stream, &offset))
+    return track_index;
+
+  demux->sched_offset = offset;
+  demux->sched_offset_valid = TRUE;
+
+  if ((window == 0) || !demux->sched_pos_valid)
+    return track_index;
+
+  best_dist = (offset >= demux->sched_pos) ? offset - demux->sched_pos :
+      demux->sched_pos - offset;
+
+  for (n = 0; n < demux->n_streams; n++) {
+    stream = demux->streams[n];
+    if ((!stream->valid) || (stream->type == MEDIA_TEXT)
+        || (stream->track_idx == track_index)
+        || (stream->last_stop == GST_CLOCK_TIME_NONE)
+        || (stream->last_stop > min_time + window))
+      continue;
+
+    if (!aiurdemux_get_next_sample_offset (demux, stream, &offset))
+      continue;
+
+    dist = (offset >= demux->sched_pos) ? offset - demux->sched_pos :
+        demux->sched_pos - offset;
+    if (dist < best_dist) {
+      best_dist = dist;
+      track_index = stream->track_idx;
+      demux->sched_offset = offset;
+    }
+  }
+
+  return track_index;
+}
+
+static void
+aiurdemux_update_seek_stat (GstAiurDemux * demux, uint32 sample_size,
+    uint64 usStartTime)
+{
+  GstClockTime ts = AIUR_CORETS_2_GSTTS (usStartTime);
+
+  if (demux->sched_pos_valid && (demux->sched_offset != demux->sched_pos)) {
+    demux->sched_seek_bytes += (demux->sched_offset > demux->sched_pos) ?
+        demux->sched_offset - demux->sched_pos :
+        demux->sched_pos - demux->sched_offset;
+    demux->sched_seeks++;
+  }
+  demux->sched_pos = demux->sched_offset + sample_size;
+  demux->sched_pos_valid = TRUE;
+  demux->sched_offset_valid = FALSE;
+
+  if (GST_CLOCK_TIME_IS_VALID (ts)) {
+    if (!GST_CLOCK_TIME_IS_VALID (demux->sched_time_start)
+        || (ts < demux->sched_time_start))
+      demux->sched_time_start = ts;
+    if (!GST_CLOCK_TIME_IS_VALID (demux->sched_time_last)
+        || (ts > demux->sched_time_last))
+      demux->sched_time_last = ts;
+  }
+}
+
+static void
+aiurdemux_post_queue_level (GstAiurDemux * demux)
+{
+  gint level;
+
+  if (demux->option.queue_budget == 0)
+    return;
+
+  level = MIN (100, demux->queued_bytes * 100 / demux->option.queue_budget);
+
+  /* avoid a message per buffer while the level hovers around a value */
+  if ((demux->queue_level >= 0)
+      && (ABS (level - demux->queue_level) < AIURDEMUX_QUEUE_LEVEL_STEP)
+      && (level != 0) && (level != 100))
+    return;
+  if (level == demux->queue_level)
+    return;
+
+  demux->queue_level = level;
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_element (GST_OBJECT_CAST (demux),
+          gst_structure_new ("GstAiurDemuxQueueLevel",
+              "percent", G_TYPE_INT, level,
+              "bytes", G_TYPE_UINT64, demux->queued_bytes,
+              "budget", G_TYPE_UINT, demux->option.queue_budget, NULL)));
+}
+
+static void
+aiurdemux_queue_buffer (GstAiurDemux * demux, AiurDemuxStream * stream,
+    GstBuffer * buffer)
+{
+  gsize size = gst_buffer_get_size (buffer);
+
+  g_queue_push_tail (stream->buf_queue, buffer);
+  stream->buf_queue_size += size;
+  if (stream->buf_queue_size > stream->buf_queue_size_max)
+    stream->buf_queue_size_max = stream->buf_queue_size;
+
+  demux->queued_bytes += size;
+  if (demux->queued_bytes > demux->queued_bytes_peak)
+    demux->queued_bytes_peak = demux->queued_bytes;
+
+  aiurdemux_post_queue_level (demux);
+}
+
+static GstBuffer *
+aiurdemux_dequeue_buffer (GstAiurDemux * demux, AiurDemuxStream * stream)
+{
+  GstBuffer *buffer;
+  gsize size;
+
+  buffer = g_queue_pop_head (stream->buf_queue);
+  if (buffer == NULL)
+    return NULL;
+
+  size = gst_buffer_get_size (buffer);
+  stream->buf_queue_size -= size;
+  demux->queued_bytes -= MIN (size, demux->queued_bytes);
+
+  aiurdemux_post_queue_level (demux);
+
+  return buffer;
+}
+
+static void
+aiurdemux_flush_queue (GstAiurDemux * demux, AiurDemuxStream * stream)
+{
+  GstBuffer *buffer;
+
+  if (stream->buf_queue) {
+    while ((buffer = g_queue_pop_head (stream->buf_queue))) {
+      gst_buffer_unref (buffer);
+    }
+  }
+
+  demux->queued_bytes -= MIN (stream->buf_queue_size, demux->queued_bytes);
+  stream->buf_queue_size = 0;
+
+  aiurdemux_post_queue_level (demux);
+}
+
+/* with the queues over budget, the stream furthest above its fair share
+ * is drained instead of reading more samples from the core. Draining
+ * pushes downstream, which blocks while downstream is full. */
+static AiurDemuxStream *
+aiurdemux_queue_over_budget (GstAiurDemux * demux)
+{
+  AiurDemuxStream *stream, *drain = NULL;
+  guint64 share, excess = 0;
+  gint n, queues = 0;
+
+  if ((demux->option.queue_budget == 0)
+      || (demux->queued_bytes < demux->option.queue_budget))
+    return NULL;
+
+  for (n = 0; n < demux->n_streams; n++) {
+    if ((demux->streams[n]->buf_queue) && (!demux->streams[n]->disabled))
+      queues++;
+  }
+  if (queues == 0)
+    return NULL;
+
+  share = demux->option.queue_budget / queues;
+
+  for (n = 0; n < demux->n_streams; n++) {
+    stream = demux->streams[n];
+    if ((!stream->valid) || (stream->buf_queue == NULL)
+        || (g_queue_is_empty (stream->buf_queue)))
+      continue;
+    if ((stream->buf_queue_size > share)
+        && (stream->buf_queue_size - share > excess)) {
+      excess = stream->buf_queue_size - share;
+      drain = stream;
+    }
+  }
+
+  if (drain) {
+    GST_LOG_OBJECT (demux, "queues %lld over budget, drain track %d",
+        demux->queued_bytes, drain->track_idx);
+  }
+
+  return drain;
+}
+
 static gint aiurdemux_choose_next_stream (GstAiurDemux * demux)
 {
   int n, i;
   gint track_index = 0;
   gint64 min_time = -1;
+  gboolean forced = FALSE;
   AiurDemuxStream *stream;
 
   if (demux->sub_read_ready) {
@@ -3137,16 +4032,19 @@ static gint aiurdemux_choose_next_stream (GstAiurDemux * demux)
     if ((demux->read_mode == PARSER_READ_MODE_TRACK_BASED)
         && (stream->partial_sample)) {
       track_index = stream->track_idx;
+      forced = TRUE;
       break;
     }
 
     if ((demux->interleave_queue_size)
         && (stream->buf_queue_size > demux->interleave_queue_size)) {
       track_index = stream->track_idx;
+      forced = TRUE;
       break;
     }
 
     if (stream->last_stop == GST_CLOCK_TIME_NONE) {
+      forced = TRUE;
       if (demux->read_mode==PARSER_READ_MODE_FILE_BASED) {
         track_index = stream->track_idx;
         if (stream->buf_queue && !g_queue_is_empty(stream->buf_queue)) {
@@ -3182,6 +4080,12 @@ static gint aiurdemux_choose_next_stream (GstAiurDemux * demux)
 
   }
 
+  if ((demux->read_mode == PARSER_READ_MODE_TRACK_BASED)
+      && (demux->play_mode == AIUR_PLAY_MODE_NORMAL)
+      && (!forced) && (min_time >= 0)) {
+    track_index = aiurdemux_schedule_by_offset (demux, track_index, min_time);
+  }
+
   for (n = 0; n < demux->n_streams; n++) {
     stream = demux->streams[n];
     if (track_index == stream->track_idx) {
@@ -3212,6 +4116,68 @@ static AiurDemuxStream* aiurdemux_trackidx_to_stream (GstAiurDemux * demux, guin
 /* generic running average, this has a neutral window size */
 #define UPDATE_RUNNING_AVG(avg,val)   DO_RUNNING_AVG(avg,val,10)
 
+/* timestamps follow the pipeline clock, plus the live latency */
+static gboolean
+aiurdemux_is_live_timing (GstAiurDemux * demux)
+{
+  return ((demux->seekable == FALSE)
+      && !aiurcontent_is_seelable (demux->content_info)
+      && !aiurcontent_is_random_access (demux->content_info)
+      && !aiurcontent_is_adaptive_playback (demux->content_info));
+}
+
+/* transit is arrival running time minus media time of a sample, its
+ * variation is the jitter (RFC 3550 estimator) the latency must absorb */
+static void
+aiurdemux_update_live_latency (GstAiurDemux * demux, AiurDemuxStream * stream,
+    GstClockTimeDiff transit)
+{
+  GstClockTimeDiff d;
+  GstClockTime target, band, max_latency;
+
+  if (!stream->transit_valid) {
+    stream->last_transit = transit;
+    stream->transit_valid = TRUE;
+    return;
+  }
+
+  d = ABS (transit - stream->last_transit);
+  stream->last_transit = transit;
+
+  /* timestamp discontinuity, not jitter */
+  if (d > AIURDEMUX_LIVE_JITTER_MAX_STEP)
+    return;
+
+  demux->live_jitter += (d - (GstClockTimeDiff) demux->live_jitter) / 16;
+
+  if ((!demux->option.adaptive_latency)
+      || (++demux->live_jitter_samples < AIURDEMUX_LIVE_LATENCY_WARMUP))
+    return;
+
+  max_latency = GST_MSECOND * demux->option.streaming_latency;
+  target = demux->live_jitter * 4 + AIURDEMUX_LIVE_LATENCY_MARGIN;
+  target = MAX (target, GST_MSECOND * demux->option.min_latency);
+  target = MIN (target, max_latency);
+
+  band = MAX (demux->live_latency / AIURDEMUX_LIVE_LATENCY_HYSTERESIS,
+      AIURDEMUX_LIVE_LATENCY_HYSTERESIS_MIN);
+  if ((target + band > demux->live_latency)
+      && (target < demux->live_latency + band))
+    return;
+
+  GST_INFO_OBJECT (demux, "jitter %" GST_TIME_FORMAT ", latency %"
+      GST_TIME_FORMAT " -> %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (demux->live_jitter), GST_TIME_ARGS (demux->live_latency),
+      GST_TIME_ARGS (target));
+
+  demux->live_latency = target;
+  demux->live_latency_changes++;
+  demux->avg_diff = 0;
+
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_latency (GST_OBJECT_CAST (demux)));
+}
+
 static void
 aiurdemux_check_start_offset (GstAiurDemux * demux, AiurDemuxStream * stream)
 {
@@ -3219,6 +4185,7 @@ aiurdemux_check_start_offset (GstAiurDemux * demux, AiurDemuxStream * stream)
     GstClock *clock = NULL;
     GstClockTimeDiff offset = 0;
     GstClockTimeDiff in_diff;
+    GstClockTime live_latency, pipeline_latency;
 
     base_time = GST_ELEMENT_CAST (demux)->base_time;
     clock = GST_ELEMENT_CLOCK (demux);
@@ -3260,7 +4227,7 @@ aiurdemux_check_start_offset (GstAiurDemux * demux, AiurDemuxStream * stream)
 
       /* monitoring the gap between media time and current time stamp */
       gint64 new_ts = stream->sample_stat.start - demux->start_time + demux->clock_offset;
-      if((new_ts + (GST_MSECOND*demux->option.streaming_latency/2)) < offset) {
+      if((new_ts + (gint64)(demux->live_latency/2)) < offset) {
         //new ts lag last for AIURDEMUX_TIMESTAMP_LAG_MAX_TIME, then change to new start time
         if (stream->lag_time != GST_CLOCK_TIME_NONE) {
           if ((offset - stream->lag_time) > AIURDEMUX_TIMESTAMP_LAG_MAX_TIME) {
@@ -3286,16 +4253,28 @@ aiurdemux_check_start_offset (GstAiurDemux * demux, AiurDemuxStream * stream)
       }
     }
 
+    if ((clock != NULL) && (GST_CLOCK_TIME_IS_VALID (demux->start_time))
+        && (GST_CLOCK_TIME_IS_VALID (stream->sample_stat.start)))
+      aiurdemux_update_live_latency (demux, stream,
+          offset - (GstClockTimeDiff) (stream->sample_stat.start - demux->start_time));
+
+    /* a new live latency takes effect with the pipeline latency it leads
+     * to, not before, or output timestamps would step back and forth */
+    GST_OBJECT_LOCK (demux);
+    live_latency = demux->live_latency_applied;
+    pipeline_latency = demux->pipeline_latency;
+    GST_OBJECT_UNLOCK (demux);
+
     if((GST_CLOCK_TIME_IS_VALID (demux->clock_offset))
         && (GST_CLOCK_TIME_IS_VALID (demux->start_time))
         && (GST_CLOCK_TIME_IS_VALID (stream->sample_stat.start))){
         stream->sample_stat.start = stream->sample_stat.start - demux->start_time
-          + demux->clock_offset + demux->media_offset + (GST_MSECOND * demux->option.streaming_latency) - demux->pipeline_latency;
+          + demux->clock_offset + demux->media_offset + live_latency - pipeline_latency;
 
         GST_LOG_OBJECT (demux,"***start=%"GST_TIME_FORMAT,GST_TIME_ARGS (stream->sample_stat.start));
     }
 
-    if(GST_CLOCK_TIME_IS_VALID (stream->sample_stat.start) && demux->option.streaming_latency> 0
+    if(GST_CLOCK_TIME_IS_VALID (stream->sample_stat.start) && live_latency > 0
         && demux->option.low_latency_tolerance > 0){
         in_diff = stream->sample_stat.start - offset;
 
@@ -3306,11 +4285,11 @@ aiurdemux_check_start_offset (GstAiurDemux * demux, AiurDemuxStream * stream)
 
       GST_LOG_OBJECT (demux,"***diff=%"GST_TIME_FORMAT,GST_TIME_ARGS (demux->avg_diff));
 
-      if( demux->avg_diff > (gint64)GST_MSECOND * (demux->option.streaming_latency+demux->option.low_latency_tolerance)){
+      if( demux->avg_diff > (gint64)(live_latency + GST_MSECOND * demux->option.low_latency_tolerance)){
         demux->media_offset -= GST_MSECOND * demux->option.low_latency_tolerance*5/4;
         demux->avg_diff = 0;
         GST_LOG_OBJECT(demux,"***media_offset 1=%lld",demux->media_offset);
-      }else if(demux->avg_diff < (gint64)GST_MSECOND*(demux->option.streaming_latency - demux->option.low_latency_tolerance)){
+      }else if(demux->avg_diff < (gint64)live_latency - (gint64)GST_MSECOND * demux->option.low_latency_tolerance){
         demux->media_offset += (GST_MSECOND * demux->option.low_latency_tolerance*3/4);
         demux->avg_diff = 0;
         GST_LOG_OBJECT (demux,"***media_offset 2=%lld",demux->media_offset);
@@ -3382,6 +4361,82 @@ aiurdemux_update_stream_position (GstAiurDemux * demux,
   }
 }
 
+/* called for each video sync sample of a trick mode, FALSE to drop it.
+ * Key frames are shown trick_fps times per second of running time, so
+ * after one is sent the core seeks to the next wanted one instead of
+ * handing out every sync sample in between. The step grows with the
+ * QoS proportion when downstream can not decode fast enough. */
+static gboolean
+aiurdemux_trick_select (GstAiurDemux * demux, AiurDemuxStream * stream)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+  FslParserHandle handle = demux->core_handle;
+  gboolean forward = (demux->play_mode == AIUR_PLAY_MODE_TRICK_FORWARD);
+  GstClockTime ts = stream->sample_stat.start;
+  GstClockTime step, target, gop;
+  gdouble proportion;
+  guint64 usSeekTime;
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return TRUE;
+
+  GST_OBJECT_LOCK (demux);
+  /* the core may hand out the key frame it was seeked next to again */
+  if (GST_CLOCK_TIME_IS_VALID (demux->trick_last)) {
+    if ((forward) ? (ts <= demux->trick_last) : (ts >= demux->trick_last)) {
+      GST_OBJECT_UNLOCK (demux);
+      GST_LOG_OBJECT (demux, "drop trick mode key frame %" GST_TIME_FORMAT,
+          GST_TIME_ARGS (ts));
+      return FALSE;
+    }
+    /* after a skip the spacing is the step, not the GOP */
+    if (!demux->trick_skipped)
+      demux->trick_gop = (forward) ? ts - demux->trick_last :
+          demux->trick_last - ts;
+  } else {
+    demux->trick_first = ts;
+  }
+  demux->trick_last = ts;
+  demux->trick_frames++;
+  demux->trick_skipped = FALSE;
+  proportion = MAX (demux->trick_proportion, 1.0);
+  gop = demux->trick_gop;
+  GST_OBJECT_UNLOCK (demux);
+
+  if ((demux->option.trick_fps == 0) || (IParser->seek == NULL))
+    return TRUE;
+
+  step = (GstClockTime) (demux->trick_rate * proportion * GST_SECOND
+      / demux->option.trick_fps);
+
+  /* the next key frame is not too early anyway, once the GOP is known
+   * to be shorter than the step every key frame sent seeks */
+  if ((!GST_CLOCK_TIME_IS_VALID (gop)) || (step <= gop))
+    return TRUE;
+
+  if (forward) {
+    target = ts + step;
+  } else {
+    if (ts <= step)
+      return TRUE;
+    target = ts - step;
+  }
+
+  usSeekTime = AIUR_GSTTS_2_CORETS (target);
+  if (IParser->seek (handle, stream->track_idx, &usSeekTime,
+          (forward) ? SEEK_FLAG_NO_EARLIER : SEEK_FLAG_NO_LATER)
+      == PARSER_SUCCESS) {
+    GST_OBJECT_LOCK (demux);
+    demux->trick_skips++;
+    demux->trick_skipped = TRUE;
+    GST_OBJECT_UNLOCK (demux);
+    GST_LOG_OBJECT (demux, "trick mode skip to %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (target));
+  }
+
+  return TRUE;
+}
+
 static void
 aiurdemux_send_stream_newsegment (GstAiurDemux * demux,
     AiurDemuxStream * stream)
@@ -3424,7 +4479,7 @@ aiurdemux_send_stream_newsegment (GstAiurDemux * demux,
     }
     segment.position = segment.time = stream->time_position;
     GST_DEBUG ("segment event %" GST_SEGMENT_FORMAT, &segment);
-    gst_pad_push_event (stream->pad, gst_event_new_segment (&segment));
+    aiurdemux_pad_push_event (demux, stream, gst_event_new_segment (&segment));
   } else {
     if(stream->type == MEDIA_AUDIO || stream->type == MEDIA_TEXT){
         stream->new_segment = FALSE;
@@ -3442,7 +4497,7 @@ aiurdemux_send_stream_newsegment (GstAiurDemux * demux,
     segment.stop = stream->time_position;
     segment.position = segment.time = 0;
     GST_DEBUG ("segment event %" GST_SEGMENT_FORMAT, &segment);
-    gst_pad_push_event (stream->pad, gst_event_new_segment (&segment));
+    aiurdemux_pad_push_event (demux, stream, gst_event_new_segment (&segment));
   }
   stream->new_segment = FALSE;
 
@@ -3457,7 +4512,7 @@ aiurdemux_send_stream_eos (GstAiurDemux * demux, AiurDemuxStream * stream)
       aiurdemux_send_stream_newsegment (demux, stream);
     }
 
-    ret = gst_pad_push_event (stream->pad, gst_event_new_eos ());
+    ret = aiurdemux_pad_push_event (demux, stream, gst_event_new_eos ());
 
     stream->valid = FALSE;
     demux->valid_mask &= (~stream->mask);
@@ -3481,9 +4536,8 @@ aiurdemux_send_stream_eos_all (GstAiurDemux * demux)
       if (stream) {
         GstBuffer *gstbuf;
         //GstFlowReturn ret;
-        gstbuf = g_queue_pop_head (stream->buf_queue);
+        gstbuf = aiurdemux_dequeue_buffer (demux, stream);
         if (gstbuf) {
-          stream->buf_queue_size -= gst_buffer_get_size(gstbuf);//GST_BUFFER_SIZE (gstbuf);
           aiurdemux_push_pad_buffer (demux, stream, gstbuf);
         } else {
           aiurdemux_send_stream_eos (demux, stream);
@@ -3522,6 +4576,18 @@ static GstFlowReturn aiurdemux_push_pad_buffer (GstAiurDemux * demux, AiurDemuxS
 {
   GstFlowReturn ret;
 
+  if (GST_CLOCK_TIME_IS_VALID (stream->resume_after)) {
+    if ((GST_CLOCK_TIME_IS_VALID (GST_BUFFER_TIMESTAMP (buffer)))
+        && (GST_BUFFER_TIMESTAMP (buffer) <= stream->resume_after)) {
+      gst_buffer_unref (buffer);
+      ret = GST_FLOW_OK;
+      GST_LOG ("drop %s buffer sent before relink",
+          AIUR_MEDIATYPE2STR (stream->type));
+      goto bail;
+    }
+    stream->resume_after = GST_CLOCK_TIME_NONE;
+  }
+
   aiurdemux_update_stream_position (demux, stream, buffer);
 
   if (stream->block) {
@@ -3543,7 +4609,10 @@ static GstFlowReturn aiurdemux_push_pad_buffer (GstAiurDemux * demux, AiurDemuxS
       GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT), \
       GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT));
 
-  ret = gst_pad_push (stream->pad, buffer);
+  if (!demux->startup.done)
+    aiurdemux_startup_first_buffer (demux, stream);
+
+  ret = aiurdemux_pad_push (demux, stream, buffer);
 
   if ((ret != GST_FLOW_OK)) {
     GST_WARNING ("Pad %s push error type %d",
@@ -3556,6 +4625,14 @@ static GstFlowReturn aiurdemux_push_pad_buffer (GstAiurDemux * demux, AiurDemuxS
       }
 
     }
+    if ((ret == GST_FLOW_NOT_LINKED)
+        && (demux->option.disable_unlinked_tracks)
+        && (!gst_pad_is_linked (stream->pad))) {
+      aiurdemux_disable_stream (demux, stream);
+      if (demux->valid_mask == 0) {
+        goto bail;
+      }
+    }
     if (ret < GST_FLOW_EOS) {
         goto bail;
     }
@@ -3595,16 +4672,18 @@ done:
 
 static void aiurdemux_reset_stream (GstAiurDemux * demux, AiurDemuxStream * stream)
 {
-    stream->valid = TRUE;
+    stream->valid = !stream->disabled;
     stream->new_segment = TRUE;
     stream->last_ret = GST_FLOW_OK;
     stream->last_stop = 0;
     stream->last_start = GST_CLOCK_TIME_NONE;
     stream->time_position = 0;
+    stream->resume_after = GST_CLOCK_TIME_NONE;
     stream->pending_eos = FALSE;
     stream->block = FALSE;
     stream->last_timestamp = GST_CLOCK_TIME_NONE;
     stream->lag_time = GST_CLOCK_TIME_NONE;
+    stream->transit_valid = FALSE;
 
     if (stream->buffer) {
       gst_buffer_unref (stream->buffer);
@@ -3616,23 +4695,230 @@ static void aiurdemux_reset_stream (GstAiurDemux * demux, AiurDemuxStream * stre
       gst_adapter_clear (stream->adapter);
     }
 
-    if (stream->buf_queue) {
-        GstBuffer * gbuf;
-        while ((gbuf = g_queue_pop_head ((stream)->buf_queue))) {
-            gst_buffer_unref (gbuf);
-        };
-    }
-
-    stream->buf_queue_size = 0;
+    aiurdemux_flush_queue (demux, stream);
 
     AIUR_RESET_SAMPLE_STAT(stream->sample_stat);
 
-    demux->valid_mask |= stream->mask;
+    if (!stream->disabled)
+      demux->valid_mask |= stream->mask;
 
     demux->sub_read_ready = TRUE;
     demux->sub_read_cnt = 0;
 }
 
+/* nobody consumes the track, stop the core from reading and parsing it */
+static void
+aiurdemux_disable_stream (GstAiurDemux * demux, AiurDemuxStream * stream)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+
+  if (stream->disabled)
+    return;
+
+  if (IParser->enableTrack (demux->core_handle, stream->track_idx,
+          FALSE) != PARSER_SUCCESS) {
+    GST_WARNING_OBJECT (demux, "track %d can not be disabled",
+        stream->track_idx);
+    return;
+  }
+
+  stream->disabled = TRUE;
+  stream->valid = FALSE;
+  stream->partial_sample = FALSE;
+  demux->valid_mask &= (~stream->mask);
+  if (stream->type == MEDIA_TEXT)
+    demux->sub_read_ready = TRUE;
+
+  gst_adapter_clear (stream->adapter);
+  stream->adapter_buffer_size = 0;
+  aiurdemux_flush_queue (demux, stream);
+
+  demux->tracks_disabled++;
+
+  GST_INFO_OBJECT (demux, "Pad %s not linked, disable track %d",
+      AIUR_MEDIATYPE2STR (stream->type), stream->track_idx);
+}
+
+static void
+aiurdemux_pad_linked (GstPad * pad, GstPad * peer, gpointer user_data)
+{
+  AiurDemuxStream *stream = (AiurDemuxStream *) user_data;
+
+  /* may come from any thread, core is only touched by the streaming thread */
+  g_atomic_int_set (&stream->relink, 1);
+}
+
+/* position of the slowest track still being read */
+static GstClockTime
+aiurdemux_get_read_position (GstAiurDemux * demux)
+{
+  GstClockTime position = GST_CLOCK_TIME_NONE;
+  AiurDemuxStream *stream;
+  gint n;
+
+  for (n = 0; n < demux->n_streams; n++) {
+    stream = demux->streams[n];
+    if ((stream->valid) && (stream->type != MEDIA_TEXT)
+        && (GST_CLOCK_TIME_IS_VALID (stream->last_stop))
+        && ((!GST_CLOCK_TIME_IS_VALID (position))
+            || (stream->last_stop < position)))
+      position = stream->last_stop;
+  }
+
+  return GST_CLOCK_TIME_IS_VALID (position) ? position : 0;
+}
+
+/* enable tracks linked again and continue them from current position.
+ * In file mode all tracks share the file position of the core, so like
+ * a seek every enabled track is moved to it, and the others drop what
+ * they read again up to their last buffer pushed. */
+static void
+aiurdemux_check_relink (GstAiurDemux * demux)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+  FslParserHandle handle = demux->core_handle;
+  gboolean file_mode = (demux->read_mode == PARSER_READ_MODE_FILE_BASED);
+  GstClockTime position = GST_CLOCK_TIME_NONE;
+  AiurDemuxStream *stream;
+  guint64 usSeekTime;
+  guint32 relinked = 0;
+  gint n;
+
+  for (n = 0; n < demux->n_streams; n++) {
+    stream = demux->streams[n];
+
+    if (!g_atomic_int_compare_and_exchange (&stream->relink, 1, 0))
+      continue;
+    if (!stream->disabled)
+      continue;
+
+    if (IParser->enableTrack (handle, stream->track_idx,
+            TRUE) != PARSER_SUCCESS) {
+      GST_WARNING_OBJECT (demux, "track %d can not be enabled",
+          stream->track_idx);
+      continue;
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID (position))
+      position = aiurdemux_get_read_position (demux);
+    stream->disabled = FALSE;
+    aiurdemux_reset_stream (demux, stream);
+    relinked |= (1U << n);
+
+    if (!file_mode) {
+      usSeekTime = AIUR_GSTTS_2_CORETS (position);
+      IParser->seek (handle, stream->track_idx, &usSeekTime,
+          SEEK_FLAG_NO_LATER);
+    }
+
+    stream->time_position = position;
+    stream->block = ((demux->play_mode == AIUR_PLAY_MODE_NORMAL)
+        && (stream->type != MEDIA_VIDEO));
+    stream->discont = TRUE;
+
+    /* the track seek moved the read offset */
+    demux->sched_pos_valid = FALSE;
+    demux->sched_offset_valid = FALSE;
+
+    demux->tracks_reenabled++;
+
+    GST_INFO_OBJECT (demux, "Pad %s linked, enable track %d from %"
+        GST_TIME_FORMAT, AIUR_MEDIATYPE2STR (stream->type),
+        stream->track_idx, GST_TIME_ARGS (position));
+  }
+
+  if ((!file_mode) || (relinked == 0))
+    return;
+
+  for (n = 0; n < demux->n_streams; n++) {
+    stream = demux->streams[n];
+
+    if ((stream->disabled) || (!stream->valid))
+      continue;
+
+    if (!(relinked & (1U << n))) {
+      aiurdemux_flush_queue (demux, stream);
+      stream->resume_after = stream->last_start;
+    }
+
+    usSeekTime = AIUR_GSTTS_2_CORETS (position);
+    IParser->seek (handle, stream->track_idx, &usSeekTime,
+        SEEK_FLAG_NO_LATER);
+  }
+}
+
+/* account time and file io since last call to the state just run */
+static void
+aiurdemux_startup_update (GstAiurDemux * demux, gint state)
+{
+  AiurDemuxStartupStat *startup = &demux->startup;
+  AiurContentIoStats io;
+  GstClockTime now;
+
+  if ((state < 0) || (state >= AIURDEMUX_STATE_NUM))
+    return;
+
+  now = gst_util_get_timestamp ();
+  memset (&io, 0, sizeof (io));
+
+  GST_OBJECT_LOCK (demux);
+  if (demux->content_info)
+    aiurcontent_get_io_stats (demux->content_info, &io);
+
+  startup->state_time[state] += now - startup->stamp;
+  startup->state_io[state].reads += io.reads - startup->io.reads;
+  startup->state_io[state].read_bytes += io.read_bytes - startup->io.read_bytes;
+  startup->state_io[state].seeks += io.seeks - startup->io.seeks;
+  startup->stamp = now;
+  startup->io = io;
+  GST_OBJECT_UNLOCK (demux);
+}
+
+static void
+aiurdemux_startup_first_buffer (GstAiurDemux * demux,
+    AiurDemuxStream * stream)
+{
+  AiurDemuxStartupStat *startup = &demux->startup;
+  gboolean done = TRUE;
+  gint n;
+
+  GST_OBJECT_LOCK (demux);
+  startup->n_pads = demux->n_streams;
+  for (n = 0; n < demux->n_streams; n++) {
+    AiurDemuxStream *s = demux->streams[n];
+
+    if (startup->pad_name[n][0] == '\0') {
+      g_strlcpy (startup->pad_name[n], GST_PAD_NAME (s->pad),
+          AIURDEMUX_PAD_NAME_LEN);
+      startup->first_buffer[n] = GST_CLOCK_TIME_NONE;
+    }
+    if ((s == stream) && !GST_CLOCK_TIME_IS_VALID (startup->first_buffer[n]))
+      startup->first_buffer[n] = gst_util_get_timestamp () - startup->start;
+
+    /* tracks ended or disabled will never send one, subtitles may not
+     * for a long time */
+    if (s->valid && (s->type != MEDIA_TEXT)
+        && !GST_CLOCK_TIME_IS_VALID (startup->first_buffer[n]))
+      done = FALSE;
+  }
+  /* a track starting late must not hold back the report forever */
+  if (++startup->buffers >= AIURDEMUX_STARTUP_MAX_BUFFERS)
+    done = TRUE;
+  GST_OBJECT_UNLOCK (demux);
+
+  if (!done)
+    return;
+
+  aiurdemux_startup_update (demux, demux->state);
+  GST_OBJECT_LOCK (demux);
+  startup->done = TRUE;
+  GST_OBJECT_UNLOCK (demux);
+
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_element (GST_OBJECT_CAST (demux),
+          aiurdemux_get_startup_stats (demux)));
+}
+
 static gboolean
 gst_aiurdemux_convert_seek (GstPad * pad, GstFormat * format,
     GstSeekType cur_type, gint64 * cur, GstSeekType stop_type, gint64 * stop)
@@ -3701,10 +4987,25 @@ gst_aiurdemux_perform_seek (GstAiurDemux * demux, GstSegment * segment,
   if((0 == demux->n_video_streams) && (demux->n_audio_streams >= 1) && (rate >= 0)){
     demux->play_mode = AIUR_PLAY_MODE_NORMAL;
   }
+
+  GST_OBJECT_LOCK (demux);
+  demux->trick_rate = ABS (rate);
+  demux->trick_proportion = 1.0;
+  demux->trick_first = GST_CLOCK_TIME_NONE;
+  demux->trick_last = GST_CLOCK_TIME_NONE;
+  demux->trick_gop = GST_CLOCK_TIME_NONE;
+  demux->trick_skipped = FALSE;
+  demux->trick_frames = 0;
+  demux->trick_skips = 0;
+  GST_OBJECT_UNLOCK (demux);
   GST_WARNING ("Seek to %" GST_TIME_FORMAT ".", GST_TIME_ARGS (desired_offset));
 
   demux->pending_event = FALSE;
 
+  /* a user seek is not an interleave seek */
+  demux->sched_pos_valid = FALSE;
+  demux->sched_offset_valid = FALSE;
+
 
   demux->valid_mask = 0;
 
@@ -3878,9 +5179,11 @@ aiurdemux_do_push_seek (GstAiurDemux * demux, GstPad * pad,
   }
 
   /* now do the seek, this actually never returns FALSE */
+  aiur_arena_set_current (demux->arena);
   ret =
       gst_aiurdemux_perform_seek (demux, &seeksegment,
       (flags & GST_SEEK_FLAG_ACCURATE));
+  aiur_arena_set_current (NULL);
 
   /* commit the new segment */
   memcpy (&demux->segment, &seeksegment, sizeof (GstSegment));
@@ -3954,6 +5257,9 @@ aiurdemux_do_seek (GstAiurDemux * demux, GstPad * pad, GstEvent * event)
   /* wait for previous seek event done */
   g_mutex_lock (&demux->seekmutex);
 
+  /* no read-ahead across the seek, the flush fails it upstream */
+  aiurcontent_pause_read_ahead (demux->content_info, TRUE);
+
   /* stop streaming by pausing the task */
   if (flush) {
     gst_aiurdemux_push_event (demux, gst_event_new_flush_start ());
@@ -3979,10 +5285,14 @@ aiurdemux_do_seek (GstAiurDemux * demux, GstPad * pad, GstEvent * event)
     gst_aiurdemux_push_event (demux, gst_event_new_flush_stop (TRUE));
   }
 
+  aiurcontent_pause_read_ahead (demux->content_info, FALSE);
+
   /* now do the seek, this actually never returns FALSE */
+  aiur_arena_set_current (demux->arena);
   ret =
       gst_aiurdemux_perform_seek (demux, &seeksegment,
       (flags & GST_SEEK_FLAG_ACCURATE));
+  aiur_arena_set_current (NULL);
 
   /* commit the new segment */
   memcpy (&demux->segment, &seeksegment, sizeof (GstSegment));
@@ -4049,6 +5359,10 @@ aiurdemux_release_resource (GstAiurDemux * demux)
         if(stream == NULL){
             continue;
         }
+        if (stream->pad_queue) {
+            aiur_pad_queue_free (stream->pad_queue);
+            stream->pad_queue = NULL;
+        }
         if (stream->pad) {
             gst_element_remove_pad (GST_ELEMENT_CAST (demux), stream->pad);
             stream->pad = NULL;
@@ -4075,10 +5389,7 @@ aiurdemux_release_resource (GstAiurDemux * demux)
         }
 
         if (stream->buf_queue) {
-            GstBuffer * gbuf;
-            while ((gbuf = g_queue_pop_head ((stream)->buf_queue))) {
-                gst_buffer_unref (gbuf);
-            };
+            aiurdemux_flush_queue (demux, stream);
             g_queue_free (stream->buf_queue);
             stream->buf_queue = NULL;
         }
@@ -4106,13 +5417,21 @@ gst_aiurdemux_close_core (GstAiurDemux * demux)
   AiurCoreInterface *IParser = demux->core_interface;
   FslParserHandle handle = demux->core_handle;
   gchar * index_file = NULL;
+  gboolean index_partial = demux->index_partial;
+
+  aiurdemux_stop_index_build (demux);
+  demux->index_partial = FALSE;
 
   if (IParser) {
     if (handle) {
 
-      index_file = aiurcontent_get_index_file(demux->content_info);
+      if (demux->option.index_enabled)
+        index_file = aiurcontent_get_index_file(demux->content_info);
 
-      if ((demux->option.index_enabled) &&(index_file)
+      /* do not overwrite cache with an index the core never completed,
+       * or built over a failed read */
+      if ((demux->option.index_enabled) &&(index_file) && (!index_partial)
+          && (!aiurcontent_has_read_error (demux->content_info))
           && (IParser->coreid) && (strlen (IParser->coreid))) {
         uint32 size = 0;
         AiurIndexTable *itab;
@@ -4135,9 +5454,14 @@ gst_aiurdemux_close_core (GstAiurDemux * demux)
           }
           core_ret =
               aiurdemux_export_idx_table (index_file, itab);
-          if (core_ret == 0)
+          if (core_ret == 0) {
+            gchar *dirname = g_path_get_dirname (index_file);
             GST_INFO ("Index table %s[size:%d] exported.",
                 index_file, size);
+            aiurdemux_trim_idx_cache (dirname,
+                demux->option.index_cache_budget);
+            g_free (dirname);
+          }
           aiurdemux_destroy_idx_table (itab);
         }
 
@@ -4152,6 +5476,191 @@ gst_aiurdemux_close_core (GstAiurDemux * demux)
   return GST_FLOW_OK;
 }
 
+static void
+aiurdemux_post_index_progress (GstAiurDemux * demux, gint progress,
+    gboolean done)
+{
+  gst_element_post_message (GST_ELEMENT_CAST (demux),
+      gst_message_new_element (GST_OBJECT_CAST (demux),
+          gst_structure_new ("GstAiurDemuxIndex",
+              "progress", G_TYPE_INT, progress,
+              "done", G_TYPE_BOOLEAN, done, NULL)));
+}
+
+/* runs a second parser instance over its own pull context, builds the
+ * full index and exports it to the index file */
+static gpointer
+aiurdemux_index_build_thread (gpointer data)
+{
+  GstAiurDemux *demux = (GstAiurDemux *) data;
+  AiurCoreInterface *IParser = demux->core_interface;
+  FslParserHandle handle = NULL;
+  FslFileStream file_cbks;
+  ParserMemoryOps mem_cbks;
+  ParserOutputBufferOps buf_cbks;
+  AiurIndexTable *itab = NULL;
+  gchar *index_file;
+  uint32 size = 0;
+  int32 core_ret;
+
+  /* lowest priority, playback must not starve */
+  setpriority (PRIO_PROCESS, syscall (SYS_gettid), 19);
+
+  aiur_arena_set_current (demux->arena);
+
+  memset (&file_cbks, 0, sizeof (file_cbks));
+  memset (&mem_cbks, 0, sizeof (mem_cbks));
+  memset (&buf_cbks, 0, sizeof (buf_cbks));
+  aiurcontent_get_pullfile_callback (demux->index_context, &file_cbks);
+  aiurcontent_get_memory_callback (demux->index_context, &mem_cbks);
+  aiurcontent_get_buffer_callback (demux->index_context, &buf_cbks);
+
+  if (IParser->createParser2) {
+    core_ret = IParser->createParser2 (FLAG_H264_NO_CONVERT, &file_cbks,
+        &mem_cbks, &buf_cbks, (void *) (demux->index_context), &handle);
+  } else {
+    core_ret = IParser->createParser (FALSE, &file_cbks, &mem_cbks,
+        &buf_cbks, (void *) (demux->index_context), &handle);
+  }
+  if ((core_ret != PARSER_SUCCESS) || (handle == NULL)) {
+    GST_WARNING_OBJECT (demux, "index build failed to create parser %d",
+        core_ret);
+    goto done;
+  }
+
+  core_ret = IParser->initializeIndex (handle);
+  if (core_ret != PARSER_SUCCESS) {
+    GST_WARNING_OBJECT (demux, "index build failed %d", core_ret);
+    goto done;
+  }
+  /* reads return nothing once cancelled or flushing, the index is
+   * truncated */
+  if (aiurcontent_is_cancelled (demux->index_context)
+      || aiurcontent_has_read_error (demux->index_context))
+    goto done;
+
+  core_ret = IParser->exportIndex (handle, NULL, &size);
+  if ((core_ret != PARSER_SUCCESS) || (size == 0)
+      || (size > AIUR_IDX_TABLE_MAX_SIZE)) {
+    goto done;
+  }
+
+  itab = aiurdemux_create_idx_table (size, IParser->coreid);
+  if (itab == NULL)
+    goto done;
+
+  core_ret = IParser->exportIndex (handle, itab->idx, &size);
+  if (core_ret != PARSER_SUCCESS) {
+    aiurdemux_destroy_idx_table (itab);
+    itab = NULL;
+    goto done;
+  }
+  itab->info.size = size;
+
+  index_file = aiurcontent_get_index_file (demux->content_info);
+  if (index_file && !aiurcontent_is_cancelled (demux->index_context)
+      && !aiurcontent_has_read_error (demux->index_context)
+      && (aiurdemux_export_idx_table (index_file, itab) == 0)) {
+    gchar *dirname = g_path_get_dirname (index_file);
+    GST_INFO_OBJECT (demux, "Index table %s[size:%d] built in background.",
+        index_file, size);
+    aiurdemux_trim_idx_cache (dirname, demux->option.index_cache_budget);
+    g_free (dirname);
+  }
+
+done:
+  if (handle)
+    IParser->deleteParser (handle);
+  aiur_arena_set_current (NULL);
+
+  demux->index_build_table = itab;
+  g_atomic_int_set (&demux->index_build_done, TRUE);
+
+  return NULL;
+}
+
+static gboolean
+aiurdemux_start_index_build (GstAiurDemux * demux)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+
+  if ((!demux->pullbased)
+      || (!aiurcontent_is_random_access (demux->content_info))
+      || (IParser->initializeIndex == NULL) || (IParser->importIndex == NULL)
+      || (IParser->exportIndex == NULL) || (IParser->coreid == NULL))
+    return FALSE;
+
+  demux->index_context = aiurcontent_new_index_context (demux->content_info);
+  if (demux->index_context == NULL)
+    return FALSE;
+
+  demux->index_build_done = FALSE;
+  demux->index_build_table = NULL;
+  demux->index_build_progress = -1;
+  demux->index_thread = g_thread_new ("aiur_index",
+      aiurdemux_index_build_thread, demux);
+  demux->index_partial = TRUE;
+
+  GST_INFO_OBJECT (demux, "start playback with partial index");
+
+  return TRUE;
+}
+
+/* called in streaming thread, the only one allowed to use core handle */
+static void
+aiurdemux_check_index_build (GstAiurDemux * demux)
+{
+  AiurCoreInterface *IParser = demux->core_interface;
+  gboolean done = g_atomic_int_get (&demux->index_build_done);
+  gint progress = aiurcontent_get_read_progress (demux->index_context);
+
+  if (done) {
+    AiurIndexTable *itab = demux->index_build_table;
+
+    g_thread_join (demux->index_thread);
+    demux->index_thread = NULL;
+
+    if (itab) {
+      if (IParser->importIndex (demux->core_handle, itab->idx,
+              itab->info.size) == PARSER_SUCCESS) {
+        GST_INFO_OBJECT (demux, "background index [size %d] imported",
+            itab->info.size);
+        demux->index_partial = FALSE;
+      }
+      aiurdemux_destroy_idx_table (itab);
+      demux->index_build_table = NULL;
+    }
+    aiurcontent_release (demux->index_context);
+    demux->index_context = NULL;
+    progress = 100;
+  }
+
+  if ((progress != demux->index_build_progress) || done) {
+    demux->index_build_progress = progress;
+    aiurdemux_post_index_progress (demux, progress, done);
+  }
+}
+
+static void
+aiurdemux_stop_index_build (GstAiurDemux * demux)
+{
+  if (demux->index_thread) {
+    aiurcontent_cancel (demux->index_context);
+    g_thread_join (demux->index_thread);
+    demux->index_thread = NULL;
+  }
+
+  if (demux->index_build_table) {
+    aiurdemux_destroy_idx_table (demux->index_build_table);
+    demux->index_build_table = NULL;
+  }
+
+  if (demux->index_context) {
+    aiurcontent_release (demux->index_context);
+    demux->index_context = NULL;
+  }
+}
+
 
 
 
@@ -48,6 +48,9 @@
 #include "aiurstreamcache.h"
 #include "aiuridxtab.h"
 #include "aiurcontent.h"
+#include "aiursamplepool.h"
+#include "aiurarena.h"
+#include "aiurpadqueue.h"
 
 G_BEGIN_DECLS
 
@@ -83,6 +86,21 @@ GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
 #define AIURDEMUX_TIMESTAMP_DISCONT_MAX_GAP   (10*GST_SECOND)
 #define AIURDEMUX_TIMESTAMP_LAG_MAX_TIME      (10*GST_SECOND)
 #define AIURDEMUX_PIPELINE_LATENCY            120000000
+/* adaptive live latency: margin over 4x jitter, samples before first
+ * update, relative change needed before reporting a new value */
+#define AIURDEMUX_LIVE_LATENCY_MARGIN         (20*GST_MSECOND)
+#define AIURDEMUX_LIVE_LATENCY_WARMUP         64
+#define AIURDEMUX_LIVE_LATENCY_HYSTERESIS     4
+#define AIURDEMUX_LIVE_LATENCY_HYSTERESIS_MIN (10*GST_MSECOND)
+#define AIURDEMUX_LIVE_JITTER_MAX_STEP        GST_SECOND
+
+/* queue level messages are posted in steps of this percent */
+#define AIURDEMUX_QUEUE_LEVEL_STEP            10
+
+/* movie loops to wait for first buffers on all pads before image tags */
+#define AIURDEMUX_IMAGE_TAG_WAIT              64
+/* reads allowed beyond max-image-tag-size for the atoms around an image */
+#define AIURDEMUX_IMAGE_TAG_SLACK             65536
 
 #define GST_BUFFER_TIMESTAMP GST_BUFFER_PTS
 
@@ -97,6 +115,28 @@ enum
   PROP_INDEX_ENABLED,
   PROP_DISABLE_VORBIS_CODEC_DATA,
   PROP_LOW_LATENCY_TOLERANCE,
+  PROP_STREAM_CACHE_PRESERVE_SIZE,
+  PROP_BLOCK_CACHE_BLOCK_SIZE,
+  PROP_BLOCK_CACHE_BLOCKS,
+  PROP_SAMPLE_POOL_BUDGET,
+  PROP_INDEX_CACHE_BUDGET,
+  PROP_INDEX_BUILD_ASYNC,
+  PROP_INTERLEAVE_TIME_SKEW,
+  PROP_PARTIAL_SAMPLE_CONTIGUOUS,
+  PROP_DISABLE_UNLINKED_TRACKS,
+  PROP_STREAM_CACHE_MAX_SKIP,
+  PROP_ADAPTIVE_LATENCY,
+  PROP_MIN_LATENCY,
+  PROP_QUEUE_BUDGET,
+  PROP_MAX_IMAGE_TAG_SIZE,
+  PROP_PUSH_THREADS,
+  PROP_PUSH_QUEUE_SIZE,
+  PROP_PUSH_QUEUE_SKEW,
+  PROP_TRICK_FPS,
+  PROP_MMAP,
+  PROP_MMAP_READAHEAD,
+  PROP_STATS,
+  PROP_STARTUP_STATS,
 };
 
 
@@ -115,6 +155,27 @@ enum
   AIURDEMUX_STATE_MOVIE,        /* Parsing/Playing the media data */
 };
 
+#define AIURDEMUX_STATE_NUM (AIURDEMUX_STATE_MOVIE + 1)
+#define AIURDEMUX_PAD_NAME_LEN 32
+/* startup is reported after this many buffers even if a late or sparse
+ * track has not sent one yet */
+#define AIURDEMUX_STARTUP_MAX_BUFFERS 256
+
+/* where the time goes until every pad has sent its first buffer */
+typedef struct
+{
+  GstClockTime start;
+  GstClockTime stamp;
+  AiurContentIoStats io;
+  GstClockTime state_time[AIURDEMUX_STATE_NUM];
+  AiurContentIoStats state_io[AIURDEMUX_STATE_NUM];
+  guint n_pads;
+  gchar pad_name[GST_AIURDEMUX_MAX_STREAMS][AIURDEMUX_PAD_NAME_LEN];
+  GstClockTime first_buffer[GST_AIURDEMUX_MAX_STREAMS];
+  guint buffers;
+  gboolean done;
+} AiurDemuxStartupStat;
+
 
 typedef struct _GstAiurDemuxClass GstAiurDemuxClass;
 typedef struct _AiurDemuxStream AiurDemuxStream;
@@ -149,6 +210,26 @@ typedef struct _AiurDemuxOption
   gboolean merge_h264_codec_data;
   gboolean disable_vorbis_codec_data;
   gint low_latency_tolerance;
+  guint stream_cache_preserve_size;
+  guint block_cache_block_size;
+  guint block_cache_blocks;
+  guint sample_pool_budget;
+  guint index_cache_budget;
+  gboolean index_build_async;
+  guint interleave_time_skew;
+  gboolean partial_sample_contiguous;
+  gboolean disable_unlinked_tracks;
+  guint stream_cache_max_skip;
+  gboolean adaptive_latency;
+  guint min_latency;
+  guint queue_budget;
+  guint max_image_tag_size;
+  gboolean push_threads;
+  guint push_queue_size;
+  guint push_queue_skew;
+  guint trick_fps;
+  gboolean mmap;
+  guint mmap_readahead;
 } AiurDemuxOption;
 
 
@@ -259,6 +340,12 @@ struct _AiurDemuxStream
     gboolean send_codec_data;
     gboolean merge_codec_data;
 
+    /* track disabled in core because its pad is not linked */
+    gboolean disabled;
+    volatile gint relink;
+    /* file mode relink read the file again from here, drop up to it */
+    GstClockTime resume_after;
+
     GQueue *buf_queue;
     guint buf_queue_size;
     guint buf_queue_size_max;
@@ -273,8 +360,13 @@ struct _AiurDemuxStream
     gint64 last_start;
     gint64 last_timestamp;
     gint64 lag_time;
+    GstClockTimeDiff last_transit;
+    gboolean transit_valid;
     GstFlowReturn last_ret;
 
+    /* output queue and push thread of the pad, push-threads only */
+    AiurPadQueue *pad_queue;
+
     
 
 };
@@ -307,6 +399,11 @@ struct _GstAiurDemux
 
     GstAiurStreamCache *stream_cache;
     AiurContent * content_info;
+    AiurSamplePool *sample_pool;
+
+    /* core memory of this instance, kept until the core is deleted */
+    AiurArena *arena;
+    AiurArenaStats arena_stats;
 
     
     /* core interface */
@@ -329,11 +426,71 @@ struct _GstAiurDemux
     GstClockTimeDiff media_offset;
     GstClockTimeDiff avg_diff;
 
+    /* live latency following arrival jitter */
+    GstClockTime live_latency;
+    /* live_latency in the timestamp offset, follows it with the latency
+     * event so the offset moves only with pipeline_latency */
+    GstClockTime live_latency_applied;
+    GstClockTime live_jitter;
+    guint live_jitter_samples;
+    guint64 live_latency_changes;
+
     AiurDemuxOption option;
 
     GThread *thread;  // for push mode thread
     GMutex seekmutex;
 
+    /* background index build */
+    GThread *index_thread;
+    AiurContent *index_context;
+    volatile gint index_build_done;
+    AiurIndexTable *index_build_table;
+    gint index_build_progress;
+    gboolean index_partial;
+
+    /* offset ordered read scheduling for track mode */
+    gboolean sched_offset_valid;
+    guint64 sched_offset;
+    gboolean sched_pos_valid;
+    guint64 sched_pos;
+    guint64 sched_seek_bytes;
+    guint64 sched_seeks;
+    GstClockTime sched_time_start;
+    GstClockTime sched_time_last;
+
+    guint64 tracks_disabled;
+    guint64 tracks_reenabled;
+
+    /* bytes held in interleave queues of all streams, file mode only */
+    guint64 queued_bytes;
+    guint64 queued_bytes_peak;
+    guint64 queue_drains;
+    gint queue_level;
+
+    /* image tags extracted after movie state starts */
+    gboolean image_tags_pending;
+    guint image_tags_wait;
+    guint64 image_tags;
+    guint64 image_tag_bytes;
+    guint64 image_tags_skipped;
+
+    /* per pad push threads, NULL when pushing from the demux task */
+    AiurPadQueueGroup *pad_queues;
+
+    /* keyframe selection of trick modes */
+    gdouble trick_rate;
+    gdouble trick_proportion;
+    GstClockTime trick_first;
+    GstClockTime trick_last;
+    /* key frame spacing of the file, measured only between frames
+     * with no skip in between */
+    GstClockTime trick_gop;
+    gboolean trick_skipped;
+    guint64 trick_frames;
+    guint64 trick_skips;
+
+    AiurDemuxStartupStat startup;
+
 };
 
 struct _GstAiurDemuxClass
@@ -35,84 +35,105 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "aiurdemux.h"
 
-
 #define AIUR_IDX_TABLE_MAGIC 0x72756961
-#define AIUR_IDX_TABLE_VERSION 0x3
-
-#define AIUR_IDX_TABLE_HEAD_SIZE (sizeof(AiurIdxTabHead)+sizeof(AiurIdxTabInfo)+sizeof(gint))
-
-
-static unsigned char CRC_table_h[] = {
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-  0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-  0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41,
-  0x00, 0xC1, 0x81, 0x40
-};
-
-static unsigned char CRC_talbe_l[] = {
-  0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06, 0x07, 0xC7,
-  0x05, 0xC5, 0xC4, 0x04, 0xCC, 0x0C, 0x0D, 0xCD, 0x0F, 0xCF, 0xCE, 0x0E,
-  0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09, 0x08, 0xC8, 0xD8, 0x18, 0x19, 0xD9,
-  0x1B, 0xDB, 0xDA, 0x1A, 0x1E, 0xDE, 0xDF, 0x1F, 0xDD, 0x1D, 0x1C, 0xDC,
-  0x14, 0xD4, 0xD5, 0x15, 0xD7, 0x17, 0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3,
-  0x11, 0xD1, 0xD0, 0x10, 0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3, 0xF2, 0x32,
-  0x36, 0xF6, 0xF7, 0x37, 0xF5, 0x35, 0x34, 0xF4, 0x3C, 0xFC, 0xFD, 0x3D,
-  0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A, 0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38,
-  0x28, 0xE8, 0xE9, 0x29, 0xEB, 0x2B, 0x2A, 0xEA, 0xEE, 0x2E, 0x2F, 0xEF,
-  0x2D, 0xED, 0xEC, 0x2C, 0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26,
-  0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21, 0x20, 0xE0, 0xA0, 0x60, 0x61, 0xA1,
-  0x63, 0xA3, 0xA2, 0x62, 0x66, 0xA6, 0xA7, 0x67, 0xA5, 0x65, 0x64, 0xA4,
-  0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F, 0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB,
-  0x69, 0xA9, 0xA8, 0x68, 0x78, 0xB8, 0xB9, 0x79, 0xBB, 0x7B, 0x7A, 0xBA,
-  0xBE, 0x7E, 0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C, 0xB4, 0x74, 0x75, 0xB5,
-  0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71, 0x70, 0xB0,
-  0x50, 0x90, 0x91, 0x51, 0x93, 0x53, 0x52, 0x92, 0x96, 0x56, 0x57, 0x97,
-  0x55, 0x95, 0x94, 0x54, 0x9C, 0x5C, 0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E,
-  0x5A, 0x9A, 0x9B, 0x5B, 0x99, 0x59, 0x58, 0x98, 0x88, 0x48, 0x49, 0x89,
-  0x4B, 0x8B, 0x8A, 0x4A, 0x4E, 0x8E, 0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C,
-  0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42, 0x43, 0x83,
-  0x41, 0x81, 0x80, 0x40
-};
-
-
-static unsigned int
-calcCRC16 (unsigned char *buf, int len)
+#define AIUR_IDX_TABLE_VERSION 0x4
+
+#define AIUR_IDX_TABLE_ALIGN(x) (((x) + 7) & ~7)
+
+/* on-disk layout, index data is 8 bytes aligned so it is used from the
+ * mapping directly:
+ * | AiurIdxTabFileHead | coreid | pad | index data | */
+typedef struct
+{
+  guint magic;
+  guint version;
+  guint coreid_len;
+  guint idx_offset;
+  guint idx_size;
+  guint idx_crc;                /* crc32c of index data */
+  guint head_crc;               /* crc32c of head (head_crc as 0) and coreid */
+  guint reserved;
+} AiurIdxTabFileHead;
+
+static guint32 crc32c_table[4][256];
+
+static void
+aiurdemux_crc32c_init (void)
+{
+  static gsize inited = 0;
+
+  if (g_once_init_enter (&inited)) {
+    guint32 i, j, crc;
+
+    for (i = 0; i < 256; i++) {
+      crc = i;
+      for (j = 0; j < 8; j++) {
+        crc = (crc & 1) ? ((crc >> 1) ^ 0x82F63B78) : (crc >> 1);
+      }
+      crc32c_table[0][i] = crc;
+    }
+    for (i = 0; i < 256; i++) {
+      crc = crc32c_table[0][i];
+      for (j = 1; j < 4; j++) {
+        crc = (crc >> 8) ^ crc32c_table[0][crc & 0xff];
+        crc32c_table[j][i] = crc;
+      }
+    }
+    g_once_init_leave (&inited, 1);
+  }
+}
+
+guint32
+aiurdemux_crc32c (guint32 crc, const guint8 * buf, gsize len)
 {
-  unsigned char high = 0;
-  unsigned char low = 0;
-  int index = 0;
-  int i;
-  for (i = 0; i < len; i++) {
-    index = low ^ buf[i];
-    low = high ^ CRC_table_h[index];
-    high = CRC_talbe_l[index];
+  aiurdemux_crc32c_init ();
+
+  crc = ~crc;
+
+  while (len && ((gsize) buf & 3)) {
+    crc = crc32c_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+    len--;
   }
 
-  index = high;
-  index = index << 8;
-  index |= low;
-  return index;
+  /* slicing by 4 */
+  while (len >= 4) {
+    crc ^= GUINT32_FROM_LE (*(const guint32 *) buf);
+    crc = crc32c_table[3][crc & 0xff]
+        ^ crc32c_table[2][(crc >> 8) & 0xff]
+        ^ crc32c_table[1][(crc >> 16) & 0xff]
+        ^ crc32c_table[0][crc >> 24];
+    buf += 4;
+    len -= 4;
+  }
+
+  while (len--) {
+    crc = crc32c_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+  }
+
+  return ~crc;
+}
+
+static guint32
+aiurdemux_idx_head_crc (const AiurIdxTabFileHead * head, const gchar * coreid)
+{
+  AiurIdxTabFileHead tmp = *head;
+  guint32 crc;
+
+  tmp.head_crc = 0;
+  crc = aiurdemux_crc32c (0, (const guint8 *) &tmp, sizeof (tmp));
+  if (head->coreid_len)
+    crc = aiurdemux_crc32c (crc, (const guint8 *) coreid, head->coreid_len);
+
+  return crc;
 }
 
 void
@@ -122,9 +143,12 @@ aiurdemux_destroy_idx_table (AiurIndexTable * idxtable)
     if (idxtable->coreid) {
       g_free (idxtable->coreid);
     }
-    if (idxtable->idx) {
+    if (idxtable->map) {
+      munmap (idxtable->map, idxtable->map_size);
+    } else if (idxtable->idx) {
       g_free (idxtable->idx);
     }
+    g_free (idxtable);
   }
 }
 
@@ -165,78 +189,87 @@ AiurIndexTable *
 aiurdemux_import_idx_table (gchar * filename)
 {
   AiurIndexTable *idxtable = aiurdemux_create_idx_table (0, NULL);
-  FILE *fd = fopen (filename, "r");
-  unsigned int crc;
+  AiurIdxTabFileHead *head;
+  struct stat st;
+  guint8 *map = MAP_FAILED;
+  gsize map_size = 0;
+  int fd = open (filename, O_RDONLY);
 
+  if ((fd < 0) || (idxtable == NULL))
+    goto fail;
+
+  if ((fstat (fd, &st) != 0) || (st.st_size < 0)
+      || ((guint64) st.st_size < sizeof (AiurIdxTabFileHead)))
+    goto fail;
 
-  if ((fd == NULL) || (idxtable == NULL))
+  /* importIndex takes the data as writable, a core patching it in place
+   * gets private copies of the pages it touches */
+  map_size = st.st_size;
+  map = mmap (NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED)
     goto fail;
 
+  head = (AiurIdxTabFileHead *) map;
 
-  if (fread (idxtable, 1, AIUR_IDX_TABLE_HEAD_SIZE,
-          fd) < AIUR_IDX_TABLE_HEAD_SIZE) {
+  if ((head->magic != AIUR_IDX_TABLE_MAGIC)
+      || (head->version != AIUR_IDX_TABLE_VERSION)) {
     goto fail;
   }
 
-  if ((idxtable->head.magic != AIUR_IDX_TABLE_MAGIC)
-      || (idxtable->head.version != AIUR_IDX_TABLE_VERSION)) {
+  if ((head->idx_size > AIUR_IDX_TABLE_MAX_SIZE)
+      || (head->coreid_len > map_size - sizeof (AiurIdxTabFileHead))
+      || (head->idx_offset < sizeof (AiurIdxTabFileHead) + head->coreid_len)
+      || (head->idx_offset > map_size)
+      || (head->idx_size > map_size - head->idx_offset)) {
     goto fail;
   }
 
-  if ((idxtable->info.size > AIUR_IDX_TABLE_MAX_SIZE)) {
+  if (aiurdemux_idx_head_crc (head,
+          (const gchar *) (map + sizeof (AiurIdxTabFileHead))) !=
+      head->head_crc) {
     goto fail;
   }
 
-  if (idxtable->coreid_len) {
-    gchar *coreid = g_try_malloc (idxtable->coreid_len);
-    if (coreid == NULL)
-      goto fail;
-
-    if (fread (coreid, 1, idxtable->coreid_len, fd) < 1) {
-      g_free (coreid);
-      goto fail;
-    }
-
-    idxtable->coreid = coreid;
+  if (aiurdemux_crc32c (0, map + head->idx_offset, head->idx_size) !=
+      head->idx_crc) {
+    goto fail;
   }
 
-  if (idxtable->info.size) {
-    gchar *index = g_try_malloc (idxtable->info.size);
-    if (index == NULL)
-      goto fail;
-
-    if (fread (index, 1, idxtable->info.size, fd) < 1) {
-      g_free (index);
-      goto fail;
-    }
-
-    if (fread (&idxtable->crc, sizeof (unsigned int), 1, fd) < 1) {
-      g_free (index);
+  if (head->coreid_len) {
+    idxtable->coreid = g_try_malloc (head->coreid_len);
+    if (idxtable->coreid == NULL)
       goto fail;
-    }
+    memcpy (idxtable->coreid, map + sizeof (AiurIdxTabFileHead),
+        head->coreid_len);
+    idxtable->coreid_len = head->coreid_len;
+  }
 
-    crc = calcCRC16 (index, idxtable->info.size);
+  /* index data is used in place */
+  idxtable->map = map;
+  idxtable->map_size = map_size;
+  if (head->idx_size)
+    idxtable->idx = map + head->idx_offset;
+  idxtable->info.size = head->idx_size;
+  idxtable->crc = head->idx_crc;
 
-    if (crc != idxtable->crc) {
-      g_free (index);
-      goto fail;
-    }
-    idxtable->idx = index;
-  }
+  close (fd);
 
-  if (fd) {
-    fclose (fd);
-  }
+  /* mark as recently used for cache eviction */
+  utime (filename, NULL);
 
   return idxtable;
 fail:
+  if (map != MAP_FAILED) {
+    munmap (map, map_size);
+  }
+
   if (idxtable) {
     aiurdemux_destroy_idx_table (idxtable);
     idxtable = NULL;
   }
 
-  if (fd) {
-    fclose (fd);
+  if (fd >= 0) {
+    close (fd);
   }
   return idxtable;
 }
@@ -245,20 +278,34 @@ fail:
 int
 aiurdemux_export_idx_table (const char *filename, AiurIndexTable * itab)
 {
+  AiurIdxTabFileHead head;
+  static const guint8 pad[8] = { 0 };
+  gchar *tmpname = NULL;
   FILE *fd = NULL;
-  unsigned int buf;
   int ret = -1;
 
   if ((itab == NULL) || (itab->info.size > AIUR_IDX_TABLE_MAX_SIZE)) {
     goto fail;
   }
 
-  fd = fopen (filename, "w");
+  memset (&head, 0, sizeof (head));
+  head.magic = AIUR_IDX_TABLE_MAGIC;
+  head.version = AIUR_IDX_TABLE_VERSION;
+  head.coreid_len = itab->coreid_len;
+  head.idx_offset =
+      AIUR_IDX_TABLE_ALIGN (sizeof (AiurIdxTabFileHead) + itab->coreid_len);
+  head.idx_size = itab->info.size;
+  head.idx_crc = aiurdemux_crc32c (0, itab->idx, itab->info.size);
+  head.head_crc = aiurdemux_idx_head_crc (&head, itab->coreid);
+
+  /* write aside and rename, a reader never sees a partial file */
+  tmpname = g_strdup_printf ("%s.%d.tmp", filename, getpid ());
+  fd = fopen (tmpname, "w");
   if (fd == NULL) {
     goto fail;
   }
 
-  if (fwrite (itab, 1, AIUR_IDX_TABLE_HEAD_SIZE, fd) < AIUR_IDX_TABLE_HEAD_SIZE) {
+  if (fwrite (&head, 1, sizeof (head), fd) < sizeof (head)) {
     goto fail;
   }
 
@@ -270,23 +317,125 @@ aiurdemux_export_idx_table (const char *filename, AiurIndexTable * itab)
 
   }
 
+  if (fwrite (pad, 1, head.idx_offset - sizeof (head) - itab->coreid_len,
+          fd) < head.idx_offset - sizeof (head) - itab->coreid_len) {
+    goto fail;
+  }
+
   if (itab->info.size) {
 
     if (fwrite (itab->idx, 1, itab->info.size, fd) < itab->info.size) {
       goto fail;
     }
+  }
 
-    buf = calcCRC16 (itab->idx, itab->info.size);
-
-    if (fwrite (&buf, sizeof (unsigned int), 1, fd) < 1) {
-      goto fail;
-    }
+  if (fclose (fd) == 0) {
+    fd = NULL;
+    if (rename (tmpname, filename) == 0)
+      ret = 0;
   }
-  ret = 0;
 fail:
 
   if (fd) {
     fclose (fd);
   }
+  if (tmpname) {
+    if (ret)
+      unlink (tmpname);
+    g_free (tmpname);
+  }
   return ret;
 }
+
+typedef struct
+{
+  gchar *path;
+  guint64 size;
+  time_t mtime;
+} AiurIdxCacheEntry;
+
+static gint
+aiurdemux_idx_cache_entry_compare (gconstpointer a, gconstpointer b)
+{
+  const AiurIdxCacheEntry *ea = a;
+  const AiurIdxCacheEntry *eb = b;
+
+  if (ea->mtime == eb->mtime)
+    return 0;
+  return (ea->mtime < eb->mtime) ? -1 : 1;
+}
+
+/* suffix NULL counts index and probe files */
+static void
+aiurdemux_trim_cache_files (const gchar * dirname, const gchar * suffix,
+    guint64 budget)
+{
+  GDir *dir;
+  const gchar *name;
+  GList *entries = NULL, *item;
+  guint64 total = 0;
+
+  if ((dirname == NULL) || (budget == 0))
+    return;
+
+  dir = g_dir_open (dirname, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir))) {
+    AiurIdxCacheEntry *entry;
+    struct stat st;
+    gchar *path;
+
+    /* stream info probes share the directory and the budget */
+    if (suffix) {
+      if (!g_str_has_suffix (name, suffix))
+        continue;
+    } else if (!g_str_has_suffix (name, ".aidx")
+        && !g_str_has_suffix (name, ".aprobe")) {
+      continue;
+    }
+
+    path = g_build_filename (dirname, name, NULL);
+    if (stat (path, &st) != 0) {
+      g_free (path);
+      continue;
+    }
+
+    entry = g_new0 (AiurIdxCacheEntry, 1);
+    entry->path = path;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entries = g_list_prepend (entries, entry);
+    total += entry->size;
+  }
+  g_dir_close (dir);
+
+  /* least recently used first */
+  entries = g_list_sort (entries, aiurdemux_idx_cache_entry_compare);
+
+  for (item = entries; item; item = item->next) {
+    AiurIdxCacheEntry *entry = item->data;
+
+    if ((total > budget) && (unlink (entry->path) == 0)) {
+      GST_INFO ("Cache file %s evicted, cache size %lld budget %lld",
+          entry->path, total, budget);
+      total -= entry->size;
+    }
+    g_free (entry->path);
+    g_free (entry);
+  }
+  g_list_free (entries);
+}
+
+void
+aiurdemux_trim_idx_cache (const gchar * dirname, guint64 budget)
+{
+  aiurdemux_trim_cache_files (dirname, NULL, budget);
+}
+
+void
+aiurdemux_trim_probe_cache (const gchar * dirname, guint64 budget)
+{
+  aiurdemux_trim_cache_files (dirname, ".aprobe", budget);
+}
@@ -61,6 +61,8 @@ typedef struct
   gchar *coreid;
   unsigned char *idx;
   unsigned int crc;
+  void *map;                    /* imported file mapping, idx points in it */
+  gsize map_size;
 } AiurIndexTable;
 
 
@@ -72,6 +74,14 @@ AiurIndexTable *aiurdemux_import_idx_table (gchar * filename);
 int
 aiurdemux_export_idx_table (const char *filename, AiurIndexTable * itab);
 
+/* remove least recently used index and probe files until dirname fits
+ * in budget */
+void aiurdemux_trim_idx_cache (const gchar * dirname, guint64 budget);
+/* the same for probe files only, index files are never evicted by it */
+void aiurdemux_trim_probe_cache (const gchar * dirname, guint64 budget);
+
+guint32 aiurdemux_crc32c (guint32 crc, const guint8 * buf, gsize len);
+
 
 
 #endif /* __AIURIDXTAB_H__ */
@@ -0,0 +1,455 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurpadqueue.c
+ *
+ * Description:    Implementation of per source pad output queues. The
+ *                 demux task only blocks when the queue of the pad it
+ *                 reads for is full, a slow consumer holds back its own
+ *                 pad. Paced queues do not push further than the skew
+ *                 ahead of the others so audio and video stay in step.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include "aiurpadqueue.h"
+
+GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
+#define GST_CAT_DEFAULT aiurdemux_debug
+
+typedef struct
+{
+  guint64 pushed;               /* buffers pushed downstream */
+  GstClockTime block_time;      /* demux blocked on the full queue */
+  GstClockTime wait_time;       /* push held back to stay in step */
+} AiurPadQueueStats;
+
+struct _AiurPadQueueGroup
+{
+  GMutex lock;
+  GCond cond;                   /* any change of any queue */
+  guint max_items;
+  GstClockTime skew;
+  gboolean flushing;
+  GList *queues;
+};
+
+struct _AiurPadQueue
+{
+  AiurPadQueueGroup *group;
+  GstPad *pad;
+  gboolean paced;
+  GThread *thread;
+  gboolean stop;
+
+  GQueue items;
+  guint64 bytes;
+  gboolean eos;
+
+  /* item taken by the push thread and not yet returned from downstream */
+  gboolean busy;
+  GstClockTime busy_ts;
+
+  GstFlowReturn last_ret;
+  AiurPadQueueStats stats;
+};
+
+/* called with lock, timestamp of what the queue pushes now or next */
+static GstClockTime
+aiur_pad_queue_position (AiurPadQueue * queue)
+{
+  GList *item;
+
+  if ((queue->busy) && (GST_CLOCK_TIME_IS_VALID (queue->busy_ts)))
+    return queue->busy_ts;
+
+  for (item = queue->items.head; item; item = item->next) {
+    if (GST_IS_BUFFER (item->data))
+      return GST_BUFFER_DTS_OR_PTS (GST_BUFFER_CAST (item->data));
+  }
+
+  return GST_CLOCK_TIME_NONE;
+}
+
+/* called with lock, TRUE if ts is more than the skew ahead of another
+ * paced queue which still has data to push */
+static gboolean
+aiur_pad_queue_ahead (AiurPadQueue * queue, GstClockTime ts)
+{
+  AiurPadQueueGroup *group = queue->group;
+  GList *item;
+
+  for (item = group->queues; item; item = item->next) {
+    AiurPadQueue *other = item->data;
+    GstClockTime position;
+
+    if ((other == queue) || (!other->paced))
+      continue;
+
+    position = aiur_pad_queue_position (other);
+    if ((GST_CLOCK_TIME_IS_VALID (position))
+        && (ts > position + group->skew))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* called with lock, a full queue may overrun while another paced queue
+ * is starving, as the demuxer has to read through this one to feed it */
+static gboolean
+aiur_pad_queue_full (AiurPadQueue * queue)
+{
+  AiurPadQueueGroup *group = queue->group;
+  guint len = g_queue_get_length (&queue->items);
+  GList *item;
+
+  if (len < group->max_items)
+    return FALSE;
+
+  if (len >= group->max_items * AIUR_PAD_QUEUE_OVERRUN)
+    return TRUE;
+
+  for (item = group->queues; item; item = item->next) {
+    AiurPadQueue *other = item->data;
+
+    if ((other != queue) && (other->paced) && (!other->eos)
+        && (!other->busy) && (g_queue_is_empty (&other->items)))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* called with lock */
+static void
+aiur_pad_queue_drain (AiurPadQueue * queue)
+{
+  GstMiniObject *item;
+
+  while ((item = g_queue_pop_head (&queue->items)))
+    gst_mini_object_unref (item);
+  queue->bytes = 0;
+  queue->eos = FALSE;
+}
+
+static gpointer
+aiur_pad_queue_loop (AiurPadQueue * queue)
+{
+  AiurPadQueueGroup *group = queue->group;
+
+  g_mutex_lock (&group->lock);
+  while (!queue->stop) {
+    GstMiniObject *item;
+    GstClockTime ts = GST_CLOCK_TIME_NONE;
+    gboolean is_buffer;
+    GstFlowReturn ret;
+
+    item = g_queue_peek_head (&queue->items);
+    if (item == NULL) {
+      g_cond_wait (&group->cond, &group->lock);
+      continue;
+    }
+
+    is_buffer = GST_IS_BUFFER (item);
+    if (is_buffer) {
+      ts = GST_BUFFER_DTS_OR_PTS (GST_BUFFER_CAST (item));
+
+      /* wait at most the skew, a queue held back by a downstream
+       * element prerolling must not hold back the others forever */
+      if ((queue->paced) && (group->skew)
+          && (GST_CLOCK_TIME_IS_VALID (ts))
+          && (aiur_pad_queue_ahead (queue, ts))) {
+        GstClockTime start = gst_util_get_timestamp ();
+        gint64 end_time = g_get_monotonic_time ()
+            + group->skew / GST_USECOND;
+
+        while ((!queue->stop) && (item == g_queue_peek_head (&queue->items))
+            && (aiur_pad_queue_ahead (queue, ts))) {
+          if (!g_cond_wait_until (&group->cond, &group->lock, end_time))
+            break;
+        }
+        queue->stats.wait_time += gst_util_get_timestamp () - start;
+
+        if ((queue->stop) || (item != g_queue_peek_head (&queue->items)))
+          continue;
+      }
+    }
+
+    g_queue_pop_head (&queue->items);
+    if (is_buffer)
+      queue->bytes -= gst_buffer_get_size (GST_BUFFER_CAST (item));
+    queue->busy = TRUE;
+    queue->busy_ts = ts;
+    ret = queue->last_ret;
+    g_cond_broadcast (&group->cond);
+    g_mutex_unlock (&group->lock);
+
+    if (is_buffer) {
+      if ((ret == GST_FLOW_FLUSHING) || (ret < GST_FLOW_EOS)) {
+        gst_mini_object_unref (item);
+      } else {
+        ret = gst_pad_push (queue->pad, GST_BUFFER_CAST (item));
+      }
+    } else {
+      gst_pad_push_event (queue->pad, GST_EVENT_CAST (item));
+    }
+
+    g_mutex_lock (&group->lock);
+    queue->busy = FALSE;
+    queue->busy_ts = GST_CLOCK_TIME_NONE;
+    if (is_buffer) {
+      queue->stats.pushed++;
+      if (!group->flushing)
+        queue->last_ret = ret;
+    }
+    g_cond_broadcast (&group->cond);
+  }
+  g_mutex_unlock (&group->lock);
+
+  return NULL;
+}
+
+AiurPadQueueGroup *
+aiur_pad_queue_group_new (guint max_items, GstClockTime skew)
+{
+  AiurPadQueueGroup *group = g_new0 (AiurPadQueueGroup, 1);
+
+  g_mutex_init (&group->lock);
+  g_cond_init (&group->cond);
+  group->max_items = MAX (max_items, 1);
+  group->skew = skew;
+
+  return group;
+}
+
+void
+aiur_pad_queue_group_free (AiurPadQueueGroup * group)
+{
+  if (group == NULL)
+    return;
+
+  if (group->queues) {
+    GST_WARNING ("pad queue group released with %d queues",
+        g_list_length (group->queues));
+  }
+
+  g_cond_clear (&group->cond);
+  g_mutex_clear (&group->lock);
+  g_free (group);
+}
+
+void
+aiur_pad_queue_group_set_flushing (AiurPadQueueGroup * group,
+    gboolean flushing)
+{
+  GList *item;
+
+  if (group == NULL)
+    return;
+
+  g_mutex_lock (&group->lock);
+  group->flushing = TRUE;
+
+  for (item = group->queues; item; item = item->next)
+    aiur_pad_queue_drain (item->data);
+  g_cond_broadcast (&group->cond);
+
+  if (!flushing) {
+    /* downstream is still flushing, pushes in flight return soon */
+    for (item = group->queues; item;) {
+      AiurPadQueue *queue = item->data;
+
+      if (queue->busy) {
+        g_cond_wait (&group->cond, &group->lock);
+        item = group->queues;
+        continue;
+      }
+      item = item->next;
+    }
+
+    for (item = group->queues; item; item = item->next) {
+      AiurPadQueue *queue = item->data;
+      aiur_pad_queue_drain (queue);
+      queue->last_ret = GST_FLOW_OK;
+    }
+    group->flushing = FALSE;
+  }
+  g_mutex_unlock (&group->lock);
+}
+
+AiurPadQueue *
+aiur_pad_queue_new (AiurPadQueueGroup * group, GstPad * pad, gboolean paced)
+{
+  AiurPadQueue *queue;
+
+  if ((group == NULL) || (pad == NULL))
+    return NULL;
+
+  queue = g_new0 (AiurPadQueue, 1);
+  queue->group = group;
+  queue->pad = gst_object_ref (pad);
+  queue->paced = paced;
+  queue->busy_ts = GST_CLOCK_TIME_NONE;
+  queue->last_ret = GST_FLOW_OK;
+  g_queue_init (&queue->items);
+
+  g_mutex_lock (&group->lock);
+  group->queues = g_list_append (group->queues, queue);
+  g_mutex_unlock (&group->lock);
+
+  queue->thread = g_thread_new ("aiur_pad_push",
+      (GThreadFunc) aiur_pad_queue_loop, queue);
+
+  GST_DEBUG ("pad queue for %s:%s, paced %d", GST_DEBUG_PAD_NAME (pad),
+      paced);
+
+  return queue;
+}
+
+void
+aiur_pad_queue_free (AiurPadQueue * queue)
+{
+  AiurPadQueueGroup *group;
+
+  if (queue == NULL)
+    return;
+
+  group = queue->group;
+
+  g_mutex_lock (&group->lock);
+  queue->stop = TRUE;
+  g_cond_broadcast (&group->cond);
+  g_mutex_unlock (&group->lock);
+
+  g_thread_join (queue->thread);
+
+  g_mutex_lock (&group->lock);
+  group->queues = g_list_remove (group->queues, queue);
+  aiur_pad_queue_drain (queue);
+  g_cond_broadcast (&group->cond);
+  g_mutex_unlock (&group->lock);
+
+  GST_DEBUG ("pad queue for %s:%s pushed %lld, blocked %" GST_TIME_FORMAT
+      ", waited %" GST_TIME_FORMAT, GST_DEBUG_PAD_NAME (queue->pad),
+      queue->stats.pushed, GST_TIME_ARGS (queue->stats.block_time),
+      GST_TIME_ARGS (queue->stats.wait_time));
+
+  gst_object_unref (queue->pad);
+  g_free (queue);
+}
+
+GstFlowReturn
+aiur_pad_queue_push (AiurPadQueue * queue, GstBuffer * buffer)
+{
+  AiurPadQueueGroup *group = queue->group;
+  GstClockTime start = GST_CLOCK_TIME_NONE;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&group->lock);
+  while ((!group->flushing) && (!queue->stop)
+      && (aiur_pad_queue_full (queue))) {
+    if (!GST_CLOCK_TIME_IS_VALID (start))
+      start = gst_util_get_timestamp ();
+    g_cond_wait (&group->cond, &group->lock);
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (start))
+    queue->stats.block_time += gst_util_get_timestamp () - start;
+
+  if ((group->flushing) || (queue->stop)) {
+    g_mutex_unlock (&group->lock);
+    gst_buffer_unref (buffer);
+    return GST_FLOW_FLUSHING;
+  }
+
+  queue->bytes += gst_buffer_get_size (buffer);
+  g_queue_push_tail (&queue->items, buffer);
+  ret = queue->last_ret;
+  g_cond_broadcast (&group->cond);
+  g_mutex_unlock (&group->lock);
+
+  return ret;
+}
+
+gboolean
+aiur_pad_queue_push_event (AiurPadQueue * queue, GstEvent * event)
+{
+  AiurPadQueueGroup *group = queue->group;
+
+  g_mutex_lock (&group->lock);
+  if ((group->flushing) || (queue->stop)) {
+    g_mutex_unlock (&group->lock);
+    gst_event_unref (event);
+    return FALSE;
+  }
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS)
+    queue->eos = TRUE;
+
+  g_queue_push_tail (&queue->items, event);
+  g_cond_broadcast (&group->cond);
+  g_mutex_unlock (&group->lock);
+
+  return TRUE;
+}
+
+void
+aiur_pad_queue_group_get_stats (AiurPadQueueGroup * group,
+    GstStructure * stats)
+{
+  GList *item;
+
+  if ((group == NULL) || (stats == NULL))
+    return;
+
+  g_mutex_lock (&group->lock);
+  for (item = group->queues; item; item = item->next) {
+    AiurPadQueue *queue = item->data;
+    const gchar *pad_name = GST_PAD_NAME (queue->pad);
+    gchar *name;
+
+    name = g_strdup_printf ("%s-push-queue-level", pad_name);
+    gst_structure_set (stats, name, G_TYPE_UINT,
+        g_queue_get_length (&queue->items), NULL);
+    g_free (name);
+
+    name = g_strdup_printf ("%s-push-queue-bytes", pad_name);
+    gst_structure_set (stats, name, G_TYPE_UINT64, queue->bytes, NULL);
+    g_free (name);
+
+    name = g_strdup_printf ("%s-push-buffers", pad_name);
+    gst_structure_set (stats, name, G_TYPE_UINT64, queue->stats.pushed, NULL);
+    g_free (name);
+
+    name = g_strdup_printf ("%s-push-block-time", pad_name);
+    gst_structure_set (stats, name, G_TYPE_UINT64, queue->stats.block_time,
+        NULL);
+    g_free (name);
+
+    name = g_strdup_printf ("%s-push-wait-time", pad_name);
+    gst_structure_set (stats, name, G_TYPE_UINT64, queue->stats.wait_time,
+        NULL);
+    g_free (name);
+  }
+  g_mutex_unlock (&group->lock);
+}
@@ -0,0 +1,72 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurpadqueue.h
+ *
+ * Description:    Head file of bounded per source pad output queues,
+ *                 each drained downstream by its own push thread
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __AIURPADQUEUE_H__
+#define __AIURPADQUEUE_H__
+#include <gst/gst.h>
+
+/* a full queue may grow to this many times its size while another
+ * paced queue runs empty */
+#define AIUR_PAD_QUEUE_OVERRUN 4
+
+typedef struct _AiurPadQueueGroup AiurPadQueueGroup;
+typedef struct _AiurPadQueue AiurPadQueue;
+
+/* all queues of a demuxer share one lock; max_items bounds each queue,
+ * skew is how far a paced queue may push ahead of the others, 0 for no
+ * pacing */
+AiurPadQueueGroup *aiur_pad_queue_group_new (guint max_items,
+    GstClockTime skew);
+/* queues must have been freed before */
+void aiur_pad_queue_group_free (AiurPadQueueGroup * group);
+
+/* drop everything queued and make pushes return GST_FLOW_FLUSHING, on
+ * stop waits until no push thread is inside a downstream push */
+void aiur_pad_queue_group_set_flushing (AiurPadQueueGroup * group,
+    gboolean flushing);
+
+/* starts the push thread of pad, paced queues take part in the
+ * timestamp fairness, sparse streams should not */
+AiurPadQueue *aiur_pad_queue_new (AiurPadQueueGroup * group, GstPad * pad,
+    gboolean paced);
+void aiur_pad_queue_free (AiurPadQueue * queue);
+
+/* take ownership, block while the queue is full; returns the flow of
+ * the last buffer pushed downstream */
+GstFlowReturn aiur_pad_queue_push (AiurPadQueue * queue, GstBuffer * buffer);
+/* serialized events only */
+gboolean aiur_pad_queue_push_event (AiurPadQueue * queue, GstEvent * event);
+
+/* add level, bytes, buffers, block and wait time of every queue to
+ * stats, field names are prefixed by the pad name */
+void aiur_pad_queue_group_get_stats (AiurPadQueueGroup * group,
+    GstStructure * stats);
+
+#endif /* __AIURPADQUEUE_H__ */
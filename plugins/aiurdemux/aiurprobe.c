@@ -0,0 +1,527 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurprobe.c
+ *
+ * Description:    Stream info probe for media library scanning. Opens a
+ *                 parser core over a local file, reads the movie and
+ *                 track properties and deletes it again, no index is
+ *                 built and no sample is read.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+#include <utime.h>
+#include <gst/base/gsttypefindhelper.h>
+#include "aiurprobe.h"
+#include "aiurcontent.h"
+#include "aiurregistry.h"
+#include "aiuridxtab.h"
+
+GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
+#define GST_CAT_DEFAULT aiurdemux_debug
+
+/* head of the file handed to the typefinders */
+#define AIUR_PROBE_TYPEFIND_SIZE 65536
+
+/* bump when the cached fields change */
+#define AIUR_PROBE_CACHE_VERSION 2
+#define AIUR_PROBE_CACHE_GROUP "movie"
+#define AIUR_PROBE_CACHE_TAGS_GROUP "tags"
+
+/* probe files are trimmed to their own budget every few stores, the
+ * index files in the directory are left to index-cache-budget of
+ * aiurdemux, which counts the probe files too */
+#define AIUR_PROBE_CACHE_BUDGET 8388608
+#define AIUR_PROBE_CACHE_TRIM_INTERVAL 64
+
+#define AIUR_PROBE_CORETS_2_GSTTS(ts) \
+    (((ts) == PARSER_UNKNOWN_TIME_STAMP) ? GST_CLOCK_TIME_NONE : ((ts) * 1000))
+
+/* registry and core cache are not thread safe, cores are */
+static GMutex aiur_probe_registry_lock;
+static GstCaps *aiur_probe_caps = NULL;
+static volatile gint aiur_probe_stores = 0;
+
+/* text tags a library scan shows, images and binary data are left out */
+static const struct
+{
+  UserDataID id;
+  const gchar *tag;
+} aiur_probe_tags[] = {
+  {USER_DATA_TITLE, GST_TAG_TITLE},
+  {USER_DATA_ARTIST, GST_TAG_ARTIST},
+  {USER_DATA_ALBUM, GST_TAG_ALBUM},
+  {USER_DATA_ALBUMARTIST, GST_TAG_ALBUM_ARTIST},
+  {USER_DATA_GENRE, GST_TAG_GENRE},
+  {USER_DATA_COMPOSER, GST_TAG_COMPOSER},
+  {USER_DATA_PERFORMER, GST_TAG_PERFORMER},
+  {USER_DATA_COMMENTS, GST_TAG_COMMENT},
+  {USER_DATA_DESCRIPTION, GST_TAG_DESCRIPTION},
+  {USER_DATA_COPYRIGHT, GST_TAG_COPYRIGHT},
+  {USER_DATA_KEYWORDS, GST_TAG_KEYWORDS},
+};
+
+gboolean
+aiur_probe_init (void)
+{
+  g_mutex_lock (&aiur_probe_registry_lock);
+  if (aiur_probe_caps == NULL)
+    aiur_probe_caps = aiur_core_get_caps ();
+  g_mutex_unlock (&aiur_probe_registry_lock);
+
+  return (aiur_probe_caps != NULL);
+}
+
+void
+aiur_probe_info_free (AiurProbeInfo * info)
+{
+  if (info == NULL)
+    return;
+
+  g_free (info->mime);
+  g_free (info->tracks);
+  if (info->tags)
+    gst_tag_list_unref (info->tags);
+  g_free (info);
+}
+
+static guint64
+aiur_probe_cache_get (GKeyFile * keyfile, const gchar * group,
+    const gchar * key, gboolean * ok)
+{
+  GError *error = NULL;
+  guint64 value;
+
+  value = g_key_file_get_uint64 (keyfile, group, key, &error);
+  if (error) {
+    *ok = FALSE;
+    g_error_free (error);
+  }
+
+  return value;
+}
+
+static AiurProbeInfo *
+aiur_probe_cache_load (const gchar * probe_file)
+{
+  GKeyFile *keyfile;
+  AiurProbeInfo *info = NULL;
+  gboolean ok = TRUE;
+  gchar **keys;
+  guint i;
+
+  keyfile = g_key_file_new ();
+  if (!g_key_file_load_from_file (keyfile, probe_file, G_KEY_FILE_NONE, NULL))
+    goto bail;
+
+  if (aiur_probe_cache_get (keyfile, AIUR_PROBE_CACHE_GROUP, "version",
+          &ok) != AIUR_PROBE_CACHE_VERSION)
+    goto bail;
+
+  info = g_new0 (AiurProbeInfo, 1);
+  info->cached = TRUE;
+  info->mime = g_key_file_get_string (keyfile, AIUR_PROBE_CACHE_GROUP,
+      "mime", NULL);
+  info->duration = aiur_probe_cache_get (keyfile, AIUR_PROBE_CACHE_GROUP,
+      "duration", &ok);
+  info->seekable = aiur_probe_cache_get (keyfile, AIUR_PROBE_CACHE_GROUP,
+      "seekable", &ok);
+  info->n_tracks = aiur_probe_cache_get (keyfile, AIUR_PROBE_CACHE_GROUP,
+      "tracks", &ok);
+  if ((!ok) || (info->mime == NULL))
+    goto bail;
+
+  info->tracks = g_new0 (AiurProbeTrack, info->n_tracks);
+  for (i = 0; i < info->n_tracks; i++) {
+    AiurProbeTrack *track = &info->tracks[i];
+    gchar *group = g_strdup_printf ("track-%u", i);
+    gchar *lang;
+
+    track->type = aiur_probe_cache_get (keyfile, group, "type", &ok);
+    track->codec_type = aiur_probe_cache_get (keyfile, group, "codec", &ok);
+    track->codec_sub_type =
+        aiur_probe_cache_get (keyfile, group, "sub-codec", &ok);
+    track->duration = aiur_probe_cache_get (keyfile, group, "duration", &ok);
+    track->bitrate = aiur_probe_cache_get (keyfile, group, "bitrate", &ok);
+    track->width = aiur_probe_cache_get (keyfile, group, "width", &ok);
+    track->height = aiur_probe_cache_get (keyfile, group, "height", &ok);
+    track->fps_n = aiur_probe_cache_get (keyfile, group, "fps-n", &ok);
+    track->fps_d = aiur_probe_cache_get (keyfile, group, "fps-d", &ok);
+    track->channels = aiur_probe_cache_get (keyfile, group, "channels", &ok);
+    track->rate = aiur_probe_cache_get (keyfile, group, "rate", &ok);
+    track->depth = aiur_probe_cache_get (keyfile, group, "depth", &ok);
+
+    lang = g_key_file_get_string (keyfile, group, "language", NULL);
+    if (lang) {
+      g_strlcpy (track->lang, lang, sizeof (track->lang));
+      g_free (lang);
+    }
+    g_free (group);
+  }
+
+  if (!ok)
+    goto bail;
+
+  keys = g_key_file_get_keys (keyfile, AIUR_PROBE_CACHE_TAGS_GROUP, NULL, NULL);
+  for (i = 0; keys && keys[i]; i++) {
+    gchar *value = g_key_file_get_string (keyfile, AIUR_PROBE_CACHE_TAGS_GROUP,
+        keys[i], NULL);
+
+    if (value && gst_tag_exists (keys[i])
+        && (gst_tag_get_type (keys[i]) == G_TYPE_STRING)) {
+      if (info->tags == NULL)
+        info->tags = gst_tag_list_new_empty ();
+      gst_tag_list_add (info->tags, GST_TAG_MERGE_APPEND, keys[i], value,
+          NULL);
+    }
+    g_free (value);
+  }
+  g_strfreev (keys);
+
+  g_key_file_free (keyfile);
+
+  /* mark as recently used for cache eviction */
+  utime (probe_file, NULL);
+
+  return info;
+
+bail:
+  GST_DEBUG ("probe cache %s not usable", probe_file);
+  aiur_probe_info_free (info);
+  g_key_file_free (keyfile);
+  return NULL;
+}
+
+static void
+aiur_probe_cache_store (const gchar * probe_file, AiurProbeInfo * info)
+{
+  GKeyFile *keyfile;
+  GError *error = NULL;
+  gchar *data;
+  gsize size;
+  guint i;
+
+  keyfile = g_key_file_new ();
+
+  g_key_file_set_uint64 (keyfile, AIUR_PROBE_CACHE_GROUP, "version",
+      AIUR_PROBE_CACHE_VERSION);
+  g_key_file_set_string (keyfile, AIUR_PROBE_CACHE_GROUP, "mime", info->mime);
+  g_key_file_set_uint64 (keyfile, AIUR_PROBE_CACHE_GROUP, "duration",
+      info->duration);
+  g_key_file_set_uint64 (keyfile, AIUR_PROBE_CACHE_GROUP, "seekable",
+      info->seekable);
+  g_key_file_set_uint64 (keyfile, AIUR_PROBE_CACHE_GROUP, "tracks",
+      info->n_tracks);
+
+  for (i = 0; i < info->n_tracks; i++) {
+    AiurProbeTrack *track = &info->tracks[i];
+    gchar *group = g_strdup_printf ("track-%u", i);
+
+    g_key_file_set_uint64 (keyfile, group, "type", track->type);
+    g_key_file_set_uint64 (keyfile, group, "codec", track->codec_type);
+    g_key_file_set_uint64 (keyfile, group, "sub-codec",
+        track->codec_sub_type);
+    g_key_file_set_uint64 (keyfile, group, "duration", track->duration);
+    g_key_file_set_string (keyfile, group, "language", track->lang);
+    g_key_file_set_uint64 (keyfile, group, "bitrate", track->bitrate);
+    g_key_file_set_uint64 (keyfile, group, "width", track->width);
+    g_key_file_set_uint64 (keyfile, group, "height", track->height);
+    g_key_file_set_uint64 (keyfile, group, "fps-n", track->fps_n);
+    g_key_file_set_uint64 (keyfile, group, "fps-d", track->fps_d);
+    g_key_file_set_uint64 (keyfile, group, "channels", track->channels);
+    g_key_file_set_uint64 (keyfile, group, "rate", track->rate);
+    g_key_file_set_uint64 (keyfile, group, "depth", track->depth);
+    g_free (group);
+  }
+
+  for (i = 0; info->tags && i < gst_tag_list_n_tags (info->tags); i++) {
+    const gchar *tag = gst_tag_list_nth_tag_name (info->tags, i);
+    gchar *value;
+
+    /* multiple values of a tag are joined to one */
+    if (gst_tag_list_get_string (info->tags, tag, &value)) {
+      g_key_file_set_string (keyfile, AIUR_PROBE_CACHE_TAGS_GROUP, tag, value);
+      g_free (value);
+    }
+  }
+
+  /* written to a temporary and renamed, concurrent probes of the same
+   * content never see a partial file */
+  data = g_key_file_to_data (keyfile, &size, NULL);
+  if (!g_file_set_contents (probe_file, data, size, &error)) {
+    GST_DEBUG ("can not write probe cache %s: %s", probe_file,
+        error->message);
+    g_error_free (error);
+  }
+
+  g_free (data);
+  g_key_file_free (keyfile);
+
+  if ((g_atomic_int_add (&aiur_probe_stores, 1)
+          % AIUR_PROBE_CACHE_TRIM_INTERVAL) == 0) {
+    gchar *dirname = g_path_get_dirname (probe_file);
+    aiurdemux_trim_probe_cache (dirname, AIUR_PROBE_CACHE_BUDGET);
+    g_free (dirname);
+  }
+}
+
+/* pick the core by the caps of the head of the file */
+static GstCaps *
+aiur_probe_typefind (AiurContent * content, FslFileStream * file_cbks)
+{
+  FslFileHandle file;
+  GstTypeFindProbability prob;
+  GstCaps *caps = NULL;
+  guint8 *data;
+  uint32 size;
+
+  file = file_cbks->Open (NULL, (const uint8 *) "rb", content);
+  if (file == NULL)
+    return NULL;
+
+  data = g_malloc (AIUR_PROBE_TYPEFIND_SIZE);
+  size = file_cbks->Read (file, data, AIUR_PROBE_TYPEFIND_SIZE, content);
+  file_cbks->Close (file, content);
+
+  if (size > 0)
+    caps = gst_type_find_helper_for_data (NULL, data, size, &prob);
+  g_free (data);
+
+  if (caps && !gst_caps_can_intersect (caps, aiur_probe_caps)) {
+    GST_DEBUG ("no core for %" GST_PTR_FORMAT, caps);
+    gst_caps_unref (caps);
+    caps = NULL;
+  }
+
+  return caps;
+}
+
+static void
+aiur_probe_track (AiurCoreInterface * IParser, FslParserHandle handle,
+    uint32 track_index, AiurProbeTrack * track)
+{
+  uint64 duration = 0;
+  uint32 rate = 0, scale = 0;
+
+  IParser->getTrackType (handle, track_index, &track->type,
+      &track->codec_type, &track->codec_sub_type);
+
+  track->duration = GST_CLOCK_TIME_NONE;
+  if (IParser->getTrackDuration (handle, track_index,
+          &duration) == PARSER_SUCCESS)
+    track->duration = AIUR_PROBE_CORETS_2_GSTTS (duration);
+
+  if ((IParser->getLanguage == NULL)
+      || (IParser->getLanguage (handle, track_index,
+              (uint8 *) track->lang) != PARSER_SUCCESS))
+    track->lang[0] = '\0';
+  track->lang[3] = '\0';
+
+  if ((IParser->getBitRate == NULL)
+      || (IParser->getBitRate (handle, track_index,
+              &track->bitrate) != PARSER_SUCCESS))
+    track->bitrate = 0;
+
+  switch (track->type) {
+    case MEDIA_VIDEO:
+      IParser->getVideoFrameWidth (handle, track_index, &track->width);
+      IParser->getVideoFrameHeight (handle, track_index, &track->height);
+      if ((IParser->getVideoFrameRate)
+          && (IParser->getVideoFrameRate (handle, track_index, &rate,
+                  &scale) == PARSER_SUCCESS) && (rate) && (scale)) {
+        track->fps_n = rate;
+        track->fps_d = scale;
+      }
+      break;
+    case MEDIA_AUDIO:
+      IParser->getAudioNumChannels (handle, track_index, &track->channels);
+      IParser->getAudioSampleRate (handle, track_index, &track->rate);
+      if (IParser->getAudioBitsPerSample)
+        IParser->getAudioBitsPerSample (handle, track_index, &track->depth);
+      break;
+    default:
+      break;
+  }
+}
+
+/* UTF-8 text tags, from getMetaData or the older UTF-16 getUserData */
+static GstTagList *
+aiur_probe_tags_read (AiurCoreInterface * IParser, FslParserHandle handle)
+{
+  GstTagList *tags = NULL;
+  guint i;
+
+  if ((IParser->getMetaData == NULL) && (IParser->getUserData == NULL))
+    return NULL;
+
+  for (i = 0; i < G_N_ELEMENTS (aiur_probe_tags); i++) {
+    gchar *value = NULL;
+
+    if (IParser->getMetaData) {
+      UserDataFormat format = USER_DATA_FORMAT_UTF8;
+      uint8 *data = NULL;
+      uint32 size = 0;
+
+      if ((IParser->getMetaData (handle, aiur_probe_tags[i].id, &format,
+                  &data, &size) == PARSER_SUCCESS) && (data) && (size)
+          && (format == USER_DATA_FORMAT_UTF8))
+        value = g_strndup ((const gchar *) data, size);
+    } else {
+      uint16 *data = NULL;
+      uint32 size = 0;
+
+      if ((IParser->getUserData (handle, aiur_probe_tags[i].id, &data,
+                  &size) == PARSER_SUCCESS) && (data) && (size))
+        value = g_convert ((const gchar *) data, size * 2, "UTF-8",
+            "UTF-16LE", NULL, NULL, NULL);
+    }
+
+    if (value && g_utf8_validate (value, -1, NULL) && value[0]) {
+      if (tags == NULL)
+        tags = gst_tag_list_new_empty ();
+      gst_tag_list_add (tags, GST_TAG_MERGE_APPEND, aiur_probe_tags[i].tag,
+          value, NULL);
+    }
+    g_free (value);
+  }
+
+  return tags;
+}
+
+static AiurProbeInfo *
+aiur_probe_parse (AiurContent * content)
+{
+  AiurCoreInterface *IParser;
+  FslParserHandle handle = NULL;
+  FslFileStream file_cbks;
+  ParserMemoryOps mem_cbks;
+  ParserOutputBufferOps buf_cbks;
+  AiurProbeInfo *info = NULL;
+  GstCaps *caps;
+  bool seekable = FALSE;
+  uint64 duration = 0;
+  uint32 n_tracks = 0;
+  uint32 i;
+  int32 core_ret;
+
+  memset (&file_cbks, 0, sizeof (file_cbks));
+  memset (&mem_cbks, 0, sizeof (mem_cbks));
+  memset (&buf_cbks, 0, sizeof (buf_cbks));
+  aiurcontent_get_pullfile_callback (content, &file_cbks);
+  aiurcontent_get_memory_callback (content, &mem_cbks);
+  aiurcontent_get_buffer_callback (content, &buf_cbks);
+
+  caps = aiur_probe_typefind (content, &file_cbks);
+  if (caps == NULL)
+    return NULL;
+
+  g_mutex_lock (&aiur_probe_registry_lock);
+  IParser = aiur_core_create_interface_from_caps (caps);
+  g_mutex_unlock (&aiur_probe_registry_lock);
+
+  if (IParser == NULL) {
+    gst_caps_unref (caps);
+    return NULL;
+  }
+
+  if (IParser->createParser2) {
+    core_ret = IParser->createParser2 (FLAG_H264_NO_CONVERT, &file_cbks,
+        &mem_cbks, &buf_cbks, (void *) content, &handle);
+  } else {
+    core_ret = IParser->createParser (FALSE, &file_cbks, &mem_cbks,
+        &buf_cbks, (void *) content, &handle);
+  }
+  if ((core_ret != PARSER_SUCCESS) || (handle == NULL)) {
+    GST_DEBUG ("%s failed to create parser %d", IParser->name, core_ret);
+    goto bail;
+  }
+
+  if (IParser->getNumTracks (handle, &n_tracks) != PARSER_SUCCESS)
+    goto bail;
+
+  info = g_new0 (AiurProbeInfo, 1);
+  info->mime = g_strdup (gst_structure_get_name (gst_caps_get_structure (caps,
+              0)));
+
+  info->duration = GST_CLOCK_TIME_NONE;
+  if (IParser->getMovieDuration (handle, &duration) == PARSER_SUCCESS)
+    info->duration = AIUR_PROBE_CORETS_2_GSTTS (duration);
+
+  if (IParser->isSeekable (handle, &seekable) == PARSER_SUCCESS)
+    info->seekable = seekable;
+
+  info->n_tracks = n_tracks;
+  info->tracks = g_new0 (AiurProbeTrack, n_tracks);
+  for (i = 0; i < n_tracks; i++)
+    aiur_probe_track (IParser, handle, i, &info->tracks[i]);
+
+  info->tags = aiur_probe_tags_read (IParser, handle);
+
+bail:
+  if (handle)
+    IParser->deleteParser (handle);
+
+  g_mutex_lock (&aiur_probe_registry_lock);
+  aiur_core_destroy_interface (IParser);
+  g_mutex_unlock (&aiur_probe_registry_lock);
+
+  gst_caps_unref (caps);
+
+  return info;
+}
+
+AiurProbeInfo *
+aiur_probe_file (const gchar * location, gboolean use_cache)
+{
+  AiurContent *content = NULL;
+  AiurProbeInfo *info = NULL;
+  gchar *probe_file = NULL;
+
+  if ((aiur_probe_caps == NULL) || (location == NULL))
+    return NULL;
+
+  if ((aiurcontent_new (&content) != 0) || (content == NULL))
+    return NULL;
+
+  if (aiurcontent_init_file (content, location) != 0)
+    goto done;
+
+  if (use_cache) {
+    probe_file = aiurcontent_get_probe_file (content);
+    if (probe_file)
+      info = aiur_probe_cache_load (probe_file);
+  }
+
+  if (info == NULL) {
+    info = aiur_probe_parse (content);
+    if (info && probe_file)
+      aiur_probe_cache_store (probe_file, info);
+  }
+
+done:
+  g_free (probe_file);
+  aiurcontent_release (content);
+
+  return info;
+}
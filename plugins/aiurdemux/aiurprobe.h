@@ -0,0 +1,76 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurprobe.h
+ *
+ * Description:    Head file of the stream info probe, reads only the
+ *                 movie and track properties of a local file
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __AIURPROBE_H__
+#define __AIURPROBE_H__
+#include <gst/gst.h>
+
+typedef struct
+{
+  guint32 type;                 /* MediaType of the core */
+  guint32 codec_type;
+  guint32 codec_sub_type;
+  GstClockTime duration;
+  gchar lang[4];
+  guint32 bitrate;
+
+  /* video */
+  guint32 width;
+  guint32 height;
+  guint32 fps_n;
+  guint32 fps_d;
+
+  /* audio */
+  guint32 channels;
+  guint32 rate;
+  guint32 depth;
+} AiurProbeTrack;
+
+typedef struct
+{
+  gchar *mime;                  /* caps the core was chosen by */
+  GstClockTime duration;
+  gboolean seekable;
+  guint n_tracks;
+  AiurProbeTrack *tracks;
+  GstTagList *tags;             /* text tags of the movie, NULL if none */
+  gboolean cached;              /* read from the probe cache */
+} AiurProbeInfo;
+
+/* loads the core registry, call once before probing from threads */
+gboolean aiur_probe_init (void);
+
+/* thread safe, NULL when no core handles location; with use_cache the
+ * result is kept next to the index files, keyed by the same content
+ * fingerprint */
+AiurProbeInfo *aiur_probe_file (const gchar * location, gboolean use_cache);
+void aiur_probe_info_free (AiurProbeInfo * info);
+
+#endif /* __AIURPROBE_H__ */
@@ -52,8 +52,13 @@
 
 #define AIUR_REGISTRY_FILE_ENV_NAME "AIUR_REGISTRY"
 
+/* which core libraries load, set empty to probe all on every start */
+#define AIUR_CORE_CACHE_ENV_NAME "AIUR_CORE_CACHE"
+#define AIUR_CORE_CACHE_NAME "aiur_core_cache"
+
 
 static GstsutilsEntry *g_aiur_caps_entry = NULL;
+static GstsutilsCoreCache *g_aiur_core_cache = NULL;
 
 /* id table for all core apis, the same order with AiurCoreInterface */
 uint32 aiur_core_interface_id_table[] = {
@@ -112,6 +117,8 @@ uint32 aiur_core_interface_id_table[] = {
   PARSER_API_SEEK,
 
   PARSER_API_FLUSH_TRACK,
+
+  PARSER_API_GET_SAMPLE_INFO,
 };
 
 
@@ -174,6 +181,26 @@ fail:
   return inf;
 }
 
+/* dlopen libname only when the core cache does not know it yet */
+static gboolean
+aiur_core_lib_loadable (gchar * libname)
+{
+  void *dlhandle;
+  gboolean loadable;
+
+  if (gstsutils_core_cache_lookup (g_aiur_core_cache, libname, &loadable))
+    return loadable;
+
+  dlhandle = dlopen (libname, RTLD_LAZY);
+  loadable = (dlhandle != NULL);
+  if (dlhandle)
+    dlclose (dlhandle);
+
+  gstsutils_core_cache_store (g_aiur_core_cache, libname, loadable);
+
+  return loadable;
+}
+
 static GstCaps * aiur_get_caps_from_entry(GstsutilsEntry * entry)
 {
   int group_count=0;
@@ -181,7 +208,6 @@ static GstCaps * aiur_get_caps_from_entry(GstsutilsEntry * entry)
   char* mime = NULL;
   char* libname = NULL;
   GstsutilsGroup *group=NULL;
-  void *dlhandle = NULL;
   GstCaps * caps = NULL;
   group_count = gstsutils_get_group_count(entry);
   for(index = 1; index <= group_count; index++){
@@ -194,8 +220,7 @@ static GstCaps * aiur_get_caps_from_entry(GstsutilsEntry * entry)
       g_free(mime);
       continue;
     }
-    dlhandle = dlopen (libname, RTLD_LAZY);
-    if (!dlhandle) {
+    if (!aiur_core_lib_loadable (libname)) {
       g_free(mime);
       g_free(libname);
       continue;
@@ -212,7 +237,6 @@ static GstCaps * aiur_get_caps_from_entry(GstsutilsEntry * entry)
     } else {
       caps = gst_caps_from_string (mime);
     }
-    dlclose (dlhandle);
     g_free(mime);
     g_free(libname);
   }
@@ -260,7 +284,12 @@ aiur_core_get_caps ()
     g_aiur_caps_entry = gstsutils_init_entry(aiurenv);
   }
 
+  if (g_aiur_core_cache == NULL)
+    g_aiur_core_cache = gstsutils_core_cache_open (AIUR_CORE_CACHE_ENV_NAME,
+        AIUR_CORE_CACHE_NAME);
+
   caps = aiur_get_caps_from_entry(g_aiur_caps_entry);
+  gstsutils_core_cache_sync (g_aiur_core_cache);
 
   return caps;
 }
@@ -275,16 +304,13 @@ aiur_core_create_interface_from_caps (GstCaps * caps)
   gchar * libname2 = NULL;
   gchar * temp_name;
   gboolean find = TRUE;
-  void *dlhandle = NULL;
 
   group = aiur_core_find_caps_group(g_aiur_caps_entry,caps);
   if (group) {
 
     if(gstsutils_get_value_by_key(group,FSL_KEY_LIB2,&libname2)){
-      dlhandle = dlopen (libname2, RTLD_LAZY);
-      if(dlhandle){
+      if(aiur_core_lib_loadable (libname2)){
         libname = libname2;
-        dlclose (dlhandle);
       }else{
         g_free(libname2);
       }
@@ -297,10 +323,17 @@ aiur_core_create_interface_from_caps (GstCaps * caps)
     else
       return inf;
 
+    /* the cache was stale, e.g. a dependency of the core went away */
+    if (inf == NULL) {
+      gstsutils_core_cache_store (g_aiur_core_cache, libname, FALSE);
+      gstsutils_core_cache_sync (g_aiur_core_cache);
+    }
+
     if(libname)
       g_free(libname);
 
-    inf->name = gstsutils_get_group_name(group);
+    if (inf)
+      inf->name = gstsutils_get_group_name(group);
   }
   return inf;
 }
@@ -328,5 +361,6 @@ void
 aiur_free_dll_entry ()
 {
   gstsutils_deinit_entry(g_aiur_caps_entry);
+  gstsutils_core_cache_close (g_aiur_core_cache);
 
 }
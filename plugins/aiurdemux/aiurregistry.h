@@ -105,6 +105,8 @@ typedef struct
 
   FslParserFlush flushTrack;
 
+  FslParserGetSampleInfo getSampleInfo;
+
   /* add new interface here */
 
   void *dl_handle;              /* must be last, for dl handle */
@@ -0,0 +1,304 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiursamplepool.c
+ *
+ * Description:    Implementation of sample buffer pool. Buffers requested
+ *                 by the parser core are rounded up to power of 2 size
+ *                 classes and come back to a per class free list when
+ *                 the last reference is dropped downstream.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include "aiursamplepool.h"
+
+GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
+#define GST_CAT_DEFAULT aiurdemux_debug
+
+#define AIUR_SAMPLE_POOL_CLASS_SIZE(cls) \
+  ((gsize)1 << ((cls) + AIUR_SAMPLE_POOL_MIN_SHIFT))
+
+struct _AiurSamplePool
+{
+  GMutex lock;
+  GQueue free_list[AIUR_SAMPLE_POOL_CLASSES];
+
+  guint64 budget;
+  gboolean closed;
+
+  /* owner plus every pooled buffer alive */
+  volatile gint refcount;
+
+  AiurSamplePoolStats stats;
+};
+
+static GQuark aiur_sample_pool_quark = 0;
+static GQuark aiur_sample_pool_class_quark = 0;
+
+static void
+aiur_sample_pool_unref (AiurSamplePool * pool)
+{
+  if (g_atomic_int_dec_and_test (&pool->refcount)) {
+    g_mutex_clear (&pool->lock);
+    g_free (pool);
+  }
+}
+
+static gint
+aiur_sample_pool_size_to_class (guint size)
+{
+  gint cls = 0;
+
+  while (AIUR_SAMPLE_POOL_CLASS_SIZE (cls) < size) {
+    cls++;
+    if (cls >= AIUR_SAMPLE_POOL_CLASSES)
+      return -1;
+  }
+  return cls;
+}
+
+/* buffer can go back to free list only if nobody else sees its memory */
+static gboolean
+aiur_sample_pool_recyclable (GstBuffer * buffer, gint cls)
+{
+  GstMemory *mem;
+  gpointer state = NULL;
+  gsize offset, maxsize;
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_TAG_MEMORY))
+    return FALSE;
+  if (gst_buffer_n_memory (buffer) != 1)
+    return FALSE;
+
+  mem = gst_buffer_peek_memory (buffer, 0);
+  if (!gst_memory_is_writable (mem))
+    return FALSE;
+
+  gst_buffer_get_sizes (buffer, &offset, &maxsize);
+  if ((offset != 0) || (maxsize < AIUR_SAMPLE_POOL_CLASS_SIZE (cls)))
+    return FALSE;
+
+  if (gst_buffer_iterate_meta (buffer, &state) != NULL)
+    return FALSE;
+
+  return TRUE;
+}
+
+/* free a pooled buffer for real */
+static void
+aiur_sample_pool_drop (AiurSamplePool * pool, GstBuffer * buffer)
+{
+  GST_MINI_OBJECT_CAST (buffer)->dispose = NULL;
+  gst_buffer_unref (buffer);
+  aiur_sample_pool_unref (pool);
+}
+
+static gboolean
+aiur_sample_pool_buffer_dispose (GstMiniObject * obj)
+{
+  GstBuffer *buffer = (GstBuffer *) obj;
+  AiurSamplePool *pool;
+  gint cls;
+
+  pool = gst_mini_object_get_qdata (obj, aiur_sample_pool_quark);
+  cls = GPOINTER_TO_INT (gst_mini_object_get_qdata (obj,
+          aiur_sample_pool_class_quark)) - 1;
+
+  g_mutex_lock (&pool->lock);
+  if ((!pool->closed) && aiur_sample_pool_recyclable (buffer, cls)) {
+    /* resurrect and reset it, like GstBufferPool does */
+    gst_buffer_ref (buffer);
+    GST_MINI_OBJECT_FLAGS (buffer) = 0;
+    GST_BUFFER_PTS (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DTS (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_OFFSET (buffer) = GST_BUFFER_OFFSET_NONE;
+    GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET_NONE;
+    g_queue_push_head (&pool->free_list[cls], buffer);
+    g_mutex_unlock (&pool->lock);
+    return FALSE;
+  }
+
+  pool->stats.pooled_bytes -= AIUR_SAMPLE_POOL_CLASS_SIZE (cls);
+  g_mutex_unlock (&pool->lock);
+
+  aiur_sample_pool_unref (pool);
+
+  return TRUE;
+}
+
+AiurSamplePool *
+aiur_sample_pool_new (guint64 budget)
+{
+  AiurSamplePool *pool;
+  gint i;
+
+  if (aiur_sample_pool_quark == 0) {
+    aiur_sample_pool_quark = g_quark_from_static_string ("aiur-sample-pool");
+    aiur_sample_pool_class_quark =
+        g_quark_from_static_string ("aiur-sample-pool-class");
+  }
+
+  pool = g_new0 (AiurSamplePool, 1);
+
+  g_mutex_init (&pool->lock);
+  for (i = 0; i < AIUR_SAMPLE_POOL_CLASSES; i++) {
+    g_queue_init (&pool->free_list[i]);
+  }
+  pool->budget = budget;
+  pool->refcount = 1;
+
+  return pool;
+}
+
+void
+aiur_sample_pool_free (AiurSamplePool * pool)
+{
+  GQueue drop = G_QUEUE_INIT;
+  GstBuffer *buffer;
+  gint i;
+
+  if (pool == NULL)
+    return;
+
+  g_mutex_lock (&pool->lock);
+  pool->closed = TRUE;
+  for (i = 0; i < AIUR_SAMPLE_POOL_CLASSES; i++) {
+    while ((buffer = g_queue_pop_head (&pool->free_list[i]))) {
+      pool->stats.pooled_bytes -= AIUR_SAMPLE_POOL_CLASS_SIZE (i);
+      g_queue_push_tail (&drop, buffer);
+    }
+  }
+  GST_INFO ("sample pool allocs %lld recycles %lld unpooled %lld",
+      pool->stats.allocs, pool->stats.recycles, pool->stats.unpooled);
+  g_mutex_unlock (&pool->lock);
+
+  while ((buffer = g_queue_pop_head (&drop))) {
+    aiur_sample_pool_drop (pool, buffer);
+  }
+
+  aiur_sample_pool_unref (pool);
+}
+
+void
+aiur_sample_pool_set_budget (AiurSamplePool * pool, guint64 budget)
+{
+  if (pool == NULL)
+    return;
+
+  g_mutex_lock (&pool->lock);
+  pool->budget = budget;
+  g_mutex_unlock (&pool->lock);
+}
+
+GstBuffer *
+aiur_sample_pool_acquire (AiurSamplePool * pool, guint size)
+{
+  GQueue drop = G_QUEUE_INIT;
+  GstBuffer *buffer = NULL;
+  gsize class_size;
+  gint cls, i;
+
+  if (pool == NULL)
+    return gst_buffer_new_and_alloc (size);
+
+  cls = aiur_sample_pool_size_to_class (size);
+
+  g_mutex_lock (&pool->lock);
+
+  if (cls < 0)
+    goto unpooled;
+
+  buffer = g_queue_pop_head (&pool->free_list[cls]);
+  if (buffer) {
+    pool->stats.recycles++;
+    g_mutex_unlock (&pool->lock);
+    gst_buffer_set_size (buffer, size);
+    return buffer;
+  }
+
+  /* make room by releasing idle buffers of other classes, largest first */
+  class_size = AIUR_SAMPLE_POOL_CLASS_SIZE (cls);
+  for (i = AIUR_SAMPLE_POOL_CLASSES - 1;
+      (i >= 0) && (pool->stats.pooled_bytes + class_size > pool->budget);
+      i--) {
+    while ((pool->stats.pooled_bytes + class_size > pool->budget)
+        && (buffer = g_queue_pop_tail (&pool->free_list[i]))) {
+      pool->stats.pooled_bytes -= AIUR_SAMPLE_POOL_CLASS_SIZE (i);
+      g_queue_push_tail (&drop, buffer);
+    }
+  }
+
+  if (pool->stats.pooled_bytes + class_size > pool->budget)
+    goto unpooled;
+
+  pool->stats.pooled_bytes += class_size;
+  pool->stats.allocs++;
+  g_atomic_int_inc (&pool->refcount);
+  g_mutex_unlock (&pool->lock);
+
+  while ((buffer = g_queue_pop_head (&drop))) {
+    aiur_sample_pool_drop (pool, buffer);
+  }
+
+  buffer = gst_buffer_new_allocate (NULL, class_size, NULL);
+  if (buffer == NULL) {
+    g_mutex_lock (&pool->lock);
+    pool->stats.pooled_bytes -= class_size;
+    g_mutex_unlock (&pool->lock);
+    aiur_sample_pool_unref (pool);
+    return NULL;
+  }
+
+  GST_BUFFER_FLAG_UNSET (buffer, GST_BUFFER_FLAG_TAG_MEMORY);
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (buffer),
+      aiur_sample_pool_quark, pool, NULL);
+  gst_mini_object_set_qdata (GST_MINI_OBJECT_CAST (buffer),
+      aiur_sample_pool_class_quark, GINT_TO_POINTER (cls + 1), NULL);
+  GST_MINI_OBJECT_CAST (buffer)->dispose = aiur_sample_pool_buffer_dispose;
+
+  gst_buffer_set_size (buffer, size);
+  return buffer;
+
+unpooled:
+  pool->stats.unpooled++;
+  g_mutex_unlock (&pool->lock);
+
+  while ((buffer = g_queue_pop_head (&drop))) {
+    aiur_sample_pool_drop (pool, buffer);
+  }
+
+  return gst_buffer_new_and_alloc (size);
+}
+
+void
+aiur_sample_pool_get_stats (AiurSamplePool * pool,
+    AiurSamplePoolStats * stats)
+{
+  if ((pool == NULL) || (stats == NULL))
+    return;
+
+  g_mutex_lock (&pool->lock);
+  *stats = pool->stats;
+  g_mutex_unlock (&pool->lock);
+}
@@ -0,0 +1,62 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiursamplepool.h
+ *
+ * Description:    Head file of size-class sample buffer pool
+ *                 for unified parser gstreamer plugin
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __AIURSAMPLEPOOL_H__
+#define __AIURSAMPLEPOOL_H__
+#include <gst/gst.h>
+
+/* size classes are powers of 2 from 256 bytes to 4 MB */
+#define AIUR_SAMPLE_POOL_MIN_SHIFT 8
+#define AIUR_SAMPLE_POOL_MAX_SHIFT 22
+#define AIUR_SAMPLE_POOL_CLASSES \
+  (AIUR_SAMPLE_POOL_MAX_SHIFT - AIUR_SAMPLE_POOL_MIN_SHIFT + 1)
+
+#define AIUR_SAMPLE_POOL_BUDGET 8388608
+
+typedef struct _AiurSamplePool AiurSamplePool;
+
+typedef struct
+{
+  guint64 allocs;
+  guint64 recycles;
+  guint64 unpooled;
+  guint64 pooled_bytes;
+} AiurSamplePoolStats;
+
+AiurSamplePool *aiur_sample_pool_new (guint64 budget);
+/* pooled buffers still alive keep the pool until they are freed */
+void aiur_sample_pool_free (AiurSamplePool * pool);
+
+void aiur_sample_pool_set_budget (AiurSamplePool * pool, guint64 budget);
+GstBuffer *aiur_sample_pool_acquire (AiurSamplePool * pool, guint size);
+void aiur_sample_pool_get_stats (AiurSamplePool * pool,
+    AiurSamplePoolStats * stats);
+
+#endif /* __AIURSAMPLEPOOL_H__ */
@@ -50,33 +50,354 @@ GST_DEBUG_CATEGORY_EXTERN (aiurdemux_debug);
 #define READ_ADDR(cache)\
     ((cache)->start+(cache)->offset)
 
+#define QUEUED_BYTES(cache)\
+    ((guint64)g_atomic_int_get (&(cache)->queued))
+
 #define AVAIL_BYTES(cache)\
-    (gst_adapter_available((cache)->adapter)-(cache)->offset)
-
-#define CHECK_PRESERVE(cache)\
-    do {\
-        if ((cache)->offset>(cache)->threshold_pre){\
-            guint64 flush = ((cache)->offset-(cache)->threshold_pre);\
-            gst_adapter_flush((cache)->adapter, flush);\
-            (cache)->offset =(cache)->threshold_pre;\
-            (cache)->start+=flush;\
-            g_cond_signal(&(cache)->consume_cond);\
-        }\
-    }while(0)
+    ((QUEUED_BYTES(cache)>(cache)->offset)?(QUEUED_BYTES(cache)-(cache)->offset):0)
 
-#define READ_BYTES(cache, buffer, readbytes)\
-    do {\
-        if (buffer){\
-            gst_adapter_copy((cache)->adapter, (buffer), (cache)->offset, (readbytes));\
-        }\
-        (cache)->offset+=(readbytes);\
-        CHECK_PRESERVE(cache);\
-    }while(0)
+#define SLOT(cache, idx)\
+    (&(cache)->slots[(idx) & (cache)->slot_mask])
+
+#define USED_SLOTS(cache)\
+    ((guint)(g_atomic_int_get (&(cache)->tail) - g_atomic_int_get (&(cache)->head)))
 
 GST_DEFINE_MINI_OBJECT_TYPE (GstAiurStreamCache, gst_aiur_stream_cache);
 GType aiur_stream_cache_type = 0;
 
-static GTimeVal timeout = { 1, 0 };
+/* upstream time measured before the rate estimate is updated */
+#define AIUR_STREAM_CACHE_RATE_PERIOD (GST_MSECOND * 50)
+
+/* consumer counters are published to get_stats after this many events,
+ * and whenever the consumer takes the mutex anyway */
+#define AIUR_STREAM_CACHE_PUBLISH_EVENTS 64
+
+/* moving average with weight 1/4 for the new sample */
+#define AIUR_STREAM_CACHE_AVERAGE(avg, val) \
+    ((avg) ? (((avg) * 3 + (val)) / 4) : (val))
+
+static void
+gst_aiur_stream_cache_clear_slot (GstAiurStreamCacheSlot * slot)
+{
+  if (slot->mem) {
+    gst_memory_unmap (slot->mem, &slot->map);
+    gst_memory_unref (slot->mem);
+    slot->mem = NULL;
+  }
+}
+
+/* wake up the other side only if it is (about to be) sleeping */
+static void
+gst_aiur_stream_cache_wakeup (GstAiurStreamCache * cache,
+    volatile gint * waiting, GCond * cond)
+{
+  if (g_atomic_int_get (waiting)) {
+    g_mutex_lock (&cache->mutex);
+    g_cond_signal (cond);
+    g_mutex_unlock (&cache->mutex);
+  }
+}
+
+/* The producer stops above threshold_max, the consumer drops the head
+ * slot only once threshold_pre bytes past it are read. threshold_max
+ * grows to cover preserve + largest slot + largest read, or both sides
+ * could wait for each other with everything queued already read. */
+static void
+gst_aiur_stream_cache_fit_threshold (GstAiurStreamCache * cache)
+{
+  guint64 need;
+  gint old;
+
+  need = cache->threshold_pre + (guint64) g_atomic_int_get (&cache->max_slot)
+      + (guint64) g_atomic_int_get (&cache->max_read);
+  need = MIN (need, G_MAXINT);
+
+  do {
+    old = g_atomic_int_get (&cache->threshold_max);
+    if ((old == 0) || ((guint64) old >= need))
+      return;
+  } while (!g_atomic_int_compare_and_exchange (&cache->threshold_max, old,
+          (gint) need));
+
+  /* enlarge maxsize means consumed */
+  gst_aiur_stream_cache_wakeup (cache, &cache->producer_waiting,
+      &cache->consume_cond);
+}
+
+/* only grows, called by producer and consumer */
+static void
+gst_aiur_stream_cache_update_max (volatile gint * max, guint64 size)
+{
+  gint old;
+
+  size = MIN (size, G_MAXINT);
+  do {
+    old = g_atomic_int_get (max);
+    if ((guint64) old >= size)
+      return;
+  } while (!g_atomic_int_compare_and_exchange (max, old, (gint) size));
+}
+
+/* consumer: drop the head slot */
+static void
+gst_aiur_stream_cache_release_head (GstAiurStreamCache * cache)
+{
+  gint head = g_atomic_int_get (&cache->head);
+  GstAiurStreamCacheSlot *slot = SLOT (cache, head);
+  gsize size = slot->map.size;
+
+  gst_aiur_stream_cache_clear_slot (slot);
+
+  if (cache->read_slot == head) {
+    cache->read_slot++;
+    cache->read_pos = 0;
+  }
+  cache->start += size;
+  cache->offset = (cache->offset > size) ? (cache->offset - size) : 0;
+
+  g_atomic_int_add (&cache->queued, -(gint) size);
+  g_atomic_int_set (&cache->head, head + 1);
+}
+
+/* consumer: release slots which are behind the preserve window, or all
+ * slots behind the read position when the producer ran out of slots */
+static void
+gst_aiur_stream_cache_check_preserve (GstAiurStreamCache * cache)
+{
+  gboolean released = FALSE;
+  gboolean slots_full = (USED_SLOTS (cache) > cache->slot_mask);
+
+  while (g_atomic_int_get (&cache->head) != g_atomic_int_get (&cache->tail)) {
+    GstAiurStreamCacheSlot *slot = SLOT (cache, cache->head);
+    guint64 keep = slots_full ? 0 : cache->threshold_pre;
+
+    if (cache->offset < slot->map.size + keep)
+      break;
+    gst_aiur_stream_cache_release_head (cache);
+    released = TRUE;
+  }
+
+  if (released)
+    gst_aiur_stream_cache_wakeup (cache, &cache->producer_waiting,
+        &cache->consume_cond);
+}
+
+/* consumer: release everything produced so far */
+static void
+gst_aiur_stream_cache_drain (GstAiurStreamCache * cache)
+{
+  gint tail = g_atomic_int_get (&cache->tail);
+
+  while (g_atomic_int_get (&cache->head) != tail) {
+    gst_aiur_stream_cache_release_head (cache);
+  }
+  cache->read_slot = tail;
+  cache->read_pos = 0;
+  cache->offset = 0;
+
+  gst_aiur_stream_cache_wakeup (cache, &cache->producer_waiting,
+      &cache->consume_cond);
+}
+
+/* consumer: locate read_slot/read_pos for the current offset */
+static void
+gst_aiur_stream_cache_locate (GstAiurStreamCache * cache)
+{
+  gint tail = g_atomic_int_get (&cache->tail);
+  gint idx = g_atomic_int_get (&cache->head);
+  guint64 pos = cache->offset;
+
+  while (idx != tail) {
+    GstAiurStreamCacheSlot *slot = SLOT (cache, idx);
+    if (pos < slot->map.size)
+      break;
+    pos -= slot->map.size;
+    idx++;
+  }
+  cache->read_slot = idx;
+  cache->read_pos = pos;
+}
+
+/* consumer, with mutex: publish counters for get_stats, the upstream
+ * rate is published by the producer */
+static void
+gst_aiur_stream_cache_publish_locked (GstAiurStreamCache * cache)
+{
+  guint64 upstream_rate = cache->stats.upstream_rate;
+
+  cache->stats = cache->cstats;
+  cache->stats.upstream_rate = upstream_rate;
+  cache->cstats_pending = 0;
+}
+
+/* consumer: count an event, publish only in batches */
+static void
+gst_aiur_stream_cache_consumer_event (GstAiurStreamCache * cache)
+{
+  if (++cache->cstats_pending < AIUR_STREAM_CACHE_PUBLISH_EVENTS)
+    return;
+
+  g_mutex_lock (&cache->mutex);
+  gst_aiur_stream_cache_publish_locked (cache);
+  g_mutex_unlock (&cache->mutex);
+}
+
+/* consumer: pick up a new segment posted by the producer, data of older
+ * generations is stale and always sits in front of the ring */
+static void
+gst_aiur_stream_cache_sync (GstAiurStreamCache * cache)
+{
+  guint gen = (guint) g_atomic_int_get (&cache->gen);
+
+  if (G_LIKELY (gen == cache->read_gen))
+    return;
+
+  g_mutex_lock (&cache->mutex);
+  gen = (guint) g_atomic_int_get (&cache->gen);
+  cache->start = cache->gen_start;
+  if (cache->cstats_pending)
+    gst_aiur_stream_cache_publish_locked (cache);
+  g_mutex_unlock (&cache->mutex);
+
+  while (g_atomic_int_get (&cache->head) != g_atomic_int_get (&cache->tail)) {
+    GstAiurStreamCacheSlot *slot = SLOT (cache, cache->head);
+    gsize size = slot->map.size;
+    if (slot->gen == gen)
+      break;
+    gst_aiur_stream_cache_clear_slot (slot);
+    g_atomic_int_add (&cache->queued, -(gint) size);
+    g_atomic_int_set (&cache->head, cache->head + 1);
+  }
+
+  cache->read_gen = gen;
+  cache->offset = 0;
+  cache->read_slot = g_atomic_int_get (&cache->head);
+  cache->read_pos = 0;
+
+  gst_aiur_stream_cache_wakeup (cache, &cache->producer_waiting,
+      &cache->consume_cond);
+}
+
+/* consumer: copy (or skip when buffer is NULL) up to size bytes */
+static guint64
+gst_aiur_stream_cache_copy (GstAiurStreamCache * cache, guint64 size,
+    char *buffer)
+{
+  gint tail = g_atomic_int_get (&cache->tail);
+  guint64 copied = 0;
+
+  if (cache->offset > QUEUED_BYTES (cache)) {
+    /* pending forward skip, discard the gap as it arrives */
+    gst_aiur_stream_cache_check_preserve (cache);
+    if (cache->offset > QUEUED_BYTES (cache))
+      return 0;
+    gst_aiur_stream_cache_locate (cache);
+    tail = g_atomic_int_get (&cache->tail);
+  }
+
+  while ((copied < size) && (cache->read_slot != tail)) {
+    GstAiurStreamCacheSlot *slot = SLOT (cache, cache->read_slot);
+    guint64 len = MIN (size - copied, slot->map.size - cache->read_pos);
+
+    if (buffer) {
+      memcpy (buffer + copied, slot->map.data + cache->read_pos, len);
+    }
+    copied += len;
+    cache->read_pos += len;
+    if (cache->read_pos >= slot->map.size) {
+      cache->read_slot++;
+      cache->read_pos = 0;
+    }
+  }
+  cache->offset += copied;
+
+  gst_aiur_stream_cache_check_preserve (cache);
+
+  return copied;
+}
+
+/* consumer: sleep until the producer published something */
+static void
+gst_aiur_stream_cache_wait_data (GstAiurStreamCache * cache, gint tail)
+{
+  g_mutex_lock (&cache->mutex);
+  if (cache->cstats_pending)
+    gst_aiur_stream_cache_publish_locked (cache);
+  g_atomic_int_set (&cache->consumer_waiting, 1);
+  if ((g_atomic_int_get (&cache->tail) == tail)
+      && (!g_atomic_int_get (&cache->eos))
+      && (!g_atomic_int_get (&cache->closed))
+      && ((guint) g_atomic_int_get (&cache->gen) == cache->read_gen)) {
+    WAIT_COND_TIMEOUT (&cache->produce_cond, &cache->mutex, 1000000);
+  }
+  g_atomic_int_set (&cache->consumer_waiting, 0);
+  g_mutex_unlock (&cache->mutex);
+}
+
+/* producer: account bytes against the time spent upstream, time blocked
+ * in the cache is not upstream throughput. The first buffer of a segment
+ * waited for a seek and is left out. */
+static void
+gst_aiur_stream_cache_measure (GstAiurStreamCache * cache, guint64 size,
+    guint gen)
+{
+  GstClockTime now;
+  guint64 rate;
+
+  if ((gen != cache->rate_gen)
+      || !GST_CLOCK_TIME_IS_VALID (cache->last_leave)) {
+    cache->rate_gen = gen;
+    return;
+  }
+
+  now = gst_util_get_timestamp ();
+  cache->rate_time += now - cache->last_leave;
+  cache->rate_bytes += size;
+  if (cache->rate_time < AIUR_STREAM_CACHE_RATE_PERIOD)
+    return;
+
+  rate = gst_util_uint64_scale (cache->rate_bytes, GST_SECOND,
+      cache->rate_time);
+  cache->upstream_rate = AIUR_STREAM_CACHE_AVERAGE (cache->upstream_rate, rate);
+  cache->rate_time = 0;
+  cache->rate_bytes = 0;
+
+  /* once per period, not per buffer */
+  g_atomic_int_set (&cache->rate, (gint) MIN (cache->upstream_rate, G_MAXINT));
+  g_mutex_lock (&cache->mutex);
+  cache->stats.upstream_rate = cache->upstream_rate;
+  g_mutex_unlock (&cache->mutex);
+}
+
+/* consumer: first data after an upstream seek */
+static void
+gst_aiur_stream_cache_seek_done (GstAiurStreamCache * cache)
+{
+  GstClockTime cost = gst_util_get_timestamp () - cache->seek_start;
+
+  cache->cstats.seek_cost =
+      AIUR_STREAM_CACHE_AVERAGE (cache->cstats.seek_cost, cost);
+  cache->seek_start = GST_CLOCK_TIME_NONE;
+  gst_aiur_stream_cache_consumer_event (cache);
+}
+
+/* consumer: gap worth waiting for rather than paying an upstream seek */
+static guint64
+gst_aiur_stream_cache_skip_threshold (GstAiurStreamCache * cache)
+{
+  guint64 threshold = AIUR_STREAM_CACHE_SKIP_DEFAULT;
+  guint64 rate = (guint64) g_atomic_int_get (&cache->rate);
+
+  if (rate && cache->cstats.seek_cost) {
+    threshold = gst_util_uint64_scale (rate, cache->cstats.seek_cost,
+        GST_SECOND);
+    threshold = MAX (threshold, AIUR_STREAM_CACHE_SKIP_MIN);
+  }
+  threshold = MIN (threshold, (guint64) g_atomic_int_get (&cache->max_skip));
+  cache->cstats.skip_threshold = threshold;
+
+  return threshold;
+}
 
 void
 gst_aiur_stream_cache_finalize (GstAiurStreamCache * cache)
@@ -87,10 +408,13 @@ gst_aiur_stream_cache_finalize (GstAiurStreamCache * cache)
     cache->pad = NULL;
   }
 
-  if (cache->adapter) {
-    gst_adapter_clear (cache->adapter);
-    gst_object_unref (cache->adapter);
-    cache->adapter = NULL;
+  if (cache->slots) {
+    while (cache->head != cache->tail) {
+      gst_aiur_stream_cache_clear_slot (SLOT (cache, cache->head));
+      cache->head++;
+    }
+    g_free (cache->slots);
+    cache->slots = NULL;
   }
 
   g_cond_clear (&cache->produce_cond);
@@ -105,7 +429,11 @@ gst_aiur_stream_cache_close (GstAiurStreamCache * cache)
 {
 
   if (cache) {
-    cache->closed = TRUE;
+    g_mutex_lock (&cache->mutex);
+    g_atomic_int_set (&cache->closed, TRUE);
+    g_cond_broadcast (&cache->produce_cond);
+    g_cond_broadcast (&cache->consume_cond);
+    g_mutex_unlock (&cache->mutex);
   }
 }
 
@@ -113,7 +441,7 @@ void
 gst_aiur_stream_cache_open (GstAiurStreamCache * cache)
 {
   if (cache) {
-    cache->closed = FALSE;
+    g_atomic_int_set (&cache->closed, FALSE);
   }
 }
 
@@ -132,22 +460,41 @@ gst_aiur_stream_cache_new (guint64 threshold_max, guint64 threshold_pre,
 
   cache->pad = NULL;
 
-  cache->adapter = gst_adapter_new ();
+  cache->slots = g_new0 (GstAiurStreamCacheSlot, AIUR_STREAM_CACHE_SLOTS);
+  cache->slot_mask = AIUR_STREAM_CACHE_SLOTS - 1;
   g_mutex_init (&cache->mutex);
   g_cond_init (&cache->consume_cond);
   g_cond_init (&cache->produce_cond);
 
   cache->threshold_max = threshold_max;
   cache->threshold_pre = threshold_pre;
+  cache->max_slot = 0;
+  cache->max_read = 0;
 
+  cache->head = cache->tail = 0;
+  cache->queued = 0;
+  cache->read_slot = 0;
+  cache->read_pos = 0;
   cache->start = 0;
   cache->offset = 0;
-  cache->ignore_size = 0;
+  cache->gen = 0;
+  cache->read_gen = 0;
+  cache->gen_start = 0;
 
   cache->eos = FALSE;
   cache->seeking = FALSE;
   cache->closed = FALSE;
 
+  cache->last_leave = GST_CLOCK_TIME_NONE;
+  cache->rate_gen = 0;
+  cache->upstream_rate = 0;
+  cache->rate = 0;
+  cache->max_skip = AIUR_STREAM_CACHE_SKIP_MAX;
+  cache->seek_start = GST_CLOCK_TIME_NONE;
+  cache->cstats.skip_threshold = AIUR_STREAM_CACHE_SKIP_DEFAULT;
+  cache->cstats_pending = 0;
+  cache->stats.skip_threshold = AIUR_STREAM_CACHE_SKIP_DEFAULT;
+
   cache->context = context;
 
   return cache;
@@ -177,32 +524,35 @@ gst_aiur_stream_cache_availiable_bytes (GstAiurStreamCache * cache)
   gint64 avail = -1;
 
   if (cache) {
-    g_mutex_lock (&cache->mutex);
     avail = AVAIL_BYTES (cache);
-    g_mutex_unlock (&cache->mutex);
   }
 
   return avail;
 }
 
 
+/* producer: start a new generation, stale slots are dropped by consumer */
+static void
+gst_aiur_stream_cache_reset (GstAiurStreamCache * cache, guint64 start)
+{
+  g_mutex_lock (&cache->mutex);
+
+  cache->gen_start = start;
+  g_atomic_int_inc (&cache->gen);
+  g_atomic_int_set (&cache->seeking, FALSE);
+  g_atomic_int_set (&cache->eos, FALSE);
+
+  g_cond_signal (&cache->produce_cond);
+
+  g_mutex_unlock (&cache->mutex);
+}
+
 void
 gst_aiur_stream_cache_set_segment (GstAiurStreamCache * cache, guint64 start,
     guint64 stop)
 {
   if (cache) {
-    g_mutex_lock (&cache->mutex);
-
-    cache->seeking = FALSE;
-    cache->start = start;
-    cache->offset = 0;
-    cache->ignore_size = 0;
-    gst_adapter_clear (cache->adapter);
-    cache->eos = FALSE;
-
-    g_cond_signal (&cache->consume_cond);
-
-    g_mutex_unlock (&cache->mutex);
+    gst_aiur_stream_cache_reset (cache, start);
   }
 }
 
@@ -211,84 +561,86 @@ void
 gst_aiur_stream_cache_add_buffer (GstAiurStreamCache * cache,
     GstBuffer * buffer)
 {
-  guint64 size;
+  guint i, n_mem;
+  guint gen;
   gint trycnt = 0;
   if ((cache == NULL) || (buffer == NULL))
     goto bail;
 
-  g_mutex_lock (&cache->mutex);
-
-  size = gst_buffer_get_size (buffer);
-
-  if ((cache->seeking) || (size == 0)) {
-    g_mutex_unlock (&cache->mutex);
+  if ((g_atomic_int_get (&cache->seeking))
+      || (gst_buffer_get_size (buffer) == 0)) {
     goto bail;
   }
 
-  if (cache->ignore_size) {
-    /* drop part or total buffer */
-    if (cache->ignore_size >= size) {
-      cache->ignore_size -= size;
-      g_mutex_unlock (&cache->mutex);
-      goto bail;
-    } else {
-      GstMapInfo map;
-      GstBuffer * newBuffer;
-      guint8 *inbuf = NULL;
-      gst_buffer_map (buffer, &map, GST_MAP_READ);
-      size = map.size;
-      inbuf = map.data;
-      gst_buffer_unmap(buffer,&map);
-
-      newBuffer = gst_buffer_new_and_alloc (size - cache->ignore_size);
-      gst_buffer_fill(newBuffer,0,(guint8 *)inbuf+cache->ignore_size,size - cache->ignore_size);
-      cache->ignore_size = 0;
-
-      gst_adapter_push (cache->adapter, newBuffer);
-      newBuffer = NULL;
-      if (buffer) {
-        gst_buffer_unref (buffer);
-      }
-    }
-
-  }else{
-    gst_adapter_push (cache->adapter, buffer);
-  }
-  g_cond_signal (&cache->produce_cond);
+  gen = (guint) g_atomic_int_get (&cache->gen);
+  gst_aiur_stream_cache_measure (cache, gst_buffer_get_size (buffer), gen);
+  n_mem = gst_buffer_n_memory (buffer);
 
-  buffer = NULL;
+  for (i = 0; i < n_mem; i++) {
+    GstMemory *mem = gst_buffer_peek_memory (buffer, i);
+    GstAiurStreamCacheSlot *slot;
+    gint tail;
+    gsize mem_size = gst_memory_get_sizes (mem, NULL, NULL);
 
-  if (cache->threshold_max) {
-#if 0
-    if (cache->threshold_max < size + cache->threshold_pre) {
-      cache->threshold_max = size + cache->threshold_pre;
+    if (mem_size > (gsize) g_atomic_int_get (&cache->max_slot)) {
+      gst_aiur_stream_cache_update_max (&cache->max_slot, mem_size);
+      gst_aiur_stream_cache_fit_threshold (cache);
     }
-#endif
 
-    while ((gst_adapter_available (cache->adapter) > cache->threshold_max)
-        && (cache->closed == FALSE)) {
+    /* wait for a free slot, and for the consumer to catch up */
+    while ((USED_SLOTS (cache) > cache->slot_mask)
+        || (cache->threshold_max
+            && (QUEUED_BYTES (cache) >
+                (guint64) g_atomic_int_get (&cache->threshold_max)))) {
+      if (g_atomic_int_get (&cache->closed)
+          || g_atomic_int_get (&cache->seeking))
+        goto bail;
+
       if (((++trycnt) & 0x1f) == 0x0) {
-        GST_WARNING ("wait push try %d SIZE %d %lld", trycnt,
-            gst_adapter_available (cache->adapter), cache->threshold_max);
+        GST_WARNING ("wait push try %d SIZE %lld %d", trycnt,
+            QUEUED_BYTES (cache), g_atomic_int_get (&cache->threshold_max));
       }
-      WAIT_COND_TIMEOUT (&cache->consume_cond, &cache->mutex, 1000000);
-    }
 
-    if (cache->seeking) {
+      g_mutex_lock (&cache->mutex);
+      g_atomic_int_set (&cache->producer_waiting, 1);
+      if ((USED_SLOTS (cache) > cache->slot_mask)
+          || (cache->threshold_max
+              && (QUEUED_BYTES (cache) >
+                  (guint64) g_atomic_int_get (&cache->threshold_max)))) {
+        WAIT_COND_TIMEOUT (&cache->consume_cond, &cache->mutex, 1000000);
+      }
+      g_atomic_int_set (&cache->producer_waiting, 0);
       g_mutex_unlock (&cache->mutex);
+    }
+
+    tail = g_atomic_int_get (&cache->tail);
+    slot = SLOT (cache, tail);
+    if (!gst_memory_map (mem, &slot->map, GST_MAP_READ)) {
+      GST_ERROR ("stream cache failed to map upstream memory");
       goto bail;
     }
-  }
+    if (slot->map.size == 0) {
+      gst_memory_unmap (mem, &slot->map);
+      continue;
+    }
+    slot->mem = gst_memory_ref (mem);
+    slot->gen = gen;
 
+    g_atomic_int_add (&cache->queued, (gint) slot->map.size);
+    g_atomic_int_set (&cache->tail, tail + 1);
 
-  g_mutex_unlock (&cache->mutex);
-
-  return;
+    gst_aiur_stream_cache_wakeup (cache, &cache->consumer_waiting,
+        &cache->produce_cond);
+  }
 
 bail:
   if (buffer) {
     gst_buffer_unref (buffer);
   }
+  /* producer only */
+  if (cache) {
+    cache->last_leave = gst_util_get_timestamp ();
+  }
 }
 
 void
@@ -296,7 +648,7 @@ gst_aiur_stream_cache_seteos (GstAiurStreamCache * cache, gboolean eos)
 {
   if (cache) {
     g_mutex_lock (&cache->mutex);
-    cache->eos = eos;
+    g_atomic_int_set (&cache->eos, eos);
     g_cond_signal (&cache->produce_cond);
     g_mutex_unlock (&cache->mutex);
   }
@@ -309,10 +661,8 @@ gst_aiur_stream_cache_get_position (GstAiurStreamCache * cache)
 
   gint64 pos = -1;
   if (cache) {
-
-    g_mutex_lock (&cache->mutex);
+    gst_aiur_stream_cache_sync (cache);
     pos = READ_ADDR (cache);
-    g_mutex_unlock (&cache->mutex);
   }
   return pos;
 }
@@ -332,56 +682,65 @@ gst_aiur_stream_cache_seek (GstAiurStreamCache * cache, guint64 addr)
   }
 
 tryseek:
-  g_mutex_lock (&cache->mutex);
-
+  gst_aiur_stream_cache_sync (cache);
 
   if (addr < cache->start) {    /* left */
     GST_DEBUG ("Flush cache, backward seek addr %lld, cachestart %lld, offset %lld",
         addr, cache->start, cache->offset);
     isfail = 1;
     goto trysendseek;
-  } else if (addr <= cache->start + gst_adapter_available (cache->adapter)) {
+  } else if (addr <= cache->start + QUEUED_BYTES (cache)) {
     if (addr != READ_ADDR (cache)) {
+      cache->cstats.cache_seeks++;
+      if (addr < READ_ADDR (cache))
+        cache->cstats.backward_seeks++;
+      gst_aiur_stream_cache_consumer_event (cache);
       cache->offset = addr - cache->start;
-      CHECK_PRESERVE (cache);
+      gst_aiur_stream_cache_locate (cache);
+      gst_aiur_stream_cache_check_preserve (cache);
     }
 
-  } else if ((addr > (cache->start + gst_adapter_available (cache->adapter))) && ((addr < cache->start + 2000000) || (isfail))) {       /* right */
-    cache->ignore_size =
-        addr - cache->start - gst_adapter_available (cache->adapter);
-
-    cache->start = addr;
-    cache->offset = 0;
-    gst_adapter_clear (cache->adapter);
-    g_cond_signal (&cache->consume_cond);
+  } else if ((isfail)
+      || (addr - (cache->start + QUEUED_BYTES (cache)) <
+          gst_aiur_stream_cache_skip_threshold (cache))) {     /* right */
+    /* skip the gap when it arrives, no need to bother upstream */
+    cache->cstats.skips++;
+    cache->cstats.skipped_bytes += addr - (cache->start + QUEUED_BYTES (cache));
+    gst_aiur_stream_cache_consumer_event (cache);
+    cache->offset = addr - cache->start;
+    gst_aiur_stream_cache_check_preserve (cache);
+    gst_aiur_stream_cache_locate (cache);
   } else {
     goto trysendseek;
   }
-  g_mutex_unlock (&cache->mutex);
   return 0;
 #if 1
 trysendseek:
 
   GST_INFO ("stream cache try seek to %lld", addr);
 
-  gst_adapter_clear (cache->adapter);
+  g_atomic_int_set (&cache->seeking, TRUE);
+  g_atomic_int_set (&cache->eos, FALSE);
 
-  cache->offset = 0;
+  gst_aiur_stream_cache_drain (cache);
   cache->start = addr;
-  cache->ignore_size = 0;
-
+  cache->offset = 0;
 
-  cache->seeking = TRUE;
-  cache->eos = FALSE;
+  /* an upstream seek costs far more than publishing */
+  cache->cstats.upstream_seeks++;
+  cache->seek_start = gst_util_get_timestamp ();
+  g_mutex_lock (&cache->mutex);
+  gst_aiur_stream_cache_publish_locked (cache);
   g_mutex_unlock (&cache->mutex);
+
   ret =
       gst_pad_push_event (cache->pad, gst_event_new_seek ((gdouble) 1,
           GST_FORMAT_BYTES, GST_SEEK_FLAG_FLUSH, GST_SEEK_TYPE_SET,
           (gint64) addr, GST_SEEK_TYPE_NONE, (gint64) (-1)));
-  g_cond_signal (&cache->consume_cond);
-
 
   if (ret == FALSE) {
+    g_atomic_int_set (&cache->seeking, FALSE);
+    cache->seek_start = GST_CLOCK_TIME_NONE;
     if (isfail == 0) {
       isfail = 1;
       goto tryseek;
@@ -400,56 +759,51 @@ gst_aiur_stream_cache_read (GstAiurStreamCache * cache, guint64 size,
     char *buffer)
 {
   gint64 readsize = -1;
-  gint retrycnt = 0;
+  guint64 done = 0;
   if (cache == NULL) {
     return readsize;
   }
 
-try_read:
-
-  if (cache->closed == TRUE) {
-    return readsize;
+  if (size > (guint64) g_atomic_int_get (&cache->max_read)) {
+    gst_aiur_stream_cache_update_max (&cache->max_read, size);
+    gst_aiur_stream_cache_fit_threshold (cache);
   }
 
-  g_mutex_lock (&cache->mutex);
-
-  if (cache->seeking == TRUE)
-    goto not_enough_bytes;
-
-  if ((cache->threshold_max)
-      && (cache->threshold_max < size + cache->threshold_pre)) {
-    cache->threshold_max = size + cache->threshold_pre;
-    /* enlarge maxsize means consumed */
-    g_cond_signal (&cache->consume_cond);
-  }
+  while (TRUE) {
+    gint tail;
 
-  if (size > AVAIL_BYTES (cache)) {
-    if (cache->eos) {           /* not enough bytes when eos */
-      readsize = AVAIL_BYTES (cache);
-      if (readsize) {
-        READ_BYTES (cache, buffer, readsize);
-      }
-      goto beach;
+    if (g_atomic_int_get (&cache->closed)) {
+      return readsize;
     }
-    goto not_enough_bytes;
-  }
 
-  readsize = size;
-  READ_BYTES (cache, buffer, readsize);
+    gst_aiur_stream_cache_sync (cache);
 
-  goto beach;
+    tail = g_atomic_int_get (&cache->tail);
 
+    if (!g_atomic_int_get (&cache->seeking)) {
+      /* copy what is there, a read larger than the ring is served in
+       * several rounds instead of waiting for it to fit */
+      guint64 copied = gst_aiur_stream_cache_copy (cache, size - done,
+          buffer ? buffer + done : NULL);
 
-not_enough_bytes:
-  //g_print("not enough %lld, try %d\n", size, retrycnt++);
-  WAIT_COND_TIMEOUT (&cache->produce_cond, &cache->mutex, 1000000);
-  g_mutex_unlock (&cache->mutex);
+      if (copied && GST_CLOCK_TIME_IS_VALID (cache->seek_start))
+        gst_aiur_stream_cache_seek_done (cache);
+      done += copied;
+      if (done >= size)
+        break;
 
-  goto try_read;
+      if (g_atomic_int_get (&cache->eos)) {
+        /* not enough bytes when eos */
+        if (g_atomic_int_get (&cache->tail) == tail)
+          break;
+        continue;
+      }
+    }
 
+    gst_aiur_stream_cache_wait_data (cache, tail);
+  }
 
-beach:
-  g_mutex_unlock (&cache->mutex);
+  readsize = done;
   return readsize;
 }
 
@@ -457,18 +811,36 @@ void
 gst_aiur_stream_cache_flush (GstAiurStreamCache * cache)
 {
   if (cache) {
-    g_mutex_lock (&cache->mutex);
+    gst_aiur_stream_cache_reset (cache, 0);
+  }
+}
 
-    cache->seeking = FALSE;
-    cache->start = 0;
-    cache->offset = 0;
-    cache->ignore_size = 0;
-    gst_adapter_clear (cache->adapter);
-    cache->eos = FALSE;
+void
+gst_aiur_stream_cache_set_preserve_size (GstAiurStreamCache * cache,
+    guint64 size)
+{
+  if (cache) {
+    cache->threshold_pre = size;
+    gst_aiur_stream_cache_fit_threshold (cache);
+  }
+}
 
-    g_cond_signal (&cache->consume_cond);
+void
+gst_aiur_stream_cache_set_max_skip (GstAiurStreamCache * cache,
+    guint64 size)
+{
+  if (cache) {
+    g_atomic_int_set (&cache->max_skip, (gint) MIN (size, G_MAXINT));
+  }
+}
 
+void
+gst_aiur_stream_cache_get_stats (GstAiurStreamCache * cache,
+    GstAiurStreamCacheStats * stats)
+{
+  if (cache && stats) {
+    g_mutex_lock (&cache->mutex);
+    *stats = cache->stats;
     g_mutex_unlock (&cache->mutex);
   }
 }
-
@@ -42,6 +42,15 @@
 #define AIUR_STREAM_CACHE_SIZE 200000
 #define AIUR_STREAM_CACHE_SIZE_MAX (AIUR_STREAM_CACHE_SIZE+10)
 
+/* number of upstream memory blocks the ring can reference, power of 2 */
+#define AIUR_STREAM_CACHE_SLOTS 4096
+
+/* forward gap skipped by waiting for data instead of seeking upstream,
+ * adapted to upstream rate times seek cost within [MIN, max_skip] */
+#define AIUR_STREAM_CACHE_SKIP_DEFAULT 2000000
+#define AIUR_STREAM_CACHE_SKIP_MIN 65536
+#define AIUR_STREAM_CACHE_SKIP_MAX 16777216
+
 #if 0
 #define GST_TYPE_AIURSTREAMCACHE \
   (gst_aiur_stream_cache_get_type())
@@ -59,27 +68,91 @@
 typedef struct _GstAiurStreamCache GstAiurStreamCache;
 //typedef struct _GstAiurStreamCacheClass GstAiurStreamCacheClass;
 
+typedef struct
+{
+  guint64 cache_seeks;          /* served from data in the ring */
+  guint64 backward_seeks;       /* of them, behind the read position */
+  guint64 skips;                /* forward gaps waited for */
+  guint64 skipped_bytes;
+  guint64 upstream_seeks;
+  guint64 upstream_rate;        /* bytes per second */
+  guint64 seek_cost;            /* ns from seek to first new data */
+  guint64 skip_threshold;
+} GstAiurStreamCacheStats;
+
+typedef struct
+{
+  GstMemory *mem;
+  GstMapInfo map;
+  guint gen;                    /* generation the slot was produced in */
+} GstAiurStreamCacheSlot;
+
+/*
+ * The cache is a single-producer/single-consumer ring of references to
+ * upstream GstMemory blocks. The streaming thread (chain) only advances
+ * tail, the parser thread only advances head and the read position, so
+ * the data path needs no lock. The mutex is only taken to sleep when
+ * the ring is empty or full, to pass control values (segment start)
+ * from the producer to the consumer, and to publish statistics in
+ * batches.
+ */
 struct _GstAiurStreamCache
 {
   GstMiniObject mini_object;
 
   GstPad *pad;
-  GstAdapter *adapter;
   GMutex mutex;
   GCond consume_cond;
   GCond produce_cond;
 
-  guint64 start;
-  guint64 offset;
+  GstAiurStreamCacheSlot *slots;
+  guint slot_mask;
+
+  volatile gint head;           /* consumer: oldest slot kept */
+  volatile gint tail;           /* producer: next slot to fill */
+  volatile gint queued;         /* bytes referenced from head to tail */
+
+  /* consumer side */
+  gint read_slot;               /* slot containing READ_ADDR */
+  guint64 read_pos;             /* offset of READ_ADDR inside read_slot */
+  guint64 start;                /* address of first byte of head slot */
+  guint64 offset;               /* READ_ADDR - start */
+  guint read_gen;
+
+  /* producer to consumer */
+  volatile gint gen;
+  guint64 gen_start;            /* protected by mutex */
+
+  volatile gint threshold_max;  /* threshold for cache max-size */
+  guint64 threshold_pre;        /* bytes preserved behind READ_ADDR */
+  volatile gint max_slot;       /* largest upstream memory seen */
+  volatile gint max_read;       /* largest read size seen */
 
-  guint64 threshold_max;        /* threshold for cache max-size */
-  guint64 threshold_pre;        /* threshold for cache max-size */
+  volatile gint producer_waiting;
+  volatile gint consumer_waiting;
 
-  guint64 ignore_size;
+  /* producer side, upstream rate */
+  GstClockTime rate_time;       /* upstream time since last update */
+  guint64 rate_bytes;
+  GstClockTime last_leave;      /* producer returned to upstream */
+  guint rate_gen;               /* first buffer of a segment is not rate */
+  guint64 upstream_rate;
 
-  gboolean eos;
-  gboolean seeking;
-  gboolean closed;
+  /* producer to consumer, bytes per second clamped to G_MAXINT */
+  volatile gint rate;
+  volatile gint max_skip;
+
+  /* consumer side, seek cost and counters */
+  GstClockTime seek_start;      /* upstream seek sent, first data pending */
+  GstAiurStreamCacheStats cstats;
+  guint cstats_pending;         /* events not yet published */
+
+  /* published with mutex for get_stats */
+  GstAiurStreamCacheStats stats;
+
+  volatile gint eos;
+  volatile gint seeking;
+  volatile gint closed;
 
   void *context;
 };
@@ -87,7 +160,6 @@ struct _GstAiurStreamCache
 
 
 
-
 void gst_aiur_stream_cache_finalize (GstAiurStreamCache * cache);
 
 
@@ -135,6 +207,18 @@ gst_aiur_stream_cache_read (GstAiurStreamCache * cache, guint64 size,
 void
 gst_aiur_stream_cache_flush (GstAiurStreamCache * cache);
 
+void
+gst_aiur_stream_cache_set_preserve_size (GstAiurStreamCache * cache,
+    guint64 size);
+
+void
+gst_aiur_stream_cache_set_max_skip (GstAiurStreamCache * cache,
+    guint64 size);
+
+void
+gst_aiur_stream_cache_get_stats (GstAiurStreamCache * cache,
+    GstAiurStreamCacheStats * stats);
+
 
 
 
@@ -56,7 +56,12 @@
 
 #define BEEP_REGISTRY_FILE_ENV_NAME "BEEP_REGISTRY"
 
+/* which core libraries load, set empty to probe all on every start */
+#define BEEP_CORE_CACHE_ENV_NAME "BEEP_CORE_CACHE"
+#define BEEP_CORE_CACHE_NAME "beep_core_cache"
+
 static GstsutilsEntry *g_beep_caps_entry = NULL;
+static GstsutilsCoreCache *g_beep_core_cache = NULL;
 
 /* id table for all core apis, the same order with BeepCoreInterface */
 static uint32 beep_core_interface_id_table[] = {
@@ -129,6 +134,26 @@ fail:
   return inf;
 }
 
+/* dlopen libname only when the core cache does not know it yet */
+static gboolean
+beep_core_lib_loadable (gchar * libname)
+{
+  void *dlhandle;
+  gboolean loadable;
+
+  if (gstsutils_core_cache_lookup (g_beep_core_cache, libname, &loadable))
+    return loadable;
+
+  dlhandle = dlopen (libname, RTLD_LAZY);
+  loadable = (dlhandle != NULL);
+  if (dlhandle)
+    dlclose (dlhandle);
+
+  gstsutils_core_cache_store (g_beep_core_cache, libname, loadable);
+
+  return loadable;
+}
+
 static GstCaps * beep_get_caps_from_entry(GstsutilsEntry * entry)
 {
   int group_count=0;
@@ -136,7 +161,6 @@ static GstCaps * beep_get_caps_from_entry(GstsutilsEntry * entry)
   char* mime = NULL;
   char* libname = NULL;
   GstsutilsGroup *group=NULL;
-  void *dlhandle = NULL;
   GstCaps * caps = NULL;
   group_count = gstsutils_get_group_count(entry);
 
@@ -155,8 +179,7 @@ static GstCaps * beep_get_caps_from_entry(GstsutilsEntry * entry)
       }
     }
 
-    dlhandle = dlopen (libname, RTLD_LAZY);
-    if (!dlhandle) {
+    if (!beep_core_lib_loadable (libname)) {
       g_free(mime);
       g_free(libname);
       continue;
@@ -175,7 +198,6 @@ static GstCaps * beep_get_caps_from_entry(GstsutilsEntry * entry)
       caps = gst_caps_from_string (mime);
     }
 
-    dlclose (dlhandle);
     g_free(mime);
     g_free(libname);
 
@@ -236,7 +258,12 @@ beep_core_get_caps ()
     g_beep_caps_entry = gstsutils_init_entry(beepenv);
   }
 
+  if (g_beep_core_cache == NULL)
+    g_beep_core_cache = gstsutils_core_cache_open (BEEP_CORE_CACHE_ENV_NAME,
+        BEEP_CORE_CACHE_NAME);
+
   caps = beep_get_caps_from_entry(g_beep_caps_entry);
+  gstsutils_core_cache_sync (g_beep_core_cache);
 
   return caps;
 }
@@ -248,16 +275,14 @@ beep_core_create_interface_from_caps_dsp (GstCaps * caps)
   BeepCoreInterface *inf = NULL;
   GstsutilsGroup * group;
   gchar * libname = NULL;
-  void *dlhandle = NULL;
 
   group = beep_core_find_caps_group(g_beep_caps_entry,caps);
   if (group) {
     if (gstsutils_get_value_by_key(group,FSL_KEY_DSP_LIB, &libname)){
-       dlhandle = dlopen(libname, RTLD_LAZY);
-      if (dlhandle) {
-        dlclose (dlhandle);
+      if (beep_core_lib_loadable (libname)) {
         inf = _beep_core_create_interface_from_entry (libname);
-        inf->name = gstsutils_get_group_name(group);
+        if (inf)
+          inf->name = gstsutils_get_group_name(group);
       }
     }
   }
@@ -277,16 +302,13 @@ beep_core_create_interface_from_caps (GstCaps * caps)
   gchar * libname2 = NULL;
   gchar * temp_name;
   gboolean find = TRUE;
-  void *dlhandle = NULL;
 
   group = beep_core_find_caps_group(g_beep_caps_entry,caps);
   if (group) {
 
     if(gstsutils_get_value_by_key(group,FSL_KEY_LIB2,&libname2)){
-      dlhandle = dlopen (libname2, RTLD_LAZY);
-      if(dlhandle){
+      if(beep_core_lib_loadable (libname2)){
         libname = libname2;
-        dlclose (dlhandle);
       }else{
         g_free(libname2);
       }
@@ -300,10 +322,17 @@ beep_core_create_interface_from_caps (GstCaps * caps)
     else
       return inf;
 
+    /* the cache was stale, e.g. a dependency of the core went away */
+    if (inf == NULL) {
+      gstsutils_core_cache_store (g_beep_core_cache, libname, FALSE);
+      gstsutils_core_cache_sync (g_beep_core_cache);
+    }
+
     if(libname)
       g_free(libname);
 
-    inf->name = gstsutils_get_group_name(group);
+    if (inf)
+      inf->name = gstsutils_get_group_name(group);
   }
   return inf;
 }
@@ -332,6 +361,7 @@ void
 beep_free_dll_entry ()
 {
   gstsutils_deinit_entry(g_beep_caps_entry);
+  gstsutils_core_cache_close (g_beep_core_cache);
 
 }
 
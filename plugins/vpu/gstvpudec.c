@@ -59,7 +59,12 @@ enum
   PROP_ADAPTIVE_FRAME_DROP,
   PROP_FRAMES_PLUS,
   PROP_USE_VPU_MEMORY,
-  PROP_DISABLE_REORDER
+  PROP_DISABLE_REORDER,
+  PROP_LATENCY_REFRESH,
+  PROP_LATENCY_QUERIES_AVOIDED,
+  PROP_ASYNC_DECODE,
+  PROP_STATS,
+  PROP_STATS_INTERVAL
 };
 
 #define DEFAULT_LOW_LATENCY FALSE
@@ -67,6 +72,9 @@ enum
 #define DEFAULT_ADAPTIVE_FRAME_DROP TRUE
 #define DEFAULT_FRAMES_PLUS 3
 #define DEFAULT_DISABLE_REORDER FALSE
+#define DEFAULT_LATENCY_REFRESH 1000
+#define DEFAULT_ASYNC_DECODE FALSE
+#define DEFAULT_STATS_INTERVAL 0
 /* Default to use VPU memory for video frame buffer as all video frame buffer
  * must registe to VPU. Change video frame buffer will cause close VPU which
  * will cause video stream lost.
@@ -93,6 +101,8 @@ static GstFlowReturn gst_vpu_dec_finish (GstVideoDecoder * bdec);
 static gboolean gst_vpu_dec_decide_allocation (GstVideoDecoder * bdec,
     GstQuery * query);
 static gboolean gst_vpu_dec_reset (GstVideoDecoder * bdec, gboolean hard);
+static gboolean gst_vpu_dec_src_event (GstVideoDecoder * bdec,
+    GstEvent * event);
 
 #define gst_vpu_dec_parent_class parent_class
 G_DEFINE_TYPE (GstVpuDec, gst_vpu_dec, GST_TYPE_VIDEO_DECODER);
@@ -150,6 +160,26 @@ gst_vpu_dec_class_init (GstVpuDecClass * klass)
       g_param_spec_boolean ("disable-reorder", "disable reorder",
         "disable vpu reorder when end to end streaming",
           DEFAULT_DISABLE_REORDER, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_REFRESH,
+      g_param_spec_uint ("latency-refresh", "latency refresh",
+        "interval in ms to query peer latency again, 0 to query only on latency events, caps changes and flushes",
+          0, G_MAXUINT, DEFAULT_LATENCY_REFRESH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_QUERIES_AVOIDED,
+      g_param_spec_uint64 ("latency-queries-avoided", "latency queries avoided",
+        "output frames which used the cached peer latency instead of a query",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_ASYNC_DECODE,
+      g_param_spec_boolean ("async-decode", "async decode",
+        "feed the VPU from a decode thread and push decoded frames from another thread",
+          DEFAULT_ASYNC_DECODE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "stats",
+        "decode statistics: frames, decode time and latency histograms in us, drops, framebuffer occupancy and reorder depth",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "stats interval",
+        "interval in ms to post the stats as element message, 0 to disable",
+          0, G_MAXUINT, DEFAULT_STATS_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
  
   gst_element_class_add_pad_template (element_class,
           gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
@@ -171,6 +201,7 @@ gst_vpu_dec_class_init (GstVpuDecClass * klass)
   vdec_class->finish = GST_DEBUG_FUNCPTR (gst_vpu_dec_finish);
   vdec_class->decide_allocation = GST_DEBUG_FUNCPTR (gst_vpu_dec_decide_allocation);
   vdec_class->reset = GST_DEBUG_FUNCPTR (gst_vpu_dec_reset);
+  vdec_class->src_event = GST_DEBUG_FUNCPTR (gst_vpu_dec_src_event);
 
   GST_DEBUG_CATEGORY_INIT (vpu_dec_debug, "vpudec", 0, "VPU decoder");
   GST_DEBUG_CATEGORY_GET (GST_CAT_PERFORMANCE, "GST_PERFORMANCE");
@@ -190,6 +221,9 @@ gst_vpu_dec_init (GstVpuDec * dec)
   GST_VPU_DEC_USE_VPU_MEMORY (dec->vpu_dec_object) = DEFAULT_USE_VPU_MEMORY;
   GST_VPU_DEC_MIN_BUF_CNT (dec->vpu_dec_object) = 0;
   GST_VPU_DEC_DISABLE_REORDER (dec->vpu_dec_object) = DEFAULT_DISABLE_REORDER;
+  GST_VPU_DEC_LATENCY_REFRESH (dec->vpu_dec_object) = DEFAULT_LATENCY_REFRESH;
+  GST_VPU_DEC_ASYNC_DECODE (dec->vpu_dec_object) = DEFAULT_ASYNC_DECODE;
+  GST_VPU_DEC_STATS_INTERVAL (dec->vpu_dec_object) = DEFAULT_STATS_INTERVAL;
 
   /* As VPU can support stream mode. need call parser before decode */
   gst_video_decoder_set_packetized (GST_VIDEO_DECODER (dec), TRUE);
@@ -220,6 +254,21 @@ gst_vpu_dec_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_DISABLE_REORDER:
       g_value_set_boolean (value, GST_VPU_DEC_DISABLE_REORDER (dec->vpu_dec_object));
       break;
+    case PROP_LATENCY_REFRESH:
+      g_value_set_uint (value, GST_VPU_DEC_LATENCY_REFRESH (dec->vpu_dec_object));
+      break;
+    case PROP_LATENCY_QUERIES_AVOIDED:
+      g_value_set_uint64 (value, dec->vpu_dec_object->latency_queries_avoided);
+      break;
+    case PROP_ASYNC_DECODE:
+      g_value_set_boolean (value, GST_VPU_DEC_ASYNC_DECODE (dec->vpu_dec_object));
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_vpu_dec_object_get_stats (dec->vpu_dec_object));
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, GST_VPU_DEC_STATS_INTERVAL (dec->vpu_dec_object));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -251,6 +300,15 @@ gst_vpu_dec_set_property (GObject * object, guint prop_id,
     case PROP_DISABLE_REORDER:
       GST_VPU_DEC_DISABLE_REORDER (dec->vpu_dec_object) = g_value_get_boolean (value);
       break;
+    case PROP_LATENCY_REFRESH:
+      GST_VPU_DEC_LATENCY_REFRESH (dec->vpu_dec_object) = g_value_get_uint (value);
+      break;
+    case PROP_ASYNC_DECODE:
+      GST_VPU_DEC_ASYNC_DECODE (dec->vpu_dec_object) = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_VPU_DEC_STATS_INTERVAL (dec->vpu_dec_object) = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -283,6 +341,10 @@ gst_vpu_dec_start (GstVideoDecoder * bdec)
 {
   GstVpuDec *dec = (GstVpuDec *) bdec;
 
+  /* handle_frame and finish must agree on the path until stop */
+  dec->vpu_dec_object->async_active = \
+      GST_VPU_DEC_ASYNC_DECODE (dec->vpu_dec_object);
+
   return gst_vpu_dec_object_start (dec->vpu_dec_object);
 }
 
@@ -291,6 +353,8 @@ gst_vpu_dec_stop (GstVideoDecoder * bdec)
 {
   GstVpuDec *dec = (GstVpuDec *) bdec;
 
+  gst_vpu_dec_object_async_stop (dec->vpu_dec_object, bdec, FALSE, TRUE);
+
   return gst_vpu_dec_object_stop (dec->vpu_dec_object);
 }
 
@@ -298,15 +362,14 @@ static gboolean
 gst_vpu_dec_set_format (GstVideoDecoder * bdec, GstVideoCodecState * state)
 {
   GstVpuDec *dec = (GstVpuDec *) bdec;
-  GstQuery *query;
   gboolean is_live;
 
-  query = gst_query_new_latency ();
-  is_live = FALSE;
-  if (gst_pad_peer_query (GST_VIDEO_DECODER_SINK_PAD (bdec), query)) {
-    gst_query_parse_latency (query, &is_live, NULL, NULL);
-  }
-  gst_query_unref (query);
+  /* queued frames belong to the previous caps */
+  gst_vpu_dec_object_async_stop (dec->vpu_dec_object, bdec, TRUE, FALSE);
+
+  /* caps changed, the answer is also what send_output uses next */
+  gst_vpu_dec_object_latency_changed (dec->vpu_dec_object);
+  is_live = gst_vpu_dec_object_is_live (dec->vpu_dec_object, bdec);
 
   // Hantro VPU can get best performance with low lantency.
   if (is_live || IS_HANTRO()) {
@@ -325,6 +388,10 @@ gst_vpu_dec_handle_frame (GstVideoDecoder * bdec, GstVideoCodecFrame * frame)
 {
   GstFlowReturn ret;
   GstVpuDec *dec = (GstVpuDec *) bdec;
+
+  if (dec->vpu_dec_object->async_active)
+    return gst_vpu_dec_object_async_decode (dec->vpu_dec_object, bdec, frame);
+
   /* As one frame of some special streams can be decoded to be two frames,
   so ref the frame->input_buffer before we use it to avoid has been freed by others. */
   if (frame)
@@ -340,9 +407,76 @@ gst_vpu_dec_finish (GstVideoDecoder * bdec)
 {
   GstVpuDec *dec = (GstVpuDec *) bdec;
 
+  if (dec->vpu_dec_object->async_active)
+    return gst_vpu_dec_object_async_decode (dec->vpu_dec_object, bdec, NULL);
+
   return gst_vpu_dec_object_decode (dec->vpu_dec_object, bdec, NULL);
 }
 
+/* A resolution or DPB size change keeps the current pool when its buffers
+ * are big enough for the new geometry and enough of them are free for the
+ * new framebuffer count; the decoder lays them out again on registration. */
+static gboolean
+gst_vpu_dec_reuse_pool (GstVpuDec * dec, GstVideoDecoder * bdec,
+    GstQuery * query, GstVideoInfo * vinfo, guint min, gboolean update_pool)
+{
+  GstVpuDecObject *vpu_dec_object = dec->vpu_dec_object;
+  GstBufferPool *pool_pre;
+  GstStructure *config;
+  GstCaps *caps;
+  GstVideoInfo info, info_pre;
+  guint size_pre, min_buffers, max_buffers;
+  guint count, outstanding;
+  gsize size;
+  gboolean reuse = FALSE;
+
+  pool_pre = gst_video_decoder_get_buffer_pool (bdec);
+  if (pool_pre == NULL)
+    return FALSE;
+
+  config = gst_buffer_pool_get_config (pool_pre);
+  gst_buffer_pool_config_get_params (config, &caps, &size_pre, &min_buffers,
+                &max_buffers);
+
+  info = *vinfo;
+  gst_video_info_align (&info, &GST_VPU_DEC_VIDEO_ALIGNMENT (vpu_dec_object));
+  size = MAX (GST_VIDEO_INFO_SIZE (&info), vpu_dec_object->frame_size);
+  count = min + GST_VPU_DEC_MIN_BUF_CNT (vpu_dec_object) \
+        + GST_VPU_DEC_FRAMES_PLUS (vpu_dec_object);
+  if (vpu_dec_object->slots.n_slots > 0)
+    outstanding = vpu_dec_object->slots.n_slots \
+      - GST_VPU_DEC_SLOTS_IN_VPU (&vpu_dec_object->slots);
+  else
+    outstanding = vpu_dec_object->pool_outstanding;
+
+  if (caps && gst_video_info_from_caps (&info_pre, caps)
+      && GST_VIDEO_INFO_FORMAT (&info_pre) == GST_VIDEO_INFO_FORMAT (vinfo)
+      && size_pre >= size
+      && max_buffers >= count + outstanding) {
+    GST_INFO_OBJECT (dec, "reuse buffer pool of %d buffers size %d for %dx%d\n",
+        max_buffers, size_pre, GST_VIDEO_INFO_WIDTH (vinfo),
+        GST_VIDEO_INFO_HEIGHT (vinfo));
+
+    if (update_pool)
+      gst_query_set_nth_allocation_pool (query, 0, pool_pre, size_pre, \
+          min_buffers, max_buffers);
+    else
+      gst_query_add_allocation_pool (query, pool_pre, size_pre, min_buffers, \
+          max_buffers);
+
+    GST_VPU_DEC_ACTUAL_BUF_CNT (vpu_dec_object) = count;
+    vpu_dec_object->pool_reused = TRUE;
+    /* padding is the one of the new geometry, not of the pool config */
+    vpu_dec_object->pool_alignment_checked = TRUE;
+    reuse = TRUE;
+  }
+
+  gst_structure_free (config);
+  gst_object_unref (pool_pre);
+
+  return reuse;
+}
+
 static gboolean
 gst_vpu_dec_decide_allocation (GstVideoDecoder * bdec, GstQuery * query)
 {
@@ -520,6 +654,19 @@ gst_vpu_dec_decide_allocation (GstVideoDecoder * bdec, GstQuery * query)
     gst_object_unref (pool_pre);
   }
 
+  dec->vpu_dec_object->pool_reused = FALSE;
+  if (dec->vpu_dec_object->vpu_need_reconfig
+    && dec->vpu_dec_object->use_my_pool
+    && dec->vpu_dec_object->use_my_allocator
+    && gst_vpu_dec_reuse_pool (dec, bdec, query, &vinfo, min, update_pool)) {
+    if (allocator)
+      gst_object_unref (allocator);
+    if (pool)
+      gst_object_unref (pool);
+
+    return TRUE;
+  }
+
   if (GST_VPU_DEC_USE_VPU_MEMORY (dec->vpu_dec_object)) {
     if (allocator)
       gst_object_unref (allocator);
@@ -634,9 +781,20 @@ gst_vpu_dec_reset (GstVideoDecoder * bdec, gboolean hard)
   GstVpuDec *dec = (GstVpuDec *) bdec;
 
   if (hard) {
+    gst_vpu_dec_object_async_stop (dec->vpu_dec_object, bdec, TRUE, TRUE);
     return gst_vpu_dec_object_flush (bdec, dec->vpu_dec_object);
   } else {
     return TRUE;
   }
 }
 
+static gboolean
+gst_vpu_dec_src_event (GstVideoDecoder * bdec, GstEvent * event)
+{
+  GstVpuDec *dec = (GstVpuDec *) bdec;
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_LATENCY)
+    gst_vpu_dec_object_latency_changed (dec->vpu_dec_object);
+
+  return GST_VIDEO_DECODER_CLASS (parent_class)->src_event (bdec, event);
+}
@@ -37,6 +37,9 @@ GST_DEBUG_CATEGORY_STATIC(vpu_dec_object_debug);
 #define VPUDEC_TS_BUFFER_LENGTH_DEFAULT (1024)
 #define MAX_BUFFERED_DURATION_IN_VPU (3*1000000000ll)
 #define MAX_BUFFERED_COUNT_IN_VPU (100)
+/* decode-ahead queues, output holds frames which own framebuffers */
+#define ASYNC_INPUT_MAX (MAX_BUFFERED_COUNT_IN_VPU)
+#define ASYNC_OUTPUT_MAX(o) (MAX ((o)->frame_plus, 1))
 #define MASAIC_THRESHOLD (30)
 //FIXME: relate with frame plus?
 #define DROP_RESUME (200 * GST_MSECOND)
@@ -227,12 +230,29 @@ gst_vpu_dec_object_init(GstVpuDecObject *vpu_dec_object)
   vpu_dec_object->vpu_internal_mem.internal_virt_mem = NULL;
   vpu_dec_object->vpu_internal_mem.internal_phy_mem = NULL;
   vpu_dec_object->mv_mem = NULL;
+  vpu_dec_object->mv_mem_size = 0;
   vpu_dec_object->gstbuffer_in_vpudec = NULL;
-  vpu_dec_object->gstbuffer_in_vpudec2 = NULL;
-  vpu_dec_object->system_frame_number_in_vpu = NULL;
+  vpu_dec_object->spare_buffers = NULL;
+  vpu_dec_object->pool_reused = FALSE;
+  vpu_dec_object->pool_outstanding = 0;
+  gst_vpu_dec_slots_init (&vpu_dec_object->slots);
+  gst_vpu_dec_stats_reset (&vpu_dec_object->stats);
+  vpu_dec_object->stats_posted = 0;
   vpu_dec_object->dropping = FALSE;
   vpu_dec_object->vpu_report_resolution_change = FALSE; 
   vpu_dec_object->vpu_need_reconfig = FALSE;
+  vpu_dec_object->async_active = FALSE;
+  vpu_dec_object->async_bdec = NULL;
+  vpu_dec_object->async_decode_thread = NULL;
+  vpu_dec_object->async_push_thread = NULL;
+  g_mutex_init (&vpu_dec_object->async_lock);
+  g_cond_init (&vpu_dec_object->async_cond);
+  g_queue_init (&vpu_dec_object->async_input);
+  g_queue_init (&vpu_dec_object->async_output);
+  vpu_dec_object->async_decoding = FALSE;
+  vpu_dec_object->async_stop = FALSE;
+  vpu_dec_object->async_ret = GST_FLOW_OK;
+  vpu_dec_object->async_reconfigure = FALSE;
 }
 
 static void 
@@ -242,6 +262,9 @@ gst_vpu_dec_object_finalize(GObject *object)
 
 	GST_DEBUG_OBJECT(dec_object, "freeing memory");
 
+  g_mutex_clear (&dec_object->async_lock);
+  g_cond_clear (&dec_object->async_cond);
+
 	G_OBJECT_CLASS(gst_vpu_dec_object_parent_class)->finalize(object);
 }
 
@@ -350,24 +373,50 @@ gst_vpu_dec_object_start (GstVpuDecObject * vpu_dec_object)
     return FALSE;
   }
 
-  vpu_dec_object->frame2gstbuffer_table = g_hash_table_new(NULL, NULL);
-  vpu_dec_object->gstbuffer2frame_table = g_hash_table_new(NULL, NULL);
   vpu_dec_object->total_frames = 0;
   vpu_dec_object->total_time = 0;
   vpu_dec_object->vpu_hold_buffer = 0;
+  vpu_dec_object->is_live_valid = FALSE;
+  vpu_dec_object->mv_mem_reused = 0;
+  vpu_dec_object->mv_mem_allocated = 0;
+  GST_OBJECT_LOCK (vpu_dec_object);
+  vpu_dec_object->reconfig_count = 0;
+  vpu_dec_object->reconfig_pool_reused = 0;
+  vpu_dec_object->reconfig_time_last = 0;
+  vpu_dec_object->reconfig_time_max = 0;
+  vpu_dec_object->reconfig_time_total = 0;
+  vpu_dec_object->latency_queries = 0;
+  vpu_dec_object->latency_queries_avoided = 0;
+  gst_vpu_dec_stats_reset (&vpu_dec_object->stats);
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+  vpu_dec_object->stats_posted = g_get_monotonic_time ();
 
   vpu_dec_object->state = STATE_ALLOCATED_INTERNAL_BUFFER;
 
   return TRUE;
 }
 
-static gboolean
-gst_vpu_dec_object_free_mv_buffer (GstVpuDecObject * vpu_dec_object)
+static void
+gst_vpu_dec_object_free_spare_buffers (GstVpuDecObject * vpu_dec_object)
+{
+  g_list_foreach (vpu_dec_object->spare_buffers, (GFunc) gst_buffer_unref, NULL);
+  g_list_free (vpu_dec_object->spare_buffers);
+  vpu_dec_object->spare_buffers = NULL;
+}
+
+static void
+gst_vpu_dec_object_release_mv_mem (GstVpuDecObject * vpu_dec_object)
 {
   g_list_foreach (vpu_dec_object->mv_mem, (GFunc) gst_memory_unref, NULL);
   g_list_free (vpu_dec_object->mv_mem);
   vpu_dec_object->mv_mem = NULL;
+  vpu_dec_object->mv_mem_size = 0;
+}
 
+/* mv memory stays for the next registration, see allocate_mv_buffer */
+static gboolean
+gst_vpu_dec_object_free_mv_buffer (GstVpuDecObject * vpu_dec_object)
+{
   if (vpu_dec_object->vpuframebuffers != NULL) {
     g_free(vpu_dec_object->vpuframebuffers);
     vpu_dec_object->vpuframebuffers = NULL;
@@ -382,6 +431,7 @@ gst_vpu_dec_object_allocate_mv_buffer (GstVpuDecObject * vpu_dec_object)
   VpuFrameBuffer *vpu_frame;
   GstMemory * gst_memory;
   PhyMemBlock *memory;
+  GList *l;
   gint size;
   guint i;
 
@@ -395,10 +445,31 @@ gst_vpu_dec_object_allocate_mv_buffer (GstVpuDecObject * vpu_dec_object)
       * vpu_dec_object->actual_buf_cnt);
 
   if (!IS_HANTRO()) {
+    /* blocks of an earlier geometry are reused when they are big enough,
+     * only missing ones are allocated */
+    size = vpu_dec_object->width_paded * vpu_dec_object->height_paded / 4;
+    if (size > vpu_dec_object->mv_mem_size) {
+      gst_vpu_dec_object_release_mv_mem (vpu_dec_object);
+      vpu_dec_object->mv_mem_size = size;
+    }
+
+    l = vpu_dec_object->mv_mem;
     for (i=0; i<vpu_dec_object->actual_buf_cnt; i++) {
       vpu_frame = &vpu_dec_object->vpuframebuffers[i];
-      size = vpu_dec_object->width_paded * vpu_dec_object->height_paded / 4;
-      gst_memory = gst_allocator_alloc (gst_vpu_allocator_obtain(), size, NULL);
+      if (l) {
+        gst_memory = l->data;
+        l = l->next;
+        vpu_dec_object->mv_mem_reused ++;
+      } else {
+        gst_memory = gst_allocator_alloc (gst_vpu_allocator_obtain(), \
+            vpu_dec_object->mv_mem_size, NULL);
+        if (gst_memory == NULL) {
+          GST_ERROR_OBJECT (vpu_dec_object, "Could not allocate memory using VPU allocator");
+          return FALSE;
+        }
+        vpu_dec_object->mv_mem = g_list_append (vpu_dec_object->mv_mem, gst_memory);
+        vpu_dec_object->mv_mem_allocated ++;
+      }
       memory = gst_memory_query_phymem_block (gst_memory);
       if (memory == NULL) {
         GST_ERROR_OBJECT (vpu_dec_object, "Could not allocate memory using VPU allocator");
@@ -407,7 +478,6 @@ gst_vpu_dec_object_allocate_mv_buffer (GstVpuDecObject * vpu_dec_object)
 
       vpu_frame->pbufMvCol = memory->paddr;
       vpu_frame->pbufVirtMvCol = memory->vaddr;
-      vpu_dec_object->mv_mem = g_list_append (vpu_dec_object->mv_mem, gst_memory);
     }
   }
 
@@ -422,31 +492,19 @@ gst_vpu_dec_object_stop (GstVpuDecObject * vpu_dec_object)
   GST_INFO_OBJECT(vpu_dec_object, "Video decoder frames: %lld time: %lld fps: (%.3f).\n",
       vpu_dec_object->total_frames, vpu_dec_object->total_time, (gfloat)1000000
       * vpu_dec_object->total_frames / vpu_dec_object->total_time);
+  GST_INFO_OBJECT(vpu_dec_object, "Framebuffer reconfigs: %d pool reused: %d time total: %lld max: %lld mv memory reused: %d allocated: %d.\n",
+      vpu_dec_object->reconfig_count, vpu_dec_object->reconfig_pool_reused,
+      vpu_dec_object->reconfig_time_total, vpu_dec_object->reconfig_time_max,
+      vpu_dec_object->mv_mem_reused, vpu_dec_object->mv_mem_allocated);
+  GST_INFO_OBJECT(vpu_dec_object, "Latency queries: %lld avoided: %lld.\n",
+      vpu_dec_object->latency_queries, vpu_dec_object->latency_queries_avoided);
   if (vpu_dec_object->gstbuffer_in_vpudec != NULL) {
     g_list_foreach (vpu_dec_object->gstbuffer_in_vpudec, (GFunc) gst_buffer_unref, NULL);
     g_list_free (vpu_dec_object->gstbuffer_in_vpudec);
     vpu_dec_object->gstbuffer_in_vpudec = NULL;
   }
 
-  if (vpu_dec_object->gstbuffer_in_vpudec2 != NULL) {
-    g_list_free (vpu_dec_object->gstbuffer_in_vpudec2);
-    vpu_dec_object->gstbuffer_in_vpudec2 = NULL;
-  }
-
-  if (vpu_dec_object->system_frame_number_in_vpu != NULL) {
-    g_list_free (vpu_dec_object->system_frame_number_in_vpu);
-    vpu_dec_object->system_frame_number_in_vpu = NULL;
-  }
-
-	if (vpu_dec_object->frame2gstbuffer_table != NULL) {
-		g_hash_table_destroy(vpu_dec_object->frame2gstbuffer_table);
-		vpu_dec_object->frame2gstbuffer_table = NULL;
-	}
-
-	if (vpu_dec_object->gstbuffer2frame_table != NULL) {
-		g_hash_table_destroy(vpu_dec_object->gstbuffer2frame_table);
-		vpu_dec_object->gstbuffer2frame_table = NULL;
-	}
+  gst_vpu_dec_slots_free (&vpu_dec_object->slots);
 
   if (vpu_dec_object->tsm) {
     destroyTSManager (vpu_dec_object->tsm);
@@ -467,6 +525,8 @@ gst_vpu_dec_object_stop (GstVpuDecObject * vpu_dec_object)
     GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_free_mv_buffer fail");
     return FALSE;
   }
+  gst_vpu_dec_object_release_mv_mem (vpu_dec_object);
+  gst_vpu_dec_object_free_spare_buffers (vpu_dec_object);
 
   if (!gst_vpu_free_internal_mem (&(vpu_dec_object->vpu_internal_mem))) {
     GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_free_internal_mem fail");
@@ -663,9 +723,8 @@ gst_vpu_dec_object_config (GstVpuDecObject * vpu_dec_object, \
     vpu_dec_object->handle = NULL;
 
     vpu_dec_object->new_segment = TRUE;
-    g_list_free (vpu_dec_object->system_frame_number_in_vpu);
-    vpu_dec_object->system_frame_number_in_vpu = NULL;
-    GST_DEBUG_OBJECT (vpu_dec_object, "system_frame_number_in_vpu list free\n");
+    gst_vpu_dec_slots_clear_numbers (&vpu_dec_object->slots);
+    GST_DEBUG_OBJECT (vpu_dec_object, "system frame numbers in vpu cleared\n");
 
     if (!gst_vpu_dec_object_free_mv_buffer(vpu_dec_object)) {
       GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_free_mv_buffer fail");
@@ -677,10 +736,14 @@ gst_vpu_dec_object_config (GstVpuDecObject * vpu_dec_object, \
 
   g_list_foreach (vpu_dec_object->gstbuffer_in_vpudec, (GFunc) gst_buffer_unref, NULL);
   g_list_free (vpu_dec_object->gstbuffer_in_vpudec);
-  g_list_free (vpu_dec_object->gstbuffer_in_vpudec2);
   vpu_dec_object->gstbuffer_in_vpudec = NULL;
-  vpu_dec_object->gstbuffer_in_vpudec2 = NULL;
-  GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer_in_vpudec list free\n");
+  /* buffers downstream still holds, for deciding on pool reuse later */
+  if (vpu_dec_object->slots.n_slots > 0)
+    vpu_dec_object->pool_outstanding = vpu_dec_object->slots.n_slots \
+      - GST_VPU_DEC_SLOTS_IN_VPU (&vpu_dec_object->slots);
+  gst_vpu_dec_slots_reset (&vpu_dec_object->slots);
+  gst_vpu_dec_object_free_spare_buffers (vpu_dec_object);
+  GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer in vpudec free\n");
 
   if (vpu_dec_object->state < STATE_OPENED) {
     if (!gst_vpu_dec_object_open_vpu(vpu_dec_object, bdec, state)) {
@@ -698,28 +761,30 @@ gst_vpu_dec_object_register_frame_buffer (GstVpuDecObject * vpu_dec_object, \
 {
 	VpuDecRetCode dec_ret;
   GstBuffer *buffer;
+  GList *l;
   guint i;
 
-  g_hash_table_remove_all (vpu_dec_object->frame2gstbuffer_table);
-  g_hash_table_remove_all (vpu_dec_object->gstbuffer2frame_table);
-
   if (!gst_vpu_register_frame_buffer (vpu_dec_object->gstbuffer_in_vpudec, \
     &vpu_dec_object->output_state->info, vpu_dec_object->vpuframebuffers)) {
       GST_ERROR_OBJECT (vpu_dec_object, "gst_vpu_register_frame_buffer fail.\n");
       return FALSE;
   }
 
-  for (i=0; i<vpu_dec_object->actual_buf_cnt; i++) {
-    buffer = g_list_nth_data (vpu_dec_object->gstbuffer_in_vpudec, i);
+  /* slots take over the buffer refs of the list */
+  gst_vpu_dec_slots_register (&vpu_dec_object->slots, \
+      vpu_dec_object->actual_buf_cnt);
+  for (i=0, l=vpu_dec_object->gstbuffer_in_vpudec; \
+      i<vpu_dec_object->actual_buf_cnt && l; i++, l=l->next) {
+    buffer = l->data;
 
-    g_hash_table_replace(vpu_dec_object->frame2gstbuffer_table, \
-        (gpointer)(vpu_dec_object->vpuframebuffers[i].pbufVirtY), (gpointer)(buffer));
-    g_hash_table_replace(vpu_dec_object->gstbuffer2frame_table, \
-        (gpointer)(buffer), \
-        (gpointer)(&(vpu_dec_object->vpuframebuffers[i])));
+    gst_vpu_dec_slots_set (&vpu_dec_object->slots, i, buffer, \
+        &(vpu_dec_object->vpuframebuffers[i]), \
+        vpu_dec_object->vpuframebuffers[i].pbufVirtY);
     GST_DEBUG_OBJECT (vpu_dec_object, "VpuFrameBuffer: 0x%x VpuFrameBuffer pbufVirtY: 0x%x GstBuffer: 0x%x\n", \
         vpu_dec_object->vpuframebuffers[i], vpu_dec_object->vpuframebuffers[i].pbufVirtY, buffer);
   }
+  g_list_free (vpu_dec_object->gstbuffer_in_vpudec);
+  vpu_dec_object->gstbuffer_in_vpudec = NULL;
 
   if (!IS_AMPHION()) {
     dec_ret = VPU_DecRegisterFrameBuffer (vpu_dec_object->handle, \
@@ -737,6 +802,192 @@ gst_vpu_dec_object_register_frame_buffer (GstVpuDecObject * vpu_dec_object, \
   return TRUE;
 }
 
+typedef struct
+{
+  GstVideoCodecFrame *frame;
+  gboolean drop;
+} GstVpuDecOutputFrame;
+
+static inline gboolean
+gst_vpu_dec_object_in_decode_thread (GstVpuDecObject * vpu_dec_object)
+{
+  return vpu_dec_object->async_decode_thread != NULL
+    && g_thread_self () == vpu_dec_object->async_decode_thread;
+}
+
+/* The decode thread waits for the push thread without the stream lock,
+ * the push thread needs it to finish frames. */
+static void
+gst_vpu_dec_object_async_wait_output (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec, guint max)
+{
+  if (!gst_vpu_dec_object_in_decode_thread (vpu_dec_object))
+    return;
+
+  GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  while (g_queue_get_length (&vpu_dec_object->async_output) > max
+      && !vpu_dec_object->async_stop)
+    g_cond_wait (&vpu_dec_object->async_cond, &vpu_dec_object->async_lock);
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+  GST_VIDEO_DECODER_STREAM_LOCK (bdec);
+}
+
+/* Caps and allocation are renegotiated here on the decode thread, which
+ * owns the VPU framebuffers, once the frames queued before are pushed.
+ * The push thread only finishes frames. */
+static GstFlowReturn
+gst_vpu_dec_object_async_negotiate (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec)
+{
+  GstPad *srcpad = GST_VIDEO_DECODER_SRC_PAD (bdec);
+  gboolean reconfigure;
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  reconfigure = vpu_dec_object->async_reconfigure;
+  vpu_dec_object->async_reconfigure = FALSE;
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  if (!gst_pad_check_reconfigure (srcpad) && !reconfigure)
+    return GST_FLOW_OK;
+
+  gst_vpu_dec_object_async_wait_output (vpu_dec_object, bdec, 0);
+  if (gst_video_decoder_negotiate (bdec))
+    return GST_FLOW_OK;
+
+  gst_pad_mark_reconfigure (srcpad);
+  return GST_PAD_IS_FLUSHING (srcpad) ? GST_FLOW_FLUSHING \
+    : GST_FLOW_NOT_NEGOTIATED;
+}
+
+static GstFlowReturn
+gst_vpu_dec_object_finish_frame (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec, GstVideoCodecFrame * frame, gboolean drop)
+{
+  GstVpuDecOutputFrame *out;
+  GstFlowReturn ret;
+
+  if (!gst_vpu_dec_object_in_decode_thread (vpu_dec_object)) {
+    if (drop)
+      return gst_video_decoder_drop_frame (bdec, frame);
+    return gst_video_decoder_finish_frame (bdec, frame);
+  }
+
+  if (!drop) {
+    ret = gst_vpu_dec_object_async_negotiate (vpu_dec_object, bdec);
+    if (ret != GST_FLOW_OK) {
+      gst_video_decoder_release_frame (bdec, frame);
+      return ret;
+    }
+  }
+
+  gst_vpu_dec_object_async_wait_output (vpu_dec_object, bdec, \
+      ASYNC_OUTPUT_MAX (vpu_dec_object) - 1);
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  if (vpu_dec_object->async_stop) {
+    g_mutex_unlock (&vpu_dec_object->async_lock);
+    gst_video_codec_frame_unref (frame);
+    return GST_FLOW_FLUSHING;
+  }
+  out = g_new (GstVpuDecOutputFrame, 1);
+  out->frame = frame;
+  out->drop = drop;
+  g_queue_push_tail (&vpu_dec_object->async_output, out);
+  ret = vpu_dec_object->async_ret;
+  g_cond_broadcast (&vpu_dec_object->async_cond);
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  return ret;
+}
+
+/* lays a buffer of a reused pool out for the current geometry */
+static gboolean
+gst_vpu_dec_object_update_video_meta (GstVpuDecObject * vpu_dec_object, \
+    GstBuffer * buffer)
+{
+  GstVideoInfo info = vpu_dec_object->output_state->info;
+  GstVideoMeta *vmeta;
+  guint i;
+
+  if (!gst_video_info_align (&info, &vpu_dec_object->video_align))
+    return FALSE;
+
+  vmeta = gst_buffer_get_video_meta (buffer);
+  if (vmeta == NULL)
+    return FALSE;
+
+  vmeta->format = GST_VIDEO_INFO_FORMAT (&info);
+  vmeta->width = GST_VIDEO_INFO_WIDTH (&info);
+  vmeta->height = GST_VIDEO_INFO_HEIGHT (&info);
+  vmeta->n_planes = GST_VIDEO_INFO_N_PLANES (&info);
+  for (i = 0; i < GST_VIDEO_MAX_PLANES; i++) {
+    vmeta->offset[i] = GST_VIDEO_INFO_PLANE_OFFSET (&info, i);
+    vmeta->stride[i] = GST_VIDEO_INFO_PLANE_STRIDE (&info, i);
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_vpu_dec_object_fill_frame_buffer (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec)
+{
+  GstBuffer *buffer;
+  GList *l;
+
+  if (vpu_dec_object->pool_reused) {
+    /* the pool fits the new geometry, register the buffers the VPU and
+     * the spare list hold again and take only the rest from the pool */
+    vpu_dec_object->gstbuffer_in_vpudec = gst_vpu_dec_slots_steal ( \
+        &vpu_dec_object->slots, vpu_dec_object->gstbuffer_in_vpudec);
+    vpu_dec_object->gstbuffer_in_vpudec = g_list_concat ( \
+        vpu_dec_object->gstbuffer_in_vpudec, vpu_dec_object->spare_buffers);
+    vpu_dec_object->spare_buffers = NULL;
+    GST_DEBUG_OBJECT (vpu_dec_object, "reuse %d gstbuffer of previous pool\n", \
+        g_list_length (vpu_dec_object->gstbuffer_in_vpudec));
+  }
+
+  while (g_list_length (vpu_dec_object->gstbuffer_in_vpudec) \
+          < vpu_dec_object->actual_buf_cnt) {
+    GST_DEBUG_OBJECT (vpu_dec_object, "gst_video_decoder_allocate_output_buffer before");
+    buffer = gst_video_decoder_allocate_output_buffer(bdec);
+    if (buffer == NULL) {
+      GST_ERROR_OBJECT (vpu_dec_object, "could not allocate output buffer");
+      return GST_FLOW_ERROR;
+    }
+    vpu_dec_object->gstbuffer_in_vpudec = g_list_append ( \
+        vpu_dec_object->gstbuffer_in_vpudec, buffer);
+    GST_DEBUG_OBJECT (vpu_dec_object, "gst_video_decoder_allocate_output_buffer end");
+    GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer get from buffer pool: %x\n", buffer);
+    GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer_in_vpudec list length: %d actual_buf_cnt: %d \n", \
+        g_list_length (vpu_dec_object->gstbuffer_in_vpudec), vpu_dec_object->actual_buf_cnt);
+  }
+
+  if (!vpu_dec_object->pool_reused)
+    return GST_FLOW_OK;
+
+  /* more than the new DPB needs stay out of circulation */
+  while (g_list_length (vpu_dec_object->gstbuffer_in_vpudec) \
+          > vpu_dec_object->actual_buf_cnt) {
+    l = g_list_last (vpu_dec_object->gstbuffer_in_vpudec);
+    vpu_dec_object->spare_buffers = g_list_prepend ( \
+        vpu_dec_object->spare_buffers, l->data);
+    vpu_dec_object->gstbuffer_in_vpudec = g_list_delete_link ( \
+        vpu_dec_object->gstbuffer_in_vpudec, l);
+  }
+
+  for (l = vpu_dec_object->gstbuffer_in_vpudec; l; l = l->next) {
+    if (!gst_vpu_dec_object_update_video_meta (vpu_dec_object, l->data)) {
+      GST_ERROR_OBJECT (vpu_dec_object, "could not update video meta of gstbuffer: %x\n", \
+          l->data);
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  return GST_FLOW_OK;
+}
+
 static GstFlowReturn
 gst_vpu_dec_object_handle_reconfig(GstVpuDecObject * vpu_dec_object, \
     GstVideoDecoder * bdec)
@@ -744,11 +995,16 @@ gst_vpu_dec_object_handle_reconfig(GstVpuDecObject * vpu_dec_object, \
   VpuDecRetCode dec_ret;
   GstVideoCodecState *state;
   GstVideoFormat fmt;
+  GstFlowReturn ret;
   gint height_align;
   gint width_align;
-  GstBuffer *buffer;
+  gint64 start_time;
   guint i;
 
+  start_time = g_get_monotonic_time ();
+  /* negotiation and the new framebuffers need the pushed frames back */
+  gst_vpu_dec_object_async_wait_output (vpu_dec_object, bdec, 0);
+
   dec_ret = VPU_DecGetInitialInfo(vpu_dec_object->handle, &(vpu_dec_object->init_info));
   if (dec_ret != VPU_DEC_RET_SUCCESS) {
     GST_ERROR_OBJECT(vpu_dec_object, "could not get init info: %s", \
@@ -873,18 +1129,16 @@ gst_vpu_dec_object_handle_reconfig(GstVpuDecObject * vpu_dec_object, \
   }
 #endif
 
-  while (g_list_length (vpu_dec_object->gstbuffer_in_vpudec) \
-          < vpu_dec_object->actual_buf_cnt) {
-    GST_DEBUG_OBJECT (vpu_dec_object, "gst_video_decoder_allocate_output_buffer before");
-    buffer = gst_video_decoder_allocate_output_buffer(bdec);
-    vpu_dec_object->gstbuffer_in_vpudec = g_list_append ( \
-        vpu_dec_object->gstbuffer_in_vpudec, buffer);
-    vpu_dec_object->gstbuffer_in_vpudec2 = g_list_append ( \
-        vpu_dec_object->gstbuffer_in_vpudec2, buffer);
-    GST_DEBUG_OBJECT (vpu_dec_object, "gst_video_decoder_allocate_output_buffer end");
-    GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer get from buffer pool: %x\n", buffer);
-    GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer_in_vpudec list length: %d actual_buf_cnt: %d \n", \
-        g_list_length (vpu_dec_object->gstbuffer_in_vpudec), vpu_dec_object->actual_buf_cnt);
+  ret = gst_vpu_dec_object_fill_frame_buffer (vpu_dec_object, bdec);
+  if (vpu_dec_object->pool_reused) {
+    GST_OBJECT_LOCK (vpu_dec_object);
+    vpu_dec_object->reconfig_pool_reused ++;
+    GST_OBJECT_UNLOCK (vpu_dec_object);
+  }
+  vpu_dec_object->pool_reused = FALSE;
+  if (ret != GST_FLOW_OK) {
+    GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_fill_frame_buffer fail");
+    return ret;
   }
 
   if (!gst_vpu_dec_object_free_mv_buffer(vpu_dec_object)) {
@@ -913,21 +1167,82 @@ gst_vpu_dec_object_handle_reconfig(GstVpuDecObject * vpu_dec_object, \
     return GST_FLOW_ERROR;
   }
 
+  /* read by get_stats from the application thread */
+  GST_OBJECT_LOCK (vpu_dec_object);
+  vpu_dec_object->reconfig_time_last = g_get_monotonic_time () - start_time;
+  vpu_dec_object->reconfig_time_total += vpu_dec_object->reconfig_time_last;
+  vpu_dec_object->reconfig_time_max = MAX (vpu_dec_object->reconfig_time_max, \
+      vpu_dec_object->reconfig_time_last);
+  vpu_dec_object->reconfig_count ++;
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+  GST_INFO_OBJECT (vpu_dec_object, "framebuffer reconfig %d to %dx%d took %lld us\n", \
+      vpu_dec_object->reconfig_count, vpu_dec_object->init_info.nPicWidth, \
+      vpu_dec_object->init_info.nPicHeight, vpu_dec_object->reconfig_time_last);
+
   return GST_FLOW_OK;
 }
 
+gboolean
+gst_vpu_dec_object_is_live (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec)
+{
+  GstQuery *query;
+  gboolean is_live = FALSE;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  if (vpu_dec_object->is_live_valid
+      && (vpu_dec_object->latency_refresh == 0
+        || now - vpu_dec_object->is_live_checked
+          < (gint64) vpu_dec_object->latency_refresh * 1000)) {
+    GST_OBJECT_LOCK (vpu_dec_object);
+    vpu_dec_object->latency_queries_avoided ++;
+    GST_OBJECT_UNLOCK (vpu_dec_object);
+    return vpu_dec_object->is_live;
+  }
+
+  query = gst_query_new_latency ();
+  if (gst_pad_peer_query (GST_VIDEO_DECODER_SINK_PAD (bdec), query)) {
+    gst_query_parse_latency (query, &is_live, NULL, NULL);
+  }
+  gst_query_unref (query);
+  GST_OBJECT_LOCK (vpu_dec_object);
+  vpu_dec_object->latency_queries ++;
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+
+  vpu_dec_object->is_live = is_live;
+  vpu_dec_object->is_live_checked = now;
+  vpu_dec_object->is_live_valid = TRUE;
+
+  return is_live;
+}
+
+void
+gst_vpu_dec_object_latency_changed (GstVpuDecObject * vpu_dec_object)
+{
+  GST_DEBUG_OBJECT (vpu_dec_object, "latency changed, query peer again");
+  vpu_dec_object->is_live_valid = FALSE;
+}
+
 static gboolean
 gst_vpu_dec_object_release_frame_buffer_to_vpu (GstVpuDecObject * vpu_dec_object, \
     GstBuffer *buffer)
 {
   VpuDecRetCode dec_ret;
   VpuFrameBuffer * frame_buffer;
+  gint index;
 
-  vpu_dec_object->gstbuffer_in_vpudec = g_list_append ( \
-      vpu_dec_object->gstbuffer_in_vpudec, buffer);
-  frame_buffer = g_hash_table_lookup(vpu_dec_object->gstbuffer2frame_table, buffer);
-  GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer_in_vpudec list length: %d\n", \
-      g_list_length (vpu_dec_object->gstbuffer_in_vpudec));
+  index = gst_vpu_dec_slots_find_buffer (&vpu_dec_object->slots, buffer);
+  if (index < 0) {
+    GST_ERROR_OBJECT(vpu_dec_object, "GstBuffer: 0x%x isn't registered to VPU", \
+        buffer);
+    gst_buffer_unref (buffer);
+    return FALSE;
+  }
+  gst_vpu_dec_slots_give (&vpu_dec_object->slots, index);
+  frame_buffer = vpu_dec_object->slots.slots[index].frame;
+  GST_DEBUG_OBJECT (vpu_dec_object, "gstbuffer in vpudec: %d\n", \
+      GST_VPU_DEC_SLOTS_IN_VPU (&vpu_dec_object->slots));
 
   GST_LOG_OBJECT (vpu_dec_object, "GstBuffer: 0x%x VpuFrameBuffer: 0x%x\n", \
       buffer, frame_buffer);
@@ -981,9 +1296,47 @@ gst_vpu_dec_object_process_qos (GstVpuDecObject * vpu_dec_object, \
   return TRUE;
 }
 
+static void
+gst_vpu_dec_object_stamp_input (GstVpuDecObject * vpu_dec_object, \
+    GstVideoCodecFrame * frame)
+{
+  GST_OBJECT_LOCK (vpu_dec_object);
+  gst_vpu_dec_stats_stamp_input (&vpu_dec_object->stats, \
+      frame->system_frame_number, g_get_monotonic_time ());
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+}
+
+static void
+gst_vpu_dec_object_post_stats (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec)
+{
+  gint64 now;
+
+  if (vpu_dec_object->stats_interval == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (now - vpu_dec_object->stats_posted \
+      < (gint64) vpu_dec_object->stats_interval * 1000)
+    return;
+  vpu_dec_object->stats_posted = now;
+
+  gst_element_post_message (GST_ELEMENT_CAST (bdec), \
+      gst_message_new_element (GST_OBJECT_CAST (bdec), \
+          gst_vpu_dec_object_get_stats (vpu_dec_object)));
+}
+
+/* why the frame the VPU outputs is not shown */
+typedef enum
+{
+  GST_VPU_DEC_DROP_NONE,
+  GST_VPU_DEC_DROP_DECODER,
+  GST_VPU_DEC_DROP_QOS
+} GstVpuDecDropReason;
+
 static GstFlowReturn
 gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
-    GstVideoDecoder * bdec, gboolean drop)
+    GstVideoDecoder * bdec, GstVpuDecDropReason drop)
 {
   GstFlowReturn ret = GST_FLOW_OK;
   VpuDecRetCode dec_ret;
@@ -994,10 +1347,11 @@ gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
   GstPhyMemMeta *pmeta;
   GstBuffer *output_buffer = NULL;
   GstClockTime output_pts = 0;
-  gint frame_number;
+  guint32 frame_number;
+  gint index;
   GstClockTime latency;
-  GstQuery *query;
-  gboolean is_live = FALSE;
+  gint64 age;
+  gboolean is_live;
 #if 0
   GList *l;
 
@@ -1011,23 +1365,24 @@ gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
   g_list_free (l);
 #endif
 
-  frame_number = g_list_nth_data (vpu_dec_object->system_frame_number_in_vpu, 0);
+  GST_OBJECT_LOCK (vpu_dec_object);
+  gst_vpu_dec_stats_add_occupancy (&vpu_dec_object->stats, \
+      vpu_dec_object->slots.n_slots, \
+      GST_VPU_DEC_SLOTS_IN_VPU (&vpu_dec_object->slots), \
+      GST_VPU_DEC_SLOTS_N_NUMBERS (&vpu_dec_object->slots));
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+
+  gst_vpu_dec_slots_pop_number (&vpu_dec_object->slots, &frame_number);
   GST_DEBUG_OBJECT(vpu_dec_object, "system frame number send out: %d list length: %d \n", \
-      frame_number, g_list_length (vpu_dec_object->system_frame_number_in_vpu));
-  vpu_dec_object->system_frame_number_in_vpu = g_list_remove ( \
-      vpu_dec_object->system_frame_number_in_vpu, frame_number);
+      frame_number, GST_VPU_DEC_SLOTS_N_NUMBERS (&vpu_dec_object->slots));
 
   /* Set latency for live-mode */
-  query = gst_query_new_latency ();
-  if (gst_pad_peer_query (GST_VIDEO_DECODER_SINK_PAD (bdec), query)) {
-    gst_query_parse_latency (query, &is_live, NULL, NULL);
-  }
-  gst_query_unref (query);
+  is_live = gst_vpu_dec_object_is_live (vpu_dec_object, bdec);
 
   if (is_live && frame_number == 0 && vpu_dec_object->framerate_d > 0
       && vpu_dec_object->framerate_n > 0) {
     latency = gst_util_uint64_scale_int (GST_SECOND,vpu_dec_object->framerate_d,
-        vpu_dec_object->framerate_n) * g_list_length (vpu_dec_object->system_frame_number_in_vpu);
+        vpu_dec_object->framerate_n) * GST_VPU_DEC_SLOTS_N_NUMBERS (&vpu_dec_object->slots);
     gst_video_decoder_set_latency (bdec, latency, latency);
     GST_DEBUG_OBJECT(vpu_dec_object, "Setting latency: %" GST_TIME_FORMAT, GST_TIME_ARGS (latency));
   }
@@ -1050,14 +1405,12 @@ gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
         out_frame_info.pDisplayFrameBuf, out_frame_info.pDisplayFrameBuf->pbufVirtY);
     output_pts = TSManagerSend2 (vpu_dec_object->tsm, \
         out_frame_info.pDisplayFrameBuf);
-    output_buffer = g_hash_table_lookup( \
-        vpu_dec_object->frame2gstbuffer_table, \
+    index = gst_vpu_dec_slots_find_addr (&vpu_dec_object->slots, \
         out_frame_info.pDisplayFrameBuf->pbufVirtY);
-    g_hash_table_replace(vpu_dec_object->gstbuffer2frame_table, \
-        (gpointer)(output_buffer), \
-        (gpointer)(out_frame_info.pDisplayFrameBuf));
-    vpu_dec_object->gstbuffer_in_vpudec = g_list_remove ( \
-        vpu_dec_object->gstbuffer_in_vpudec, output_buffer);
+    if (index >= 0) {
+      vpu_dec_object->slots.slots[index].frame = out_frame_info.pDisplayFrameBuf;
+      output_buffer = gst_vpu_dec_slots_take (&vpu_dec_object->slots, index);
+    }
   } else {
     output_pts = TSManagerSend (vpu_dec_object->tsm);
   }
@@ -1077,8 +1430,16 @@ gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
 
   if (((vpu_dec_object->mosaic_cnt != 0)
       && (vpu_dec_object->mosaic_cnt < MASAIC_THRESHOLD))
-      || drop == TRUE) {
+      || drop != GST_VPU_DEC_DROP_NONE) {
     GST_INFO_OBJECT(vpu_dec_object, "drop frame.");
+    GST_OBJECT_LOCK (vpu_dec_object);
+    if (drop == GST_VPU_DEC_DROP_QOS)
+      vpu_dec_object->stats.dropped_qos ++;
+    else if (drop == GST_VPU_DEC_DROP_DECODER)
+      vpu_dec_object->stats.dropped_decoder ++;
+    else
+      vpu_dec_object->stats.dropped_mosaic ++;
+    GST_OBJECT_UNLOCK (vpu_dec_object);
     if (output_buffer) {
       if (!gst_vpu_dec_object_release_frame_buffer_to_vpu (vpu_dec_object, output_buffer)) {
         GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_release_frame_buffer_to_vpu fail.");
@@ -1087,7 +1448,7 @@ gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
     }
     if (output_pts)
       out_frame->pts = output_pts;
-    return gst_video_decoder_drop_frame (bdec, out_frame);
+    return gst_vpu_dec_object_finish_frame (vpu_dec_object, bdec, out_frame, TRUE);
   }
 
   if (output_pts)
@@ -1191,7 +1552,16 @@ gst_vpu_dec_object_send_output (GstVpuDecObject * vpu_dec_object, \
   GST_DEBUG_OBJECT (vpu_dec_object, "vpu dec output frame time stamp: %" \
       GST_TIME_FORMAT, GST_TIME_ARGS (out_frame->pts));
 
-  ret = gst_video_decoder_finish_frame (bdec, out_frame);
+  GST_OBJECT_LOCK (vpu_dec_object);
+  vpu_dec_object->stats.frames_out ++;
+  age = gst_vpu_dec_stats_input_age (&vpu_dec_object->stats, \
+      frame_number, g_get_monotonic_time ());
+  if (age >= 0)
+    gst_vpu_dec_stats_add_time (&vpu_dec_object->stats.latency, age);
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+
+  ret = gst_vpu_dec_object_finish_frame (vpu_dec_object, bdec, out_frame, FALSE);
+  gst_vpu_dec_object_post_stats (vpu_dec_object, bdec);
 
   return ret;
 }
@@ -1203,19 +1573,20 @@ gst_vpu_dec_object_get_gst_buffer (GstVideoDecoder * bdec, GstVpuDecObject * vpu
 
   GST_DEBUG_OBJECT (vpu_dec_object, "min_buf_cnt: %d frame_plus: %d actual_buf_cnt: %d",
       vpu_dec_object->min_buf_cnt, vpu_dec_object->frame_plus, vpu_dec_object->actual_buf_cnt);
-  if (g_list_length (vpu_dec_object->gstbuffer_in_vpudec) \
+  if (GST_VPU_DEC_SLOTS_IN_VPU (&vpu_dec_object->slots) \
       < (vpu_dec_object->min_buf_cnt + vpu_dec_object->frame_plus)
       || vpu_dec_object->vpu_hold_buffer > 0) {
     if (vpu_dec_object->vpu_hold_buffer > 0) {
-      buffer = g_list_nth_data (vpu_dec_object->gstbuffer_in_vpudec2, 0);
-      vpu_dec_object->gstbuffer_in_vpudec2 = g_list_remove ( \
-          vpu_dec_object->gstbuffer_in_vpudec2, buffer);
-      vpu_dec_object->gstbuffer_in_vpudec = g_list_remove ( \
-          vpu_dec_object->gstbuffer_in_vpudec, buffer);
+      /* registered buffers are handed out in registration order */
+      buffer = vpu_dec_object->slots.slots[vpu_dec_object->slots.n_slots \
+          - vpu_dec_object->vpu_hold_buffer].buffer;
       vpu_dec_object->vpu_hold_buffer --;
     }
-    else
+    else {
+      /* frames waiting for the push thread may hold the free buffers */
+      gst_vpu_dec_object_async_wait_output (vpu_dec_object, bdec, 0);
       buffer = gst_video_decoder_allocate_output_buffer(bdec);
+    }
     if (G_UNLIKELY (buffer == NULL)) {
       GST_DEBUG_OBJECT (vpu_dec_object, "could not get buffer.");
       return GST_FLOW_FLUSHING;
@@ -1231,6 +1602,13 @@ gst_vpu_dec_object_get_gst_buffer (GstVideoDecoder * bdec, GstVpuDecObject * vpu
       GST_DEBUG_OBJECT(vpu_dec_object, "should set buffer to VPU in wrong state when down stream send reconfigure.");
       return GST_FLOW_OK;
     }
+    if (gst_vpu_dec_slots_find_buffer (&vpu_dec_object->slots, buffer) < 0) {
+      /* downstream held it over a reconfig which reused the pool */
+      GST_DEBUG_OBJECT(vpu_dec_object, "keep unregistered gstbuffer: 0x%x as spare", buffer);
+      vpu_dec_object->spare_buffers = g_list_prepend ( \
+          vpu_dec_object->spare_buffers, buffer);
+      return GST_FLOW_OK;
+    }
     if (!gst_vpu_dec_object_release_frame_buffer_to_vpu (vpu_dec_object, buffer)) {
       GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_release_frame_buffer_to_vpu fail.");
       return GST_FLOW_ERROR;
@@ -1332,8 +1710,8 @@ gst_vpu_dec_object_set_vpu_input_buf (GstVpuDecObject * vpu_dec_object, \
     return TRUE;
   }
 
-  vpu_dec_object->system_frame_number_in_vpu = g_list_append ( \
-      vpu_dec_object->system_frame_number_in_vpu, frame->system_frame_number);
+  gst_vpu_dec_slots_push_number (&vpu_dec_object->slots, \
+      frame->system_frame_number);
   GST_DEBUG_OBJECT (vpu_dec_object, "vpu_dec_object received system_frame_number: %d\n", \
       frame->system_frame_number);
 
@@ -1384,8 +1762,13 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
 	VpuBufferNode in_data = {0};
 	int buf_ret;
   int counter = 0;
+  gint64 decode_time = 0;
+  gboolean decode_time_added = FALSE;
 
   GST_LOG_OBJECT (vpu_dec_object, "GstVideoCodecFrame: 0x%x\n", frame);
+  /* frames of the decode thread were stamped when queued */
+  if (frame && !gst_vpu_dec_object_in_decode_thread (vpu_dec_object))
+    gst_vpu_dec_object_stamp_input (vpu_dec_object, frame);
   gst_vpu_dec_object_handle_input_time_stamp (vpu_dec_object, bdec, frame);
   gst_vpu_dec_object_set_vpu_input_buf (vpu_dec_object, frame, &in_data);
   if (frame)
@@ -1396,13 +1779,18 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
   }
 
   while (1) {
-    gint64 start_time;
+    gint64 start_time, elapsed;
 
     GST_DEBUG_OBJECT (vpu_dec_object, "in data: %d \n", in_data.nSize);
 
+    /* the push thread can push while the VPU decodes */
+    if (gst_vpu_dec_object_in_decode_thread (vpu_dec_object))
+      GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
     start_time = g_get_monotonic_time ();
-
     dec_ret = VPU_DecDecodeBuf(vpu_dec_object->handle, &in_data, &buf_ret);
+    elapsed = g_get_monotonic_time () - start_time;
+    if (gst_vpu_dec_object_in_decode_thread (vpu_dec_object))
+      GST_VIDEO_DECODER_STREAM_LOCK (bdec);
     /* To avoid input data virtual address has chance to be freed by unmap after
     map at once, unmap it after being used. */
     if (frame && (buf_ret & VPU_DEC_INPUT_USED) && (counter == 0)) {
@@ -1418,8 +1806,16 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
     }
 
     GST_DEBUG_OBJECT (vpu_dec_object, "buf status: 0x%x time: %lld\n", \
-        buf_ret, g_get_monotonic_time () - start_time);
-    vpu_dec_object->total_time += g_get_monotonic_time () - start_time;
+        buf_ret, elapsed);
+    vpu_dec_object->total_time += elapsed;
+    decode_time += elapsed;
+    if (frame && (buf_ret & VPU_DEC_INPUT_USED) && !decode_time_added) {
+      GST_OBJECT_LOCK (vpu_dec_object);
+      gst_vpu_dec_stats_add_time (&vpu_dec_object->stats.decode_time, \
+          decode_time);
+      GST_OBJECT_UNLOCK (vpu_dec_object);
+      decode_time_added = TRUE;
+    }
 
     if ((vpu_dec_object->use_new_tsm) && (buf_ret & VPU_DEC_ONE_FRM_CONSUMED)) {
       if (!gst_vpu_dec_object_set_tsm_consumed_len (vpu_dec_object)) {
@@ -1447,7 +1843,8 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
     }
     if (buf_ret & VPU_DEC_OUTPUT_DIS) {
       vpu_dec_object->mosaic_cnt = 0;
-      ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, FALSE);
+      ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, \
+          GST_VPU_DEC_DROP_NONE);
       if (ret != GST_FLOW_OK) {
         GST_WARNING_OBJECT(vpu_dec_object, "gst_vpu_dec_object_send_output fail: %s\n", \
             gst_flow_get_name (ret));
@@ -1464,7 +1861,8 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
     }
     if (buf_ret & VPU_DEC_OUTPUT_MOSAIC_DIS) {
       vpu_dec_object->mosaic_cnt++;
-      ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, FALSE);
+      ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, \
+          GST_VPU_DEC_DROP_NONE);
       if (ret != GST_FLOW_OK) {
         GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_send_output fail: %s\n", \
             gst_flow_get_name (ret));
@@ -1484,7 +1882,10 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
         || buf_ret & VPU_DEC_SKIP \
         || buf_ret & VPU_DEC_OUTPUT_REPEAT) {
       GST_INFO_OBJECT (vpu_dec_object, "Got drop information!!");
-      ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, TRUE);
+      /* the VPU skips frames in the skip mode QoS configured */
+      ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, \
+          (buf_ret & VPU_DEC_SKIP) ? GST_VPU_DEC_DROP_QOS \
+          : GST_VPU_DEC_DROP_DECODER);
       if (ret != GST_FLOW_OK) {
         GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_send_output fail: %s\n", \
             gst_flow_get_name (ret));
@@ -1519,7 +1920,8 @@ gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
       GST_LOG_OBJECT (vpu_dec_object, "Got not enough input message!!");
       if (!IS_AMPHION() && vpu_dec_object->state < STATE_REGISTRIED_FRAME_BUFFER) {
         GST_WARNING_OBJECT (vpu_dec_object, "Dropped video frame before VPU init ok!");
-        ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, TRUE);
+        ret = gst_vpu_dec_object_send_output (vpu_dec_object, bdec, \
+            GST_VPU_DEC_DROP_DECODER);
         if (ret != GST_FLOW_OK) {
           GST_ERROR_OBJECT(vpu_dec_object, "gst_vpu_dec_object_send_output fail: %s\n", \
               gst_flow_get_name (ret));
@@ -1567,9 +1969,9 @@ gst_vpu_dec_object_flush (GstVideoDecoder * bdec, GstVpuDecObject * vpu_dec_obje
     }
   }
   vpu_dec_object->new_segment = TRUE;
-  g_list_free (vpu_dec_object->system_frame_number_in_vpu);
-  vpu_dec_object->system_frame_number_in_vpu = NULL;
-  GST_DEBUG_OBJECT (vpu_dec_object, "system_frame_number_in_vpu list free\n");
+  gst_vpu_dec_slots_clear_numbers (&vpu_dec_object->slots);
+  GST_DEBUG_OBJECT (vpu_dec_object, "system frame numbers in vpu cleared\n");
+  gst_vpu_dec_object_latency_changed (vpu_dec_object);
 
   // FIXME: workaround for VP8 seek. VPU will block if VPU need framebuffer
   // before seek.
@@ -1580,3 +1982,270 @@ gst_vpu_dec_object_flush (GstVideoDecoder * bdec, GstVpuDecObject * vpu_dec_obje
   return TRUE;
 }
 
+static gpointer
+gst_vpu_dec_object_async_decode_loop (gpointer user_data)
+{
+  GstVpuDecObject *vpu_dec_object = (GstVpuDecObject *) user_data;
+  GstVideoDecoder *bdec = vpu_dec_object->async_bdec;
+  GstVideoCodecFrame *frame;
+  GstBuffer *input_buffer;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  while (TRUE) {
+    while (!vpu_dec_object->async_stop \
+        && g_queue_is_empty (&vpu_dec_object->async_input))
+      g_cond_wait (&vpu_dec_object->async_cond, &vpu_dec_object->async_lock);
+    if (vpu_dec_object->async_stop)
+      break;
+
+    /* NULL drains the VPU */
+    frame = g_queue_pop_head (&vpu_dec_object->async_input);
+    vpu_dec_object->async_decoding = TRUE;
+    ret = vpu_dec_object->async_ret;
+    g_cond_broadcast (&vpu_dec_object->async_cond);
+    g_mutex_unlock (&vpu_dec_object->async_lock);
+
+    input_buffer = frame ? frame->input_buffer : NULL;
+    GST_VIDEO_DECODER_STREAM_LOCK (bdec);
+    if (ret == GST_FLOW_OK)
+      ret = gst_vpu_dec_object_decode (vpu_dec_object, bdec, frame);
+    else if (frame)
+      gst_video_codec_frame_unref (frame);
+    GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
+    if (input_buffer)
+      gst_buffer_unref (input_buffer);
+
+    g_mutex_lock (&vpu_dec_object->async_lock);
+    vpu_dec_object->async_decoding = FALSE;
+    if (ret != GST_FLOW_OK && vpu_dec_object->async_ret == GST_FLOW_OK) {
+      GST_DEBUG_OBJECT (vpu_dec_object, "decode thread got %s", \
+          gst_flow_get_name (ret));
+      vpu_dec_object->async_ret = ret;
+    }
+    g_cond_broadcast (&vpu_dec_object->async_cond);
+  }
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  return NULL;
+}
+
+static gpointer
+gst_vpu_dec_object_async_push_loop (gpointer user_data)
+{
+  GstVpuDecObject *vpu_dec_object = (GstVpuDecObject *) user_data;
+  GstVideoDecoder *bdec = vpu_dec_object->async_bdec;
+  GstVpuDecOutputFrame *out;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  while (TRUE) {
+    while (!vpu_dec_object->async_stop \
+        && g_queue_is_empty (&vpu_dec_object->async_output))
+      g_cond_wait (&vpu_dec_object->async_cond, &vpu_dec_object->async_lock);
+    if (vpu_dec_object->async_stop)
+      break;
+
+    /* stays queued until pushed, so an empty queue means all are out */
+    out = g_queue_peek_head (&vpu_dec_object->async_output);
+    g_mutex_unlock (&vpu_dec_object->async_lock);
+
+    GST_VIDEO_DECODER_STREAM_LOCK (bdec);
+    /* leave negotiation to the decode thread, it may be amid a decode */
+    if (gst_pad_check_reconfigure (GST_VIDEO_DECODER_SRC_PAD (bdec))) {
+      g_mutex_lock (&vpu_dec_object->async_lock);
+      vpu_dec_object->async_reconfigure = TRUE;
+      g_mutex_unlock (&vpu_dec_object->async_lock);
+    }
+    if (out->drop)
+      ret = gst_video_decoder_drop_frame (bdec, out->frame);
+    else
+      ret = gst_video_decoder_finish_frame (bdec, out->frame);
+    GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
+
+    g_mutex_lock (&vpu_dec_object->async_lock);
+    g_queue_pop_head (&vpu_dec_object->async_output);
+    g_free (out);
+    if (ret != GST_FLOW_OK && vpu_dec_object->async_ret == GST_FLOW_OK) {
+      GST_DEBUG_OBJECT (vpu_dec_object, "push thread got %s", \
+          gst_flow_get_name (ret));
+      vpu_dec_object->async_ret = ret;
+    }
+    g_cond_broadcast (&vpu_dec_object->async_cond);
+  }
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  return NULL;
+}
+
+/* called with async_lock, waits without the stream lock */
+static void
+gst_vpu_dec_object_async_wait_idle (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec)
+{
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+  GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  while (!vpu_dec_object->async_stop
+      && (!g_queue_is_empty (&vpu_dec_object->async_input)
+        || vpu_dec_object->async_decoding
+        || !g_queue_is_empty (&vpu_dec_object->async_output)))
+    g_cond_wait (&vpu_dec_object->async_cond, &vpu_dec_object->async_lock);
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+  GST_VIDEO_DECODER_STREAM_LOCK (bdec);
+  g_mutex_lock (&vpu_dec_object->async_lock);
+}
+
+GstFlowReturn
+gst_vpu_dec_object_async_decode (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec, GstVideoCodecFrame * frame)
+{
+  GstFlowReturn ret;
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  if (vpu_dec_object->async_decode_thread == NULL) {
+    /* started under async_lock, so the threads see their handles */
+    vpu_dec_object->async_bdec = bdec;
+    vpu_dec_object->async_stop = FALSE;
+    vpu_dec_object->async_ret = GST_FLOW_OK;
+    vpu_dec_object->async_decode_thread = g_thread_new ("vpudec-decode", \
+        gst_vpu_dec_object_async_decode_loop, vpu_dec_object);
+    vpu_dec_object->async_push_thread = g_thread_new ("vpudec-push", \
+        gst_vpu_dec_object_async_push_loop, vpu_dec_object);
+    GST_INFO_OBJECT (vpu_dec_object, "decode-ahead threads started");
+  }
+
+  ret = vpu_dec_object->async_ret;
+  if (ret != GST_FLOW_OK) {
+    g_mutex_unlock (&vpu_dec_object->async_lock);
+    if (frame)
+      gst_video_codec_frame_unref (frame);
+    return ret;
+  }
+
+  if (frame) {
+    gst_vpu_dec_object_stamp_input (vpu_dec_object, frame);
+    /* as handle_frame does, one frame of some streams decodes to two */
+    gst_buffer_ref (frame->input_buffer);
+    if (g_queue_get_length (&vpu_dec_object->async_input) >= ASYNC_INPUT_MAX) {
+      g_mutex_unlock (&vpu_dec_object->async_lock);
+      GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
+      g_mutex_lock (&vpu_dec_object->async_lock);
+      while (!vpu_dec_object->async_stop
+          && g_queue_get_length (&vpu_dec_object->async_input) >= ASYNC_INPUT_MAX)
+        g_cond_wait (&vpu_dec_object->async_cond, &vpu_dec_object->async_lock);
+      g_mutex_unlock (&vpu_dec_object->async_lock);
+      GST_VIDEO_DECODER_STREAM_LOCK (bdec);
+      g_mutex_lock (&vpu_dec_object->async_lock);
+      if (vpu_dec_object->async_stop) {
+        g_mutex_unlock (&vpu_dec_object->async_lock);
+        gst_buffer_unref (frame->input_buffer);
+        gst_video_codec_frame_unref (frame);
+        return GST_FLOW_FLUSHING;
+      }
+    }
+  }
+
+  g_queue_push_tail (&vpu_dec_object->async_input, frame);
+  g_cond_broadcast (&vpu_dec_object->async_cond);
+
+  if (frame == NULL)
+    gst_vpu_dec_object_async_wait_idle (vpu_dec_object, bdec);
+
+  ret = vpu_dec_object->async_ret;
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  return ret;
+}
+
+void
+gst_vpu_dec_object_async_stop (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec, gboolean stream_locked, gboolean discard)
+{
+  GstVpuDecOutputFrame *out;
+  GstVideoCodecFrame *frame;
+  GstBufferPool *pool;
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  if (vpu_dec_object->async_decode_thread == NULL) {
+    g_mutex_unlock (&vpu_dec_object->async_lock);
+    return;
+  }
+
+  if (!discard && stream_locked)
+    gst_vpu_dec_object_async_wait_idle (vpu_dec_object, bdec);
+  vpu_dec_object->async_stop = TRUE;
+  g_cond_broadcast (&vpu_dec_object->async_cond);
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  /* the decode thread may wait for a free buffer */
+  pool = gst_video_decoder_get_buffer_pool (bdec);
+  if (pool)
+    gst_buffer_pool_set_flushing (pool, TRUE);
+
+  if (stream_locked)
+    GST_VIDEO_DECODER_STREAM_UNLOCK (bdec);
+  g_thread_join (vpu_dec_object->async_decode_thread);
+  g_thread_join (vpu_dec_object->async_push_thread);
+  if (stream_locked)
+    GST_VIDEO_DECODER_STREAM_LOCK (bdec);
+
+  if (pool) {
+    gst_buffer_pool_set_flushing (pool, FALSE);
+    gst_object_unref (pool);
+  }
+
+  while ((out = g_queue_pop_head (&vpu_dec_object->async_output))) {
+    gst_video_codec_frame_unref (out->frame);
+    g_free (out);
+  }
+  while (!g_queue_is_empty (&vpu_dec_object->async_input)) {
+    frame = g_queue_pop_head (&vpu_dec_object->async_input);
+    if (frame) {
+      gst_buffer_unref (frame->input_buffer);
+      gst_video_codec_frame_unref (frame);
+    }
+  }
+
+  vpu_dec_object->async_decode_thread = NULL;
+  vpu_dec_object->async_push_thread = NULL;
+  vpu_dec_object->async_decoding = FALSE;
+  vpu_dec_object->async_stop = FALSE;
+  vpu_dec_object->async_ret = GST_FLOW_OK;
+  /* not negotiated yet, the next output does it */
+  if (vpu_dec_object->async_reconfigure)
+    gst_pad_mark_reconfigure (GST_VIDEO_DECODER_SRC_PAD (bdec));
+  vpu_dec_object->async_reconfigure = FALSE;
+  GST_INFO_OBJECT (vpu_dec_object, "decode-ahead threads stopped");
+}
+
+GstStructure *
+gst_vpu_dec_object_get_stats (GstVpuDecObject * vpu_dec_object)
+{
+  GstStructure *structure;
+  guint input_queued, output_queued;
+
+  structure = gst_structure_new_empty ("GstVpuDecStats");
+
+  GST_OBJECT_LOCK (vpu_dec_object);
+  gst_vpu_dec_stats_fill_structure (&vpu_dec_object->stats, structure);
+  gst_structure_set (structure,
+      "reconfig-count", G_TYPE_UINT, vpu_dec_object->reconfig_count,
+      "reconfig-pool-reused", G_TYPE_UINT, vpu_dec_object->reconfig_pool_reused,
+      "reconfig-time-max", G_TYPE_INT64, vpu_dec_object->reconfig_time_max,
+      "latency-queries", G_TYPE_UINT64, vpu_dec_object->latency_queries,
+      "latency-queries-avoided", G_TYPE_UINT64, \
+      vpu_dec_object->latency_queries_avoided, NULL);
+  GST_OBJECT_UNLOCK (vpu_dec_object);
+
+  g_mutex_lock (&vpu_dec_object->async_lock);
+  input_queued = g_queue_get_length (&vpu_dec_object->async_input);
+  output_queued = g_queue_get_length (&vpu_dec_object->async_output);
+  g_mutex_unlock (&vpu_dec_object->async_lock);
+
+  gst_structure_set (structure,
+      "async-input-queued", G_TYPE_UINT, input_queued,
+      "async-output-queued", G_TYPE_UINT, output_queued, NULL);
+
+  return structure;
+}
@@ -24,6 +24,8 @@
 #include <gst/video/gstvideodecoder.h>
 #include "video-tsm/mfw_gst_ts.h"
 #include "gstvpu.h"
+#include "gstvpudecslots.h"
+#include "gstvpudecstats.h"
 
 G_BEGIN_DECLS
 
@@ -50,6 +52,9 @@ typedef struct _GstVpuDecObjectClass GstVpuDecObjectClass;
 #define GST_VPU_DEC_BUF_ALIGNMENT(o)         ((o)->buf_align)
 #define GST_VPU_DEC_VIDEO_ALIGNMENT(o)       ((o)->video_align)
 #define GST_VPU_DEC_DISABLE_REORDER(o)       ((o)->disable_reorder)
+#define GST_VPU_DEC_LATENCY_REFRESH(o)       ((o)->latency_refresh)
+#define GST_VPU_DEC_ASYNC_DECODE(o)          ((o)->async_decode)
+#define GST_VPU_DEC_STATS_INTERVAL(o)        ((o)->stats_interval)
  
 typedef enum {
   STATE_NULL    = 0,
@@ -87,12 +92,17 @@ struct _GstVpuDecObject {
   gint height_paded;
   VpuDecState state;
   GList * mv_mem;
+  /* size of each mv_mem block, blocks are kept while they fit */
+  gint mv_mem_size;
   GstVideoFormat output_format_decided;
-  GHashTable *frame2gstbuffer_table;
-  GHashTable *gstbuffer2frame_table;
-  GList * system_frame_number_in_vpu;
+  GstVpuDecSlots slots;
+  /* allocated for registration, owned by slots after it */
   GList * gstbuffer_in_vpudec;
-  GList * gstbuffer_in_vpudec2;
+  /* buffers of a reused pool which aren't registered to the VPU */
+  GList * spare_buffers;
+  /* decide_allocation kept the buffer pool for the new geometry */
+  gboolean pool_reused;
+  guint pool_outstanding;
   gint vpu_hold_buffer;
   guint64 drm_modifier;
   guint64 drm_modifier_pre;
@@ -113,12 +123,51 @@ struct _GstVpuDecObject {
   gboolean vpu_report_resolution_change; 
   gboolean vpu_need_reconfig;
   gboolean disable_reorder;
+  /* peer latency query result, refreshed on latency events, caps changes,
+   * flushes and every latency_refresh ms (0: events only) */
+  guint latency_refresh;
+  gboolean is_live;
+  gboolean is_live_valid;
+  gint64 is_live_checked;
+  guint64 latency_queries;
+  guint64 latency_queries_avoided;
+  /* decode-ahead: handle_frame queues input for the decode thread which
+   * feeds the VPU, decoded frames are queued for the push thread. The
+   * decode thread drops the stream lock while the VPU decodes. */
+  gboolean async_decode;
+  /* async_decode latched at start, the property may change later */
+  gboolean async_active;
+  GstVideoDecoder *async_bdec;
+  GThread *async_decode_thread;
+  GThread *async_push_thread;
+  GMutex async_lock;
+  GCond async_cond;
+  GQueue async_input;
+  GQueue async_output;
+  gboolean async_decoding;
+  gboolean async_stop;
+  GstFlowReturn async_ret;
+  /* reconfigure seen by the push thread, negotiated by the decode thread */
+  gboolean async_reconfigure;
   void *tsm;
   TSMGR_MODE tsm_mode;
   GstClockTime last_valid_ts;
   GstClockTime last_received_ts;
   gint64 total_time;
   gint64 total_frames;
+  /* framebuffer reconfig per resolution or DPB size change, in us */
+  guint reconfig_count;
+  guint reconfig_pool_reused;
+  gint64 reconfig_time_last;
+  gint64 reconfig_time_max;
+  gint64 reconfig_time_total;
+  guint mv_mem_reused;
+  guint mv_mem_allocated;
+  /* updated with the object lock, posted as element message every
+   * stats_interval ms (0: never) */
+  GstVpuDecStats stats;
+  guint stats_interval;
+  gint64 stats_posted;
   GstMapInfo input_minfo;
   GstMapInfo codec_data_minfo;
 };
@@ -146,6 +195,19 @@ gboolean gst_vpu_dec_object_config (GstVpuDecObject * vpu_dec_object, \
 GstFlowReturn gst_vpu_dec_object_decode (GstVpuDecObject * vpu_dec_object, \
     GstVideoDecoder * bdec, GstVideoCodecFrame * frame);
 gboolean gst_vpu_dec_object_flush (GstVideoDecoder * bdec, GstVpuDecObject * vpu_dec_object);
+gboolean gst_vpu_dec_object_is_live (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec);
+void gst_vpu_dec_object_latency_changed (GstVpuDecObject * vpu_dec_object);
+/* takes frame like gst_vpu_dec_object_decode, NULL drains; called with
+ * the stream lock */
+GstFlowReturn gst_vpu_dec_object_async_decode (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec, GstVideoCodecFrame * frame);
+/* joins the threads, queued frames are decoded and pushed first unless
+ * discard; stream_locked tells whether the caller holds the stream lock */
+void gst_vpu_dec_object_async_stop (GstVpuDecObject * vpu_dec_object, \
+    GstVideoDecoder * bdec, gboolean stream_locked, gboolean discard);
+/* snapshot of the decode statistics, free with gst_structure_free */
+GstStructure *gst_vpu_dec_object_get_stats (GstVpuDecObject * vpu_dec_object);
 
 G_END_DECLS
 
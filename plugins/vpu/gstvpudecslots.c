@@ -0,0 +1,249 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "gstvpudecslots.h"
+
+/* grows by doubling, only when more frames are queued than ever before */
+#define GST_VPU_DEC_SLOTS_MIN_NUMBERS (64)
+
+static inline guint
+gst_vpu_dec_slots_hash (gconstpointer key, guint mask)
+{
+  return (guint) (((guintptr) key >> 4) * 2654435761u) & mask;
+}
+
+static void
+gst_vpu_dec_slots_map_insert (GstVpuDecSlotKey * map, guint mask,
+    gconstpointer key, gint index)
+{
+  guint i = gst_vpu_dec_slots_hash (key, mask);
+
+  while (map[i].key != NULL && map[i].key != key)
+    i = (i + 1) & mask;
+
+  map[i].key = key;
+  map[i].index = index;
+}
+
+static gint
+gst_vpu_dec_slots_map_lookup (GstVpuDecSlotKey * map, guint mask,
+    gconstpointer key)
+{
+  guint i;
+
+  if (map == NULL || key == NULL)
+    return -1;
+
+  i = gst_vpu_dec_slots_hash (key, mask);
+  while (map[i].key != NULL) {
+    if (map[i].key == key)
+      return map[i].index;
+    i = (i + 1) & mask;
+  }
+
+  return -1;
+}
+
+void
+gst_vpu_dec_slots_init (GstVpuDecSlots * slots)
+{
+  memset (slots, 0, sizeof (GstVpuDecSlots));
+}
+
+void
+gst_vpu_dec_slots_reset (GstVpuDecSlots * slots)
+{
+  guint i;
+
+  for (i = 0; i < slots->n_slots; i++) {
+    if (slots->slots[i].in_vpu && slots->slots[i].buffer)
+      gst_buffer_unref (slots->slots[i].buffer);
+  }
+
+  g_free (slots->slots);
+  g_free (slots->by_addr);
+  g_free (slots->by_buffer);
+  slots->slots = NULL;
+  slots->by_addr = NULL;
+  slots->by_buffer = NULL;
+  slots->n_slots = 0;
+  slots->in_vpu = 0;
+  slots->map_mask = 0;
+}
+
+GList *
+gst_vpu_dec_slots_steal (GstVpuDecSlots * slots, GList * list)
+{
+  guint i;
+
+  for (i = 0; i < slots->n_slots; i++) {
+    if (slots->slots[i].in_vpu && slots->slots[i].buffer) {
+      list = g_list_append (list, slots->slots[i].buffer);
+      slots->slots[i].in_vpu = FALSE;
+      slots->in_vpu--;
+    }
+  }
+
+  gst_vpu_dec_slots_reset (slots);
+
+  return list;
+}
+
+void
+gst_vpu_dec_slots_free (GstVpuDecSlots * slots)
+{
+  gst_vpu_dec_slots_reset (slots);
+
+  g_free (slots->numbers);
+  slots->numbers = NULL;
+  slots->numbers_size = 0;
+  slots->numbers_head = 0;
+  slots->numbers_len = 0;
+}
+
+void
+gst_vpu_dec_slots_register (GstVpuDecSlots * slots, guint n_slots)
+{
+  guint size = 8;
+
+  gst_vpu_dec_slots_reset (slots);
+
+  /* at most half full keeps probe chains short */
+  while (size < n_slots * 2)
+    size <<= 1;
+
+  slots->slots = g_new0 (GstVpuDecSlot, n_slots);
+  slots->by_addr = g_new0 (GstVpuDecSlotKey, size);
+  slots->by_buffer = g_new0 (GstVpuDecSlotKey, size);
+  slots->map_mask = size - 1;
+  slots->n_slots = n_slots;
+}
+
+void
+gst_vpu_dec_slots_set (GstVpuDecSlots * slots, guint index,
+    GstBuffer * buffer, gpointer frame, gconstpointer addr)
+{
+  GstVpuDecSlot *slot;
+
+  g_return_if_fail (index < slots->n_slots);
+
+  slot = &slots->slots[index];
+  if (slot->in_vpu && slot->buffer)
+    gst_buffer_unref (slot->buffer);
+  else if (!slot->in_vpu)
+    slots->in_vpu++;
+
+  slot->buffer = buffer;
+  slot->frame = frame;
+  slot->in_vpu = TRUE;
+
+  if (addr)
+    gst_vpu_dec_slots_map_insert (slots->by_addr, slots->map_mask, addr,
+        index);
+  if (buffer)
+    gst_vpu_dec_slots_map_insert (slots->by_buffer, slots->map_mask, buffer,
+        index);
+}
+
+gint
+gst_vpu_dec_slots_find_addr (GstVpuDecSlots * slots, gconstpointer addr)
+{
+  return gst_vpu_dec_slots_map_lookup (slots->by_addr, slots->map_mask, addr);
+}
+
+gint
+gst_vpu_dec_slots_find_buffer (GstVpuDecSlots * slots, GstBuffer * buffer)
+{
+  return gst_vpu_dec_slots_map_lookup (slots->by_buffer, slots->map_mask,
+      buffer);
+}
+
+GstBuffer *
+gst_vpu_dec_slots_take (GstVpuDecSlots * slots, guint index)
+{
+  GstVpuDecSlot *slot;
+
+  g_return_val_if_fail (index < slots->n_slots, NULL);
+
+  slot = &slots->slots[index];
+  if (slot->in_vpu) {
+    slot->in_vpu = FALSE;
+    slots->in_vpu--;
+  }
+
+  return slot->buffer;
+}
+
+void
+gst_vpu_dec_slots_give (GstVpuDecSlots * slots, guint index)
+{
+  GstVpuDecSlot *slot;
+
+  g_return_if_fail (index < slots->n_slots);
+
+  slot = &slots->slots[index];
+  if (!slot->in_vpu) {
+    slot->in_vpu = TRUE;
+    slots->in_vpu++;
+  }
+}
+
+void
+gst_vpu_dec_slots_push_number (GstVpuDecSlots * slots, guint32 number)
+{
+  if (slots->numbers_len == slots->numbers_size) {
+    guint size = MAX (slots->numbers_size * 2, GST_VPU_DEC_SLOTS_MIN_NUMBERS);
+    guint32 *numbers = g_new (guint32, size);
+    guint i;
+
+    for (i = 0; i < slots->numbers_len; i++)
+      numbers[i] = slots->numbers[(slots->numbers_head + i)
+          & (slots->numbers_size - 1)];
+
+    g_free (slots->numbers);
+    slots->numbers = numbers;
+    slots->numbers_size = size;
+    slots->numbers_head = 0;
+  }
+
+  slots->numbers[(slots->numbers_head + slots->numbers_len)
+      & (slots->numbers_size - 1)] = number;
+  slots->numbers_len++;
+}
+
+gboolean
+gst_vpu_dec_slots_pop_number (GstVpuDecSlots * slots, guint32 * number)
+{
+  if (slots->numbers_len == 0) {
+    *number = 0;
+    return FALSE;
+  }
+
+  *number = slots->numbers[slots->numbers_head];
+  slots->numbers_head = (slots->numbers_head + 1) & (slots->numbers_size - 1);
+  slots->numbers_len--;
+
+  return TRUE;
+}
+
+void
+gst_vpu_dec_slots_clear_numbers (GstVpuDecSlots * slots)
+{
+  slots->numbers_head = 0;
+  slots->numbers_len = 0;
+}
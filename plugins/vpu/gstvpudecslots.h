@@ -0,0 +1,98 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VPU_DEC_SLOTS_H__
+#define __GST_VPU_DEC_SLOTS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Per framebuffer bookkeeping of the VPU decoder. Slots are indexed like
+ * the framebuffer array registered to the VPU; framebuffer address and
+ * GstBuffer are mapped to the slot index by open addressing tables sized
+ * at registration, so the per frame path neither walks lists nor
+ * allocates. */
+
+typedef struct
+{
+  GstBuffer *buffer;
+  gpointer frame;               /* VpuFrameBuffer to hand back to the VPU */
+  gboolean in_vpu;              /* VPU owns buffer, slot holds the ref */
+} GstVpuDecSlot;
+
+typedef struct
+{
+  gconstpointer key;
+  gint index;
+} GstVpuDecSlotKey;
+
+typedef struct
+{
+  GstVpuDecSlot *slots;
+  guint n_slots;
+  guint in_vpu;
+
+  GstVpuDecSlotKey *by_addr;
+  GstVpuDecSlotKey *by_buffer;
+  guint map_mask;
+
+  /* system frame numbers sent to the VPU, oldest first */
+  guint32 *numbers;
+  guint numbers_size;
+  guint numbers_head;
+  guint numbers_len;
+} GstVpuDecSlots;
+
+#define GST_VPU_DEC_SLOTS_IN_VPU(s)          ((s)->in_vpu)
+#define GST_VPU_DEC_SLOTS_N_NUMBERS(s)       ((s)->numbers_len)
+
+void gst_vpu_dec_slots_init (GstVpuDecSlots * slots);
+void gst_vpu_dec_slots_free (GstVpuDecSlots * slots);
+/* unrefs the buffers the VPU still holds and forgets the registration */
+void gst_vpu_dec_slots_reset (GstVpuDecSlots * slots);
+
+/* appends the buffers the VPU holds to list, in slot order and with their
+ * refs, then resets; for registering them again */
+GList *gst_vpu_dec_slots_steal (GstVpuDecSlots * slots, GList * list);
+
+/* resets and sizes for n_slots framebuffers */
+void gst_vpu_dec_slots_register (GstVpuDecSlots * slots, guint n_slots);
+/* takes the ref of buffer, which starts owned by the VPU; addr is the
+ * framebuffer address the VPU reports on output */
+void gst_vpu_dec_slots_set (GstVpuDecSlots * slots, guint index,
+    GstBuffer * buffer, gpointer frame, gconstpointer addr);
+
+/* slot index or -1 */
+gint gst_vpu_dec_slots_find_addr (GstVpuDecSlots * slots, gconstpointer addr);
+gint gst_vpu_dec_slots_find_buffer (GstVpuDecSlots * slots,
+    GstBuffer * buffer);
+
+/* buffer leaves the VPU, the ref goes with the returned buffer */
+GstBuffer *gst_vpu_dec_slots_take (GstVpuDecSlots * slots, guint index);
+/* buffer is back in the VPU with a ref, no-op if it never left */
+void gst_vpu_dec_slots_give (GstVpuDecSlots * slots, guint index);
+
+void gst_vpu_dec_slots_push_number (GstVpuDecSlots * slots, guint32 number);
+/* FALSE and 0 when empty */
+gboolean gst_vpu_dec_slots_pop_number (GstVpuDecSlots * slots,
+    guint32 * number);
+void gst_vpu_dec_slots_clear_numbers (GstVpuDecSlots * slots);
+
+G_END_DECLS
+
+#endif /* __GST_VPU_DEC_SLOTS_H__ */
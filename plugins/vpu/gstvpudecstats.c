@@ -0,0 +1,137 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include <string.h>
+#include "gstvpudecstats.h"
+
+void
+gst_vpu_dec_stats_reset (GstVpuDecStats * stats)
+{
+  guint i;
+
+  memset (stats, 0, sizeof (GstVpuDecStats));
+  stats->framebuffers_in_vpu_min = G_MAXUINT;
+  for (i = 0; i < GST_VPU_DEC_STATS_STAMPS; i++)
+    stats->stamps[i].time = -1;
+}
+
+void
+gst_vpu_dec_stats_add_time (GstVpuDecStatsTimes * times, gint64 time)
+{
+  gint64 ms = time / 1000;
+  guint bucket = 0;
+
+  while (bucket < GST_VPU_DEC_STATS_BUCKETS - 1 && ms >= (1 << bucket))
+    bucket++;
+
+  times->buckets[bucket]++;
+  times->count++;
+  times->total += time;
+  times->max = MAX (times->max, time);
+  times->last = time;
+}
+
+void
+gst_vpu_dec_stats_stamp_input (GstVpuDecStats * stats, guint32 number,
+    gint64 now)
+{
+  GstVpuDecStatsStamp *stamp =
+      &stats->stamps[number & (GST_VPU_DEC_STATS_STAMPS - 1)];
+
+  stamp->number = number;
+  stamp->time = now;
+  stats->frames_in++;
+}
+
+gint64
+gst_vpu_dec_stats_input_age (GstVpuDecStats * stats, guint32 number,
+    gint64 now)
+{
+  GstVpuDecStatsStamp *stamp =
+      &stats->stamps[number & (GST_VPU_DEC_STATS_STAMPS - 1)];
+
+  if (stamp->time < 0 || stamp->number != number)
+    return -1;
+
+  return now - stamp->time;
+}
+
+void
+gst_vpu_dec_stats_add_occupancy (GstVpuDecStats * stats,
+    guint framebuffers, guint in_vpu, guint reorder_depth)
+{
+  stats->framebuffers = framebuffers;
+  stats->framebuffers_in_vpu = in_vpu;
+  stats->framebuffers_in_vpu_min = MIN (stats->framebuffers_in_vpu_min, in_vpu);
+  stats->reorder_depth = reorder_depth;
+  stats->reorder_depth_max = MAX (stats->reorder_depth_max, reorder_depth);
+}
+
+static void
+gst_vpu_dec_stats_fill_times (GstVpuDecStatsTimes * times,
+    GstStructure * structure, const gchar * prefix)
+{
+  GValue histogram = G_VALUE_INIT;
+  GValue bucket = G_VALUE_INIT;
+  gchar *name;
+  guint i;
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  g_value_init (&bucket, G_TYPE_UINT64);
+  for (i = 0; i < GST_VPU_DEC_STATS_BUCKETS; i++) {
+    g_value_set_uint64 (&bucket, times->buckets[i]);
+    gst_value_array_append_value (&histogram, &bucket);
+  }
+  g_value_unset (&bucket);
+
+  name = g_strconcat (prefix, "-histogram", NULL);
+  gst_structure_take_value (structure, name, &histogram);
+  g_free (name);
+
+  name = g_strconcat (prefix, "-average", NULL);
+  gst_structure_set (structure, name, G_TYPE_INT64,
+      times->count ? times->total / (gint64) times->count : 0, NULL);
+  g_free (name);
+  name = g_strconcat (prefix, "-max", NULL);
+  gst_structure_set (structure, name, G_TYPE_INT64, times->max, NULL);
+  g_free (name);
+  name = g_strconcat (prefix, "-last", NULL);
+  gst_structure_set (structure, name, G_TYPE_INT64, times->last, NULL);
+  g_free (name);
+}
+
+void
+gst_vpu_dec_stats_fill_structure (GstVpuDecStats * stats,
+    GstStructure * structure)
+{
+  gst_structure_set (structure,
+      "frames-in", G_TYPE_UINT64, stats->frames_in,
+      "frames-out", G_TYPE_UINT64, stats->frames_out,
+      "dropped-qos", G_TYPE_UINT64, stats->dropped_qos,
+      "dropped-mosaic", G_TYPE_UINT64, stats->dropped_mosaic,
+      "dropped-decoder", G_TYPE_UINT64, stats->dropped_decoder,
+      "framebuffers", G_TYPE_UINT, stats->framebuffers,
+      "framebuffers-in-vpu", G_TYPE_UINT, stats->framebuffers_in_vpu,
+      "framebuffers-in-vpu-min", G_TYPE_UINT,
+      stats->framebuffers_in_vpu_min == G_MAXUINT ? 0
+      : stats->framebuffers_in_vpu_min,
+      "reorder-depth", G_TYPE_UINT, stats->reorder_depth,
+      "reorder-depth-max", G_TYPE_UINT, stats->reorder_depth_max, NULL);
+
+  gst_vpu_dec_stats_fill_times (&stats->decode_time, structure, "decode-time");
+  gst_vpu_dec_stats_fill_times (&stats->latency, structure, "latency");
+}
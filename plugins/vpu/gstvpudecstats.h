@@ -0,0 +1,89 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_VPU_DEC_STATS_H__
+#define __GST_VPU_DEC_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Decode performance counters of the VPU decoder, reported as a
+ * GstStructure by the "stats" property and the periodic element message.
+ * Times are in us. Histogram bucket i counts samples below 2^i ms, the
+ * last one everything above. */
+
+#define GST_VPU_DEC_STATS_BUCKETS            (12)
+/* input times are kept for this many frames in flight, power of two */
+#define GST_VPU_DEC_STATS_STAMPS             (64)
+
+typedef struct
+{
+  guint64 count;
+  gint64 total;
+  gint64 max;
+  gint64 last;
+  guint64 buckets[GST_VPU_DEC_STATS_BUCKETS];
+} GstVpuDecStatsTimes;
+
+typedef struct
+{
+  guint32 number;
+  gint64 time;
+} GstVpuDecStatsStamp;
+
+typedef struct
+{
+  guint64 frames_in;
+  guint64 frames_out;
+  /* VPU time until a frame is consumed */
+  GstVpuDecStatsTimes decode_time;
+  /* from handle_frame until the frame is output */
+  GstVpuDecStatsTimes latency;
+  guint64 dropped_qos;
+  guint64 dropped_mosaic;
+  guint64 dropped_decoder;
+  /* sampled on each output */
+  guint framebuffers;
+  guint framebuffers_in_vpu;
+  guint framebuffers_in_vpu_min;
+  guint reorder_depth;
+  guint reorder_depth_max;
+
+  GstVpuDecStatsStamp stamps[GST_VPU_DEC_STATS_STAMPS];
+} GstVpuDecStats;
+
+void gst_vpu_dec_stats_reset (GstVpuDecStats * stats);
+
+void gst_vpu_dec_stats_add_time (GstVpuDecStatsTimes * times, gint64 time);
+
+void gst_vpu_dec_stats_stamp_input (GstVpuDecStats * stats, guint32 number,
+    gint64 now);
+/* time since the input of frame number, -1 if not stamped or overwritten */
+gint64 gst_vpu_dec_stats_input_age (GstVpuDecStats * stats, guint32 number,
+    gint64 now);
+
+void gst_vpu_dec_stats_add_occupancy (GstVpuDecStats * stats,
+    guint framebuffers, guint in_vpu, guint reorder_depth);
+
+/* sets the fields of stats on structure */
+void gst_vpu_dec_stats_fill_structure (GstVpuDecStats * stats,
+    GstStructure * structure);
+
+G_END_DECLS
+
+#endif /* __GST_VPU_DEC_STATS_H__ */
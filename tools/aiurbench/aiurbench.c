@@ -0,0 +1,648 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurbench.c
+ *
+ * Description:    aiurdemux throughput benchmark. Generates a stream for
+ *                 the synthetic parser core, registers the core in a
+ *                 private aiur registry and runs
+ *                 filesrc ! capsfilter [! queue] ! aiurdemux ! fakesink,
+ *                 then reports samples/sec, bytes moved and allocations
+ *                 from the demuxer stats. With --check-startup it also
+ *                 checks the startup stats against the demuxer stats, with
+ *                 --image that the cover art is extracted or skipped.
+ *                 --read-delay makes every upstream pull slow, to compare
+ *                 pull mode runs with and without --block-cache.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include "aiursynthcore.h"
+
+#define AIUR_BENCH_PAYLOAD_CHUNK 65536
+
+typedef struct
+{
+  gchar *core;
+  gchar *plugin;
+  guint tracks;
+  guint samples;
+  guint min_size;
+  guint max_size;
+  gchar *dist;
+  guint sync;
+  gchar *interleave;
+  guint fragment;
+  guint video;
+  guint file_mode;
+  guint push;
+  guint runs;
+  guint payload;
+  guint timeout;
+  guint check_startup;
+  guint image;
+  guint max_image;
+  gint block_cache;
+  guint read_delay;
+} AiurBenchConfig;
+
+typedef struct
+{
+  GMutex lock;
+  guint64 buffers;
+  guint64 bytes;
+} AiurBenchCounter;
+
+typedef struct
+{
+  gdouble seconds;
+  guint64 buffers;
+  guint64 bytes;
+  GstStructure *stats;
+} AiurBenchResult;
+
+typedef struct
+{
+  GstElement *demux;
+  gboolean seen;
+  gboolean ok;
+} AiurBenchStartup;
+
+static void
+print_help ()
+{
+  g_print ("options :\n");
+  g_print ("    --core=PATH         Synthetic parser core library (required)\n");
+  g_print ("    --plugin=PATH       aiurdemux plugin to load instead of the registered one\n");
+  g_print ("    --tracks=N          Number of tracks, first one is video (default 3)\n");
+  g_print ("    --samples=N         Samples per track (default 2000)\n");
+  g_print ("    --min-size=BYTES    Smallest sample (default 256)\n");
+  g_print ("    --max-size=BYTES    Largest sample (default 65536)\n");
+  g_print ("    --dist=NAME         Sample size distribution: fixed, uniform, gop (default uniform)\n");
+  g_print ("    --sync=N            Video sync sample interval (default 30)\n");
+  g_print ("    --interleave=A,B,.. Samples per track in each file mode round (default 1 each)\n");
+  g_print ("    --fragment=BYTES    Output samples in fragments of this size, 0 for whole (default 0)\n");
+  g_print ("    --video=0|1         Track 0 is H.264 video (default 1)\n");
+  g_print ("    --file-mode=0|1     Refuse track based reading (default 0)\n");
+  g_print ("    --push=0|1          Run the demuxer in push mode (default 0)\n");
+  g_print ("    --payload=BYTES     Size of the payload in the stream (default 8388608)\n");
+  g_print ("    --runs=N            Number of runs, the median run is reported (default 5)\n");
+  g_print ("    --timeout=SEC       Fail a run which doesn't reach EOS in time, 0 to wait forever (default 60)\n");
+  g_print ("    --check-startup=0|1 Fail a run whose startup stats don't add up (default 0)\n");
+  g_print ("    --image=BYTES       Cover art of this size, fail a run which doesn't extract or skip it as max-image-tag-size says (default 0)\n");
+  g_print ("    --max-image=BYTES   Set max-image-tag-size, 0 to keep the default (default 0)\n");
+  g_print ("    --block-cache=N     Set block-cache-blocks, 0 to read the pad directly (default: element default)\n");
+  g_print ("    --read-delay=USEC   Delay every upstream pull, pull mode only (default 0)\n");
+}
+
+static gboolean
+parse_options (AiurBenchConfig * config, gint argc, gchar * argv[])
+{
+  struct
+  {
+    const gchar *name;
+    guint *uint_value;
+    gchar **string_value;
+  } table[] = {
+    {"--core", NULL, &config->core},
+    {"--plugin", NULL, &config->plugin},
+    {"--tracks", &config->tracks, NULL},
+    {"--samples", &config->samples, NULL},
+    {"--min-size", &config->min_size, NULL},
+    {"--max-size", &config->max_size, NULL},
+    {"--dist", NULL, &config->dist},
+    {"--sync", &config->sync, NULL},
+    {"--interleave", NULL, &config->interleave},
+    {"--fragment", &config->fragment, NULL},
+    {"--video", &config->video, NULL},
+    {"--file-mode", &config->file_mode, NULL},
+    {"--push", &config->push, NULL},
+    {"--payload", &config->payload, NULL},
+    {"--runs", &config->runs, NULL},
+    {"--timeout", &config->timeout, NULL},
+    {"--check-startup", &config->check_startup, NULL},
+    {"--image", &config->image, NULL},
+    {"--max-image", &config->max_image, NULL},
+    {"--block-cache", (guint *) &config->block_cache, NULL},
+    {"--read-delay", &config->read_delay, NULL},
+  };
+  gint i, j;
+
+  config->tracks = 3;
+  config->samples = 2000;
+  config->min_size = 256;
+  config->max_size = 65536;
+  config->dist = "uniform";
+  config->sync = 30;
+  config->interleave = "";
+  config->video = 1;
+  config->payload = 8388608;
+  config->runs = 5;
+  config->timeout = 60;
+  config->block_cache = -1;
+
+  for (i = 1; i < argc; i++) {
+    gchar *value = strchr (argv[i], '=');
+    gsize len = value ? (gsize) (value - argv[i]) : strlen (argv[i]);
+
+    if ((strcmp (argv[i], "-h") == 0) || (strcmp (argv[i], "--help") == 0))
+      return FALSE;
+
+    for (j = 0; j < G_N_ELEMENTS (table); j++) {
+      if ((strlen (table[j].name) == len)
+          && (strncmp (argv[i], table[j].name, len) == 0))
+        break;
+    }
+    if ((j == G_N_ELEMENTS (table)) || (value == NULL)) {
+      g_print ("Unknown option %s\n", argv[i]);
+      return FALSE;
+    }
+
+    if (table[j].uint_value)
+      *table[j].uint_value = strtoul (value + 1, NULL, 0);
+    else
+      *table[j].string_value = value + 1;
+  }
+
+  if (config->core == NULL) {
+    g_print ("--core is required\n");
+    return FALSE;
+  }
+  if (config->runs == 0)
+    config->runs = 1;
+
+  return TRUE;
+}
+
+static gboolean
+write_registry (const gchar * path, const gchar * core)
+{
+  gchar *content;
+  gboolean ret;
+
+  content = g_strdup_printf ("#aiurconfig\n\n[Synthetic]\nmime = %s\n"
+      "library = %s\n", AIUR_SYNTH_MIME, core);
+  ret = g_file_set_contents (path, content, -1, NULL);
+  g_free (content);
+
+  return ret;
+}
+
+static gboolean
+write_stream (const gchar * path, AiurBenchConfig * config)
+{
+  gchar header[AIUR_SYNTH_HEADER_SIZE];
+  guint8 *chunk;
+  guint64 left;
+  FILE *fp;
+  gint len, i;
+  gboolean ret = TRUE;
+
+  fp = fopen (path, "wb");
+  if (fp == NULL)
+    return FALSE;
+
+  memset (header, ' ', sizeof (header));
+  len = g_snprintf (header, sizeof (header),
+      "%s tracks=%u samples=%u min=%u max=%u dist=%s sync=%u interleave=%s "
+      "fragment=%u video=%u file-mode=%u payload=%u image=%u",
+      AIUR_SYNTH_MAGIC, config->tracks, config->samples, config->min_size,
+      config->max_size, config->dist, config->sync, config->interleave,
+      config->fragment, config->video, config->file_mode, config->payload,
+      config->image);
+  header[len] = ' ';
+  header[sizeof (header) - 1] = '\n';
+
+  chunk = g_malloc (AIUR_BENCH_PAYLOAD_CHUNK);
+  for (i = 0; i < AIUR_BENCH_PAYLOAD_CHUNK; i++)
+    chunk[i] = (guint8) i;
+
+  if (fwrite (header, 1, sizeof (header), fp) != sizeof (header))
+    ret = FALSE;
+
+  for (left = config->payload; ret && left;) {
+    gsize n = MIN (left, AIUR_BENCH_PAYLOAD_CHUNK);
+    if (fwrite (chunk, 1, n, fp) != n)
+      ret = FALSE;
+    left -= n;
+  }
+
+  g_free (chunk);
+  if (fclose (fp))
+    ret = FALSE;
+
+  return ret;
+}
+
+static GstPadProbeReturn
+count_buffer (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  AiurBenchCounter *counter = (AiurBenchCounter *) user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  g_mutex_lock (&counter->lock);
+  counter->buffers++;
+  counter->bytes += gst_buffer_get_size (buffer);
+  g_mutex_unlock (&counter->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* slow storage, every range pulled from the source costs the delay */
+static GstPadProbeReturn
+delay_pull (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  g_usleep (GPOINTER_TO_UINT (user_data));
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+pad_added (GstElement * demux, GstPad * pad, gpointer user_data)
+{
+  GstElement *pipeline = GST_ELEMENT (gst_element_get_parent (demux));
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, NULL);
+  gst_bin_add (GST_BIN (pipeline), sink);
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, count_buffer,
+      user_data, NULL);
+
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+
+  gst_element_sync_state_with_parent (sink);
+  gst_object_unref (pipeline);
+}
+
+static guint64
+stat_value (const GstStructure * stats, const gchar * name)
+{
+  guint64 value = 0;
+
+  gst_structure_get_uint64 (stats, name, &value);
+  return value;
+}
+
+/* per state io must add up to the content io totals, and no pad can
+ * have its first buffer before the header is parsed */
+static gboolean
+check_startup (const GstStructure * startup, const GstStructure * stats)
+{
+  static const gchar *states[] = { "probe", "init", "header", "movie" };
+  static const gchar *counters[] = { "reads", "read-bytes", "seeks" };
+  gboolean complete = FALSE, ret = TRUE;
+  guint64 header_done = 0;
+  gint i, j;
+
+  gst_structure_get_boolean (startup, "complete", &complete);
+  if (!complete) {
+    g_print ("Startup stats not complete\n");
+    ret = FALSE;
+  }
+
+  for (i = 0; i < G_N_ELEMENTS (counters); i++) {
+    guint64 sum = 0;
+
+    for (j = 0; j < G_N_ELEMENTS (states); j++) {
+      gchar *name = g_strdup_printf ("%s-%s", states[j], counters[i]);
+      sum += stat_value (startup, name);
+      g_free (name);
+    }
+    if (sum != stat_value (stats, counters[i])) {
+      g_print ("Startup %s %" G_GUINT64_FORMAT " != total %" G_GUINT64_FORMAT
+          "\n", counters[i], sum, stat_value (stats, counters[i]));
+      ret = FALSE;
+    }
+  }
+
+  for (j = 0; j < G_N_ELEMENTS (states) - 1; j++) {
+    gchar *name = g_strdup_printf ("%s-time", states[j]);
+    header_done += stat_value (startup, name);
+    g_free (name);
+  }
+
+  for (i = 0; i < gst_structure_n_fields (startup); i++) {
+    const gchar *name = gst_structure_nth_field_name (startup, i);
+
+    if (g_str_has_suffix (name, "first-buffer")
+        && (stat_value (startup, name) < header_done)) {
+      g_print ("Startup %s %" G_GUINT64_FORMAT " before header done at %"
+          G_GUINT64_FORMAT "\n", name, stat_value (startup, name),
+          header_done);
+      ret = FALSE;
+    }
+  }
+
+  return ret;
+}
+
+/* the image is extracted when it fits max-image-tag-size, else skipped */
+static gboolean
+check_image (AiurBenchConfig * config, GstElement * demux,
+    const GstStructure * stats)
+{
+  guint max_image = 0;
+  gboolean fits;
+
+  g_object_get (demux, "max-image-tag-size", &max_image, NULL);
+  fits = (config->image <= max_image);
+
+  if ((stat_value (stats, "image-tags") != (fits ? 1 : 0))
+      || (stat_value (stats, "image-tags-skipped") != (fits ? 0 : 1))) {
+    g_print ("Image of %u bytes, limit %u: %" G_GUINT64_FORMAT
+        " extracted, %" G_GUINT64_FORMAT " skipped\n", config->image,
+        max_image, stat_value (stats, "image-tags"),
+        stat_value (stats, "image-tags-skipped"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* runs in the streaming thread which posts the message, the demuxer
+ * doesn't read on until it returns */
+static GstBusSyncReply
+startup_message (GstBus * bus, GstMessage * msg, gpointer user_data)
+{
+  AiurBenchStartup *startup = (AiurBenchStartup *) user_data;
+  GstStructure *stats = NULL;
+
+  if ((GST_MESSAGE_TYPE (msg) != GST_MESSAGE_ELEMENT)
+      || (GST_MESSAGE_SRC (msg) != GST_OBJECT_CAST (startup->demux))
+      || !gst_message_has_name (msg, "GstAiurDemuxStartup"))
+    return GST_BUS_PASS;
+
+  g_object_get (startup->demux, "stats", &stats, NULL);
+  startup->ok = check_startup (gst_message_get_structure (msg), stats);
+  startup->seen = TRUE;
+  gst_structure_free (stats);
+
+  return GST_BUS_PASS;
+}
+
+static gboolean
+run_once (AiurBenchConfig * config, const gchar * stream,
+    AiurBenchResult * result)
+{
+  GstElement *pipeline, *src, *filter, *queue = NULL, *demux;
+  AiurBenchCounter counter;
+  AiurBenchStartup startup;
+  GstCaps *caps;
+  GstBus *bus;
+  GstMessage *msg;
+  gint64 start;
+  gboolean ret = FALSE;
+
+  memset (&counter, 0, sizeof (counter));
+  g_mutex_init (&counter.lock);
+  memset (&startup, 0, sizeof (startup));
+
+  pipeline = gst_pipeline_new ("aiurbench");
+  src = gst_element_factory_make ("filesrc", NULL);
+  filter = gst_element_factory_make ("capsfilter", NULL);
+  demux = gst_element_factory_make ("aiurdemux", NULL);
+  if (config->push)
+    queue = gst_element_factory_make ("queue", NULL);
+
+  if ((src == NULL) || (filter == NULL) || (demux == NULL)
+      || (config->push && (queue == NULL))) {
+    g_print ("Can not create elements, is aiurdemux available?\n");
+    goto done;
+  }
+
+  g_object_set (src, "location", stream, NULL);
+  if (config->max_image)
+    g_object_set (demux, "max-image-tag-size", config->max_image, NULL);
+  if (config->block_cache >= 0)
+    g_object_set (demux, "block-cache-blocks", config->block_cache, NULL);
+  if (config->read_delay) {
+    GstPad *srcpad = gst_element_get_static_pad (src, "src");
+    gst_pad_add_probe (srcpad,
+        GST_PAD_PROBE_TYPE_PULL | GST_PAD_PROBE_TYPE_BUFFER, delay_pull,
+        GUINT_TO_POINTER (config->read_delay), NULL);
+    gst_object_unref (srcpad);
+  }
+  caps = gst_caps_from_string (AIUR_SYNTH_MIME);
+  g_object_set (filter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, filter, demux, NULL);
+  if (queue) {
+    gst_bin_add (GST_BIN (pipeline), queue);
+    gst_element_link_many (src, filter, queue, demux, NULL);
+  } else {
+    gst_element_link_many (src, filter, demux, NULL);
+  }
+  src = filter = queue = NULL;
+
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added), &counter);
+
+  bus = gst_element_get_bus (pipeline);
+  if (config->check_startup) {
+    startup.demux = demux;
+    gst_bus_set_sync_handler (bus, startup_message, &startup, NULL);
+  }
+  start = g_get_monotonic_time ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  msg = gst_bus_timed_pop_filtered (bus,
+      config->timeout ? config->timeout * GST_SECOND : GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  result->seconds = (g_get_monotonic_time () - start) / 1000000.0;
+
+  if (msg == NULL) {
+    /* a stalled demuxer never posts EOS */
+    g_print ("No EOS after %u s, %" G_GUINT64_FORMAT " samples out\n",
+        config->timeout, counter.buffers);
+  } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    GError *err = NULL;
+    gst_message_parse_error (msg, &err, NULL);
+    g_print ("Error: %s\n", err->message);
+    g_error_free (err);
+  } else if (config->check_startup && !startup.seen) {
+    g_print ("No startup stats posted\n");
+  } else if (config->check_startup && !startup.ok) {
+    g_print ("Startup stats don't add up\n");
+  } else {
+    g_object_get (demux, "stats", &result->stats, NULL);
+    ret = (config->image == 0)
+        || check_image (config, demux, result->stats);
+  }
+  if (msg)
+    gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+  gst_object_unref (bus);
+
+  result->buffers = counter.buffers;
+  result->bytes = counter.bytes;
+
+done:
+  if (src)
+    gst_object_unref (src);
+  if (filter)
+    gst_object_unref (filter);
+  if (queue)
+    gst_object_unref (queue);
+  if (pipeline)
+    gst_object_unref (pipeline);
+  g_mutex_clear (&counter.lock);
+
+  return ret;
+}
+
+static gint
+compare_rate (gconstpointer a, gconstpointer b)
+{
+  const AiurBenchResult *ra = a, *rb = b;
+  gdouble rate_a = ra->buffers / MAX (ra->seconds, 1e-9);
+  gdouble rate_b = rb->buffers / MAX (rb->seconds, 1e-9);
+
+  return (rate_a > rate_b) - (rate_a < rate_b);
+}
+
+static void
+report (AiurBenchConfig * config, AiurBenchResult * result)
+{
+  const GstStructure *s = result->stats;
+
+  g_print ("aiurdemux %s mode, %u tracks x %u samples, %s sizes %u..%u, "
+      "fragment %u\n", config->push ? "push" : "pull", config->tracks,
+      config->samples, config->dist, config->min_size, config->max_size,
+      config->fragment);
+  g_print ("  samples/sec      : %.0f (%" G_GUINT64_FORMAT " samples in %.3f s)\n",
+      result->buffers / MAX (result->seconds, 1e-9), result->buffers,
+      result->seconds);
+  g_print ("  bytes out        : %" G_GUINT64_FORMAT "\n", result->bytes);
+  g_print ("  bytes read       : %" G_GUINT64_FORMAT " in %" G_GUINT64_FORMAT
+      " reads, %" G_GUINT64_FORMAT " seeks\n", stat_value (s, "read-bytes"),
+      stat_value (s, "reads"), stat_value (s, "seeks"));
+  g_print ("  buffer allocs    : %" G_GUINT64_FORMAT " (%" G_GUINT64_FORMAT
+      " recycled)\n", stat_value (s, "sample-pool-allocs")
+      + stat_value (s, "sample-pool-unpooled"),
+      stat_value (s, "sample-pool-recycles"));
+  g_print ("  core allocs      : %" G_GUINT64_FORMAT " (peak %" G_GUINT64_FORMAT
+      " bytes)\n", stat_value (s, "core-memory-small-allocs")
+      + stat_value (s, "core-memory-large-allocs"),
+      stat_value (s, "core-memory-peak"));
+  if (!config->push)
+    g_print ("  block cache      : %" G_GUINT64_FORMAT " hits, %" G_GUINT64_FORMAT
+        " misses, %" G_GUINT64_FORMAT " read-ahead (%" G_GUINT64_FORMAT
+        " used), %" G_GUINT64_FORMAT " bypass\n",
+        stat_value (s, "block-cache-hits"),
+        stat_value (s, "block-cache-misses"),
+        stat_value (s, "block-cache-readaheads"),
+        stat_value (s, "block-cache-readahead-hits"),
+        stat_value (s, "block-cache-bypass"));
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  AiurBenchConfig config;
+  AiurBenchResult *results;
+  gchar *dir, *registry, *stream, *gst_registry;
+  guint i;
+  gint ret = 1;
+
+  memset (&config, 0, sizeof (config));
+  if (!parse_options (&config, argc, argv)) {
+    g_print ("Usage: %s --core=PATH [OPTIONS]\n", argv[0]);
+    print_help ();
+    return 1;
+  }
+
+  dir = g_dir_make_tmp ("aiurbench-XXXXXX", NULL);
+  if (dir == NULL) {
+    g_print ("Can not create temporary directory\n");
+    return 1;
+  }
+  registry = g_build_filename (dir, "aiur_registry.cf", NULL);
+  stream = g_build_filename (dir, "stream.synth", NULL);
+  gst_registry = g_build_filename (dir, "registry.bin", NULL);
+
+  if (!write_registry (registry, config.core)
+      || !write_stream (stream, &config)) {
+    g_print ("Can not write benchmark files in %s\n", dir);
+    goto done;
+  }
+
+  /* aiurdemux reads its registry when the plugin is loaded, and the
+   * synthetic caps must not leak into the user plugin registry */
+  g_setenv ("AIUR_REGISTRY", registry, TRUE);
+  g_setenv ("GST_REGISTRY", gst_registry, TRUE);
+
+  gst_init (&argc, &argv);
+
+  if (config.plugin) {
+    GstPlugin *plugin = gst_plugin_load_file (config.plugin, NULL);
+    if (plugin == NULL) {
+      g_print ("Can not load %s\n", config.plugin);
+      goto done;
+    }
+    gst_object_unref (plugin);
+  }
+
+  results = g_new0 (AiurBenchResult, config.runs);
+  for (i = 0; i < config.runs; i++) {
+    if (!run_once (&config, stream, &results[i]))
+      break;
+    g_print ("run %u: %" G_GUINT64_FORMAT " samples in %.3f s\n", i + 1,
+        results[i].buffers, results[i].seconds);
+  }
+
+  if (i == config.runs) {
+    qsort (results, config.runs, sizeof (AiurBenchResult), compare_rate);
+    report (&config, &results[config.runs / 2]);
+    ret = 0;
+  }
+
+  for (i = 0; i < config.runs; i++) {
+    if (results[i].stats)
+      gst_structure_free (results[i].stats);
+  }
+  g_free (results);
+
+done:
+  g_unlink (stream);
+  g_unlink (registry);
+  g_unlink (gst_registry);
+  g_rmdir (dir);
+  g_free (stream);
+  g_free (registry);
+  g_free (gst_registry);
+  g_free (dir);
+
+  return ret;
+}
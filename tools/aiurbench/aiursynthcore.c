@@ -0,0 +1,968 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiursynthcore.c
+ *
+ * Description:    Synthetic parser core implementing FslParserQueryInterface.
+ *                 The file starts with a text header describing the tracks,
+ *                 the sample size distribution, the file mode interleave
+ *                 pattern and the fragment size, the rest is payload which
+ *                 is read through the stream callbacks into the output
+ *                 buffers. Sample sizes are a pure function of track and
+ *                 sample index, so runs are reproducible and seek is O(1).
+ *                 With image=BYTES the artwork user data is a JPEG of that
+ *                 size read from the start of the payload.
+ *
+ * Portability:    This code is written for Linux OS
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fsl_parser.h"
+#include "aiursynthcore.h"
+
+#define SYNTH_MAX_TRACKS 16
+
+#define SYNTH_VIDEO_DURATION 33333      /* us, 30 fps */
+#define SYNTH_AUDIO_DURATION 20000      /* us */
+
+typedef enum
+{
+  SYNTH_DIST_FIXED = 0,         /* every sample is max */
+  SYNTH_DIST_UNIFORM,           /* uniform in [min, max] */
+  SYNTH_DIST_GOP,               /* sync samples max, others in [min, max/8] */
+} SynthDist;
+
+typedef struct
+{
+  uint32 tracks;
+  uint32 samples;
+  uint32 min_size;
+  uint32 max_size;
+  SynthDist dist;
+  uint32 sync_interval;
+  uint32 fragment;
+  uint32 pattern[SYNTH_MAX_TRACKS];
+  int video;
+  int file_mode_only;
+  int64 payload;
+  uint32 image;
+} SynthConfig;
+
+typedef struct
+{
+  bool enabled;
+  uint32 index;                 /* next sample */
+  uint32 remain;                /* bytes left of a fragmented sample */
+  int64 offset;                 /* read position in track mode */
+  int64 region_start;
+  int64 region_size;
+} SynthTrack;
+
+typedef struct
+{
+  SynthConfig config;
+
+  FslFileStream stream;
+  ParserMemoryOps mem;
+  ParserOutputBufferOps bufops;
+  void *context;
+  FslFileHandle file;
+  int64 file_pos;
+
+  int64 data_start;
+  uint32 read_mode;
+
+  /* file mode */
+  int64 cursor;
+  uint32 pattern_pos;
+  uint32 pattern_left;
+  int32 partial_track;
+
+  uint8 *image;
+
+  SynthTrack track[SYNTH_MAX_TRACKS];
+} SynthParser;
+
+static const char *
+SynthGetVersionInfo ()
+{
+  return "Synthetic parser core " AIUR_SYNTH_MAGIC;
+}
+
+static int
+synth_parse_header (SynthConfig * config, char *header)
+{
+  char *token, *save = NULL;
+  uint32 i;
+
+  memset (config, 0, sizeof (SynthConfig));
+  config->tracks = 2;
+  config->samples = 1000;
+  config->min_size = 512;
+  config->max_size = 16384;
+  config->dist = SYNTH_DIST_UNIFORM;
+  config->sync_interval = 30;
+  config->video = 1;
+  for (i = 0; i < SYNTH_MAX_TRACKS; i++)
+    config->pattern[i] = 1;
+
+  token = strtok_r (header, " \t\n", &save);
+  if ((token == NULL) || strcmp (token, AIUR_SYNTH_MAGIC))
+    return -1;
+
+  while ((token = strtok_r (NULL, " \t\n", &save))) {
+    char *value = strchr (token, '=');
+    if (value == NULL)
+      continue;
+    *value++ = '\0';
+
+    if (!strcmp (token, "tracks"))
+      config->tracks = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "samples"))
+      config->samples = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "min"))
+      config->min_size = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "max"))
+      config->max_size = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "sync"))
+      config->sync_interval = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "fragment"))
+      config->fragment = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "video"))
+      config->video = atoi (value);
+    else if (!strcmp (token, "file-mode"))
+      config->file_mode_only = atoi (value);
+    else if (!strcmp (token, "payload"))
+      config->payload = strtoll (value, NULL, 0);
+    else if (!strcmp (token, "image"))
+      config->image = strtoul (value, NULL, 0);
+    else if (!strcmp (token, "dist")) {
+      if (!strcmp (value, "fixed"))
+        config->dist = SYNTH_DIST_FIXED;
+      else if (!strcmp (value, "gop"))
+        config->dist = SYNTH_DIST_GOP;
+      else
+        config->dist = SYNTH_DIST_UNIFORM;
+    } else if (!strcmp (token, "interleave")) {
+      char *p = value;
+      for (i = 0; (i < SYNTH_MAX_TRACKS) && (*p); i++) {
+        config->pattern[i] = strtoul (p, &p, 0);
+        if (config->pattern[i] == 0)
+          config->pattern[i] = 1;
+        if (*p == ',')
+          p++;
+      }
+    }
+  }
+
+  if ((config->tracks == 0) || (config->tracks > SYNTH_MAX_TRACKS))
+    return -1;
+  if (config->min_size == 0)
+    config->min_size = 1;
+  if (config->max_size < config->min_size)
+    config->max_size = config->min_size;
+  if (config->payload <= 0)
+    return -1;
+  /* room for the JPEG markers */
+  if ((config->image) && (config->image < 8))
+    config->image = 8;
+
+  return 0;
+}
+
+static bool
+synth_is_video (SynthParser * p, uint32 track)
+{
+  return (p->config.video && (track == 0));
+}
+
+static uint64
+synth_duration (SynthParser * p, uint32 track)
+{
+  return synth_is_video (p, track) ? SYNTH_VIDEO_DURATION :
+      SYNTH_AUDIO_DURATION;
+}
+
+static bool
+synth_is_sync (SynthParser * p, uint32 track, uint32 index)
+{
+  if ((!synth_is_video (p, track)) || (p->config.sync_interval <= 1))
+    return TRUE;
+  return ((index % p->config.sync_interval) == 0);
+}
+
+static uint32
+synth_hash (uint32 track, uint32 index)
+{
+  uint32 h = (index * 0x9e3779b1u) ^ ((track + 1) * 0x85ebca6bu);
+
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h;
+}
+
+static uint32
+synth_sample_size (SynthParser * p, uint32 track, uint32 index)
+{
+  SynthConfig *c = &p->config;
+  uint32 hi;
+
+  switch (c->dist) {
+    case SYNTH_DIST_FIXED:
+      return c->max_size;
+    case SYNTH_DIST_GOP:
+      if (synth_is_sync (p, track, index))
+        return c->max_size;
+      hi = c->max_size / 8;
+      if (hi < c->min_size)
+        hi = c->min_size;
+      return c->min_size + synth_hash (track, index) % (hi - c->min_size + 1);
+    default:
+      return c->min_size +
+          synth_hash (track, index) % (c->max_size - c->min_size + 1);
+  }
+}
+
+/* payload is anonymous, reads wrap inside [start, start + size) */
+static bool
+synth_read (SynthParser * p, int64 * pos, int64 start, int64 size,
+    uint8 * buffer, uint32 len)
+{
+  while (len) {
+    uint32 chunk = len;
+    uint32 got;
+
+    if (*pos >= start + size)
+      *pos = start;
+    if (*pos + chunk > start + size)
+      chunk = (uint32) (start + size - *pos);
+
+    if (*pos != p->file_pos) {
+      if (p->stream.Seek (p->file, *pos, FSL_SEEK_SET, p->context))
+        return FALSE;
+      p->file_pos = *pos;
+    }
+
+    got = p->stream.Read (p->file, buffer, chunk, p->context);
+    if (got == 0)
+      return FALSE;
+
+    p->file_pos += got;
+    *pos += got;
+    buffer += got;
+    len -= got;
+  }
+  return TRUE;
+}
+
+static int32
+synth_output (SynthParser * p, uint32 track, uint8 ** sampleBuffer,
+    void **bufferContext, uint32 * dataSize, uint64 * usStartTime,
+    uint64 * usDuration, uint32 * sampleFlags)
+{
+  SynthTrack *t = &p->track[track];
+  uint32 chunk, got;
+  uint8 *buffer;
+  void *context = NULL;
+  bool ok;
+
+  if (t->remain == 0) {
+    if (t->index >= p->config.samples)
+      return PARSER_EOS;
+    t->remain = synth_sample_size (p, track, t->index);
+  }
+
+  chunk = t->remain;
+  if ((p->config.fragment) && (chunk > p->config.fragment))
+    chunk = p->config.fragment;
+
+  got = chunk;
+  buffer = p->bufops.RequestBuffer (track, &got, &context, p->context);
+  if (buffer == NULL)
+    return PARSER_ERR_NO_OUTPUT_BUFFER;
+  if (got < chunk) {
+    p->bufops.ReleaseBuffer (track, buffer, context, p->context);
+    return PARSER_ERR_NO_OUTPUT_BUFFER;
+  }
+
+  if (p->read_mode == PARSER_READ_MODE_FILE_BASED)
+    ok = synth_read (p, &p->cursor, p->data_start, p->config.payload,
+        buffer, chunk);
+  else
+    ok = synth_read (p, &t->offset, t->region_start, t->region_size,
+        buffer, chunk);
+  if (!ok) {
+    p->bufops.ReleaseBuffer (track, buffer, context, p->context);
+    return PARSER_READ_ERROR;
+  }
+
+  *sampleBuffer = buffer;
+  *bufferContext = context;
+  *dataSize = chunk;
+  *usStartTime = t->index * synth_duration (p, track);
+  *usDuration = synth_duration (p, track);
+  *sampleFlags = synth_is_sync (p, track, t->index) ? FLAG_SYNC_SAMPLE : 0;
+
+  t->remain -= chunk;
+  if (t->remain) {
+    *sampleFlags |= FLAG_SAMPLE_NOT_FINISHED;
+    p->partial_track = track;
+  } else {
+    t->index++;
+    p->partial_track = -1;
+  }
+
+  return PARSER_SUCCESS;
+}
+
+/* reposition the payload read pointer as a real container would */
+static void
+synth_reposition (SynthParser * p, SynthTrack * t)
+{
+  t->offset = t->region_start +
+      ((int64) t->index * p->config.max_size) % t->region_size;
+}
+
+static int32
+SynthCreateParser2 (uint32 flags, FslFileStream * streamOps,
+    ParserMemoryOps * memOps, ParserOutputBufferOps * outputBufferOps,
+    void *context, FslParserHandle * parserHandle)
+{
+  SynthParser *p;
+  char header[AIUR_SYNTH_HEADER_SIZE + 1];
+  uint32 i;
+
+  if ((streamOps == NULL) || (memOps == NULL) || (outputBufferOps == NULL)
+      || (parserHandle == NULL))
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  p = memOps->Calloc (1, sizeof (SynthParser));
+  if (p == NULL)
+    return PARSER_INSUFFICIENT_MEMORY;
+
+  p->stream = *streamOps;
+  p->mem = *memOps;
+  p->bufops = *outputBufferOps;
+  p->context = context;
+  p->partial_track = -1;
+
+  p->file = p->stream.Open (NULL, (const uint8 *) "rb", context);
+  if (p->file == NULL) {
+    p->mem.Free (p);
+    return PARSER_FILE_OPEN_ERROR;
+  }
+
+  memset (header, 0, sizeof (header));
+  if ((p->stream.Read (p->file, header, AIUR_SYNTH_HEADER_SIZE, context)
+          != AIUR_SYNTH_HEADER_SIZE)
+      || synth_parse_header (&p->config, header)) {
+    p->stream.Close (p->file, context);
+    p->mem.Free (p);
+    return PARSER_ERR_INVALID_MEDIA;
+  }
+  p->file_pos = AIUR_SYNTH_HEADER_SIZE;
+  p->data_start = AIUR_SYNTH_HEADER_SIZE;
+  p->cursor = p->data_start;
+
+  /* file mode starts with the first pattern entry */
+  p->pattern_pos = p->config.tracks - 1;
+  p->pattern_left = 0;
+
+  /* in track mode every track reads its own part of the payload */
+  for (i = 0; i < p->config.tracks; i++) {
+    SynthTrack *t = &p->track[i];
+    t->region_size = p->config.payload / p->config.tracks;
+    if (t->region_size == 0)
+      t->region_size = p->config.payload;
+    t->region_start = p->data_start +
+        (t->region_size == p->config.payload ? 0 : i * t->region_size);
+    t->offset = t->region_start;
+  }
+
+  p->read_mode = PARSER_READ_MODE_FILE_BASED;
+  *parserHandle = p;
+
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthCreateParser (bool isLive, FslFileStream * streamOps,
+    ParserMemoryOps * memOps, ParserOutputBufferOps * outputBufferOps,
+    void *context, FslParserHandle * parserHandle)
+{
+  return SynthCreateParser2 (isLive ? FILE_FLAG_NON_SEEKABLE : 0, streamOps,
+      memOps, outputBufferOps, context, parserHandle);
+}
+
+static int32
+SynthDeleteParser (FslParserHandle parserHandle)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (p == NULL)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  p->stream.Close (p->file, p->context);
+  if (p->image)
+    p->mem.Free (p->image);
+  p->mem.Free (p);
+
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthIsSeekable (FslParserHandle parserHandle, bool * seekable)
+{
+  *seekable = TRUE;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetTrackDuration (FslParserHandle parserHandle, uint32 trackNum,
+    uint64 * usDuration)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  *usDuration = (uint64) p->config.samples * synth_duration (p, trackNum);
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetMovieDuration (FslParserHandle parserHandle, uint64 * usDuration)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+  uint64 duration;
+  uint32 i;
+
+  *usDuration = 0;
+  for (i = 0; i < p->config.tracks; i++) {
+    SynthGetTrackDuration (parserHandle, i, &duration);
+    if (duration > *usDuration)
+      *usDuration = duration;
+  }
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetNumTracks (FslParserHandle parserHandle, uint32 * numTracks)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  *numTracks = p->config.tracks;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetTrackType (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * mediaType, uint32 * decoderType, uint32 * decoderSubtype)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  if (synth_is_video (p, trackNum)) {
+    *mediaType = MEDIA_VIDEO;
+    *decoderType = VIDEO_H264;
+    *decoderSubtype = 0;
+  } else {
+    *mediaType = MEDIA_AUDIO;
+    *decoderType = AUDIO_PCM;
+    *decoderSubtype = AUDIO_PCM_S16LE;
+  }
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetBitRate (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * bitrate)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+  uint64 average;
+
+  average = ((uint64) p->config.min_size + p->config.max_size) / 2;
+  *bitrate = (uint32) (average * 8 * 1000000 / synth_duration (p, trackNum));
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetDecSpecificInfo (FslParserHandle parserHandle, uint32 trackNum,
+    uint8 ** data, uint32 * size)
+{
+  *data = NULL;
+  *size = 0;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetVideoFrameWidth (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * width)
+{
+  *width = 1920;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetVideoFrameHeight (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * height)
+{
+  *height = 1080;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetVideoFrameRate (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * rate, uint32 * scale)
+{
+  *rate = 1000000;
+  *scale = SYNTH_VIDEO_DURATION;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetAudioNumChannels (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * numchannels)
+{
+  *numchannels = 2;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetAudioSampleRate (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * sampleRate)
+{
+  *sampleRate = 48000;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetAudioBitsPerSample (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * bitsPerSample)
+{
+  *bitsPerSample = 16;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetAudioBlockAlign (FslParserHandle parserHandle, uint32 trackNum,
+    uint32 * blockAlign)
+{
+  *blockAlign = 4;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetReadMode (FslParserHandle parserHandle, uint32 * readMode)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  *readMode = p->read_mode;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthSetReadMode (FslParserHandle parserHandle, uint32 readMode)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if ((readMode != PARSER_READ_MODE_FILE_BASED)
+      && ((readMode != PARSER_READ_MODE_TRACK_BASED)
+          || (p->config.file_mode_only)))
+    return PARSER_ERR_INVALID_READ_MODE;
+
+  p->read_mode = readMode;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthEnableTrack (FslParserHandle parserHandle, uint32 trackNum, bool enable)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  p->track[trackNum].enabled = enable;
+  if ((!enable) && (p->partial_track == (int32) trackNum)) {
+    p->track[trackNum].remain = 0;
+    p->partial_track = -1;
+  }
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthGetNextSample (FslParserHandle parserHandle, uint32 trackNum,
+    uint8 ** sampleBuffer, void **bufferContext, uint32 * dataSize,
+    uint64 * usStartTime, uint64 * usDuration, uint32 * sampleFlags)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (p->read_mode != PARSER_READ_MODE_TRACK_BASED)
+    return PARSER_ERR_INVALID_READ_MODE;
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+  if (!p->track[trackNum].enabled)
+    return PARSER_ERR_TRACK_DISABLED;
+
+  return synth_output (p, trackNum, sampleBuffer, bufferContext, dataSize,
+      usStartTime, usDuration, sampleFlags);
+}
+
+/* pick the track of the next sample following the interleave pattern */
+static int32
+synth_next_track (SynthParser * p, uint32 * trackNum)
+{
+  uint32 i;
+
+  if (p->partial_track >= 0) {
+    *trackNum = p->partial_track;
+    return PARSER_SUCCESS;
+  }
+
+  for (i = 0; i <= p->config.tracks; i++) {
+    SynthTrack *t;
+
+    if (p->pattern_left == 0) {
+      p->pattern_pos = (p->pattern_pos + 1) % p->config.tracks;
+      p->pattern_left = p->config.pattern[p->pattern_pos];
+    }
+
+    t = &p->track[p->pattern_pos];
+    if ((t->enabled) && (t->index < p->config.samples)) {
+      *trackNum = p->pattern_pos;
+      return PARSER_SUCCESS;
+    }
+    p->pattern_left = 0;
+  }
+
+  return PARSER_EOS;
+}
+
+static int32
+SynthGetFileNextSample (FslParserHandle parserHandle, uint32 * trackNum,
+    uint8 ** sampleBuffer, void **bufferContext, uint32 * dataSize,
+    uint64 * usStartTime, uint64 * usDuration, uint32 * sampleFlags)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+  int32 ret;
+
+  if (p->read_mode != PARSER_READ_MODE_FILE_BASED)
+    return PARSER_ERR_INVALID_READ_MODE;
+
+  ret = synth_next_track (p, trackNum);
+  if (ret != PARSER_SUCCESS)
+    return ret;
+
+  ret = synth_output (p, *trackNum, sampleBuffer, bufferContext, dataSize,
+      usStartTime, usDuration, sampleFlags);
+  if ((ret == PARSER_SUCCESS) && (p->partial_track < 0)
+      && (p->pattern_left))
+    p->pattern_left--;
+
+  return ret;
+}
+
+static int32
+synth_sync_sample (SynthParser * p, uint32 direction, uint32 track,
+    uint8 ** sampleBuffer, void **bufferContext, uint32 * dataSize,
+    uint64 * usStartTime, uint64 * usDuration, uint32 * flags)
+{
+  SynthTrack *t = &p->track[track];
+  uint32 interval = synth_is_video (p, track) ? p->config.sync_interval : 1;
+  uint32 target;
+  int32 ret;
+
+  if (interval == 0)
+    interval = 1;
+
+  if (t->remain == 0) {
+    if (direction == FLAG_FORWARD) {
+      target = ((t->index + interval - 1) / interval) * interval;
+      if (target >= p->config.samples)
+        return PARSER_EOS;
+    } else {
+      if (t->index == 0)
+        return PARSER_BOS;
+      target = ((t->index - 1) / interval) * interval;
+    }
+    if (target != t->index) {
+      t->index = target;
+      synth_reposition (p, t);
+      p->cursor = t->offset;
+    }
+  }
+
+  ret = synth_output (p, track, sampleBuffer, bufferContext, dataSize,
+      usStartTime, usDuration, flags);
+
+  /* backward steps start from the sample just output */
+  if ((ret == PARSER_SUCCESS) && (t->remain == 0)
+      && (direction != FLAG_FORWARD))
+    t->index--;
+
+  return ret;
+}
+
+static int32
+SynthGetNextSyncSample (FslParserHandle parserHandle, uint32 direction,
+    uint32 trackNum, uint8 ** sampleBuffer, void **bufferContext,
+    uint32 * dataSize, uint64 * usStartTime, uint64 * usDuration,
+    uint32 * flags)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+  if (!p->track[trackNum].enabled)
+    return PARSER_ERR_TRACK_DISABLED;
+
+  return synth_sync_sample (p, direction, trackNum, sampleBuffer,
+      bufferContext, dataSize, usStartTime, usDuration, flags);
+}
+
+static int32
+SynthGetFileNextSyncSample (FslParserHandle parserHandle, uint32 direction,
+    uint32 * trackNum, uint8 ** sampleBuffer, void **bufferContext,
+    uint32 * dataSize, uint64 * usStartTime, uint64 * usDuration,
+    uint32 * flags)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+  uint32 i;
+
+  /* trick mode only runs on the first enabled track */
+  for (i = 0; i < p->config.tracks; i++) {
+    if (p->track[i].enabled)
+      break;
+  }
+  if (i == p->config.tracks)
+    return PARSER_EOS;
+
+  *trackNum = i;
+  return synth_sync_sample (p, direction, i, sampleBuffer, bufferContext,
+      dataSize, usStartTime, usDuration, flags);
+}
+
+static int32
+SynthSeek (FslParserHandle parserHandle, uint32 trackNum, uint64 * usTime,
+    uint32 flag)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+  SynthTrack *t;
+  uint64 duration;
+  uint32 interval;
+  uint64 index;
+
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  t = &p->track[trackNum];
+  duration = synth_duration (p, trackNum);
+  interval = synth_is_video (p, trackNum) ? p->config.sync_interval : 1;
+  if (interval == 0)
+    interval = 1;
+
+  index = *usTime / duration;
+  if ((flag == SEEK_FLAG_NO_EARLIER) && (index * duration < *usTime))
+    index++;
+  index = (index / interval) * interval;
+  if ((flag == SEEK_FLAG_NO_EARLIER) && (index * duration < *usTime))
+    index += interval;
+  if (index > p->config.samples)
+    index = p->config.samples;
+
+  t->index = (uint32) index;
+  t->remain = 0;
+  synth_reposition (p, t);
+  *usTime = index * duration;
+
+  /* file mode restarts the pattern at the new position */
+  p->cursor = t->offset;
+  p->partial_track = -1;
+  p->pattern_pos = p->config.tracks - 1;
+  p->pattern_left = 0;
+
+  return PARSER_SUCCESS;
+}
+
+/* only the artwork is there, read through the stream like a real
+ * container reads an embedded image */
+static int32
+SynthGetMetaData (FslParserHandle parserHandle, UserDataID userDataId,
+    UserDataFormat * userDataFormat, uint8 ** userData,
+    uint32 * userDataLength)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+  uint32 size = p->config.image;
+  int64 pos = p->data_start;
+
+  *userData = NULL;
+  *userDataLength = 0;
+  if ((userDataId != USER_DATA_ARTWORK) || (size == 0))
+    return PARSER_SUCCESS;
+
+  if (p->image == NULL) {
+    uint8 *image = p->mem.Malloc (size);
+
+    if (image == NULL)
+      return PARSER_INSUFFICIENT_MEMORY;
+    if (!synth_read (p, &pos, p->data_start, p->config.payload, image, size)) {
+      p->mem.Free (image);
+      return PARSER_READ_ERROR;
+    }
+    /* SOI and APP0, EOI at the end */
+    image[0] = 0xff;
+    image[1] = 0xd8;
+    image[2] = 0xff;
+    image[3] = 0xe0;
+    image[size - 2] = 0xff;
+    image[size - 1] = 0xd9;
+    p->image = image;
+  }
+
+  *userDataFormat = USER_DATA_FORMAT_JPEG;
+  *userData = p->image;
+  *userDataLength = size;
+  return PARSER_SUCCESS;
+}
+
+static int32
+SynthFlushTrack (FslParserHandle parserHandle, uint32 trackNum)
+{
+  SynthParser *p = (SynthParser *) parserHandle;
+
+  if (trackNum >= p->config.tracks)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  p->track[trackNum].remain = 0;
+  if (p->partial_track == (int32) trackNum)
+    p->partial_track = -1;
+
+  return PARSER_SUCCESS;
+}
+
+int32
+FslParserQueryInterface (uint32 id, void **func)
+{
+  if (func == NULL)
+    return PARSER_ERR_INVALID_PARAMETER;
+
+  switch (id) {
+    case PARSER_API_GET_VERSION_INFO:
+      *func = (void *) SynthGetVersionInfo;
+      break;
+    case PARSER_API_CREATE_PARSER:
+      *func = (void *) SynthCreateParser;
+      break;
+    case PARSER_API_CREATE_PARSER2:
+      *func = (void *) SynthCreateParser2;
+      break;
+    case PARSER_API_DELETE_PARSER:
+      *func = (void *) SynthDeleteParser;
+      break;
+    case PARSER_API_IS_MOVIE_SEEKABLE:
+      *func = (void *) SynthIsSeekable;
+      break;
+    case PARSER_API_GET_MOVIE_DURATION:
+      *func = (void *) SynthGetMovieDuration;
+      break;
+    case PARSER_API_GET_NUM_TRACKS:
+      *func = (void *) SynthGetNumTracks;
+      break;
+    case PARSER_API_GET_TRACK_TYPE:
+      *func = (void *) SynthGetTrackType;
+      break;
+    case PARSER_API_GET_TRACK_DURATION:
+      *func = (void *) SynthGetTrackDuration;
+      break;
+    case PARSER_API_GET_BITRATE:
+      *func = (void *) SynthGetBitRate;
+      break;
+    case PARSER_API_GET_DECODER_SPECIFIC_INFO:
+      *func = (void *) SynthGetDecSpecificInfo;
+      break;
+    case PARSER_API_GET_VIDEO_FRAME_WIDTH:
+      *func = (void *) SynthGetVideoFrameWidth;
+      break;
+    case PARSER_API_GET_VIDEO_FRAME_HEIGHT:
+      *func = (void *) SynthGetVideoFrameHeight;
+      break;
+    case PARSER_API_GET_VIDEO_FRAME_RATE:
+      *func = (void *) SynthGetVideoFrameRate;
+      break;
+    case PARSER_API_GET_AUDIO_NUM_CHANNELS:
+      *func = (void *) SynthGetAudioNumChannels;
+      break;
+    case PARSER_API_GET_AUDIO_SAMPLE_RATE:
+      *func = (void *) SynthGetAudioSampleRate;
+      break;
+    case PARSER_API_GET_AUDIO_BITS_PER_SAMPLE:
+      *func = (void *) SynthGetAudioBitsPerSample;
+      break;
+    case PARSER_API_GET_AUDIO_BLOCK_ALIGN:
+      *func = (void *) SynthGetAudioBlockAlign;
+      break;
+    case PARSER_API_GET_READ_MODE:
+      *func = (void *) SynthGetReadMode;
+      break;
+    case PARSER_API_SET_READ_MODE:
+      *func = (void *) SynthSetReadMode;
+      break;
+    case PARSER_API_ENABLE_TRACK:
+      *func = (void *) SynthEnableTrack;
+      break;
+    case PARSER_API_GET_NEXT_SAMPLE:
+      *func = (void *) SynthGetNextSample;
+      break;
+    case PARSER_API_GET_NEXT_SYNC_SAMPLE:
+      *func = (void *) SynthGetNextSyncSample;
+      break;
+    case PARSER_API_GET_FILE_NEXT_SAMPLE:
+      *func = (void *) SynthGetFileNextSample;
+      break;
+    case PARSER_API_GET_FILE_NEXT_SYNC_SAMPLE:
+      *func = (void *) SynthGetFileNextSyncSample;
+      break;
+    case PARSER_API_SEEK:
+      *func = (void *) SynthSeek;
+      break;
+    case PARSER_API_FLUSH_TRACK:
+      *func = (void *) SynthFlushTrack;
+      break;
+    case PARSER_API_GET_META_DATA:
+      *func = (void *) SynthGetMetaData;
+      break;
+    default:
+      *func = NULL;
+      break;
+  }
+
+  return PARSER_SUCCESS;
+}
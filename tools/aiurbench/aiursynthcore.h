@@ -0,0 +1,45 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiursynthcore.h
+ *
+ * Description:    File layout shared by the synthetic parser core and
+ *                 the aiurdemux benchmark
+ *
+ * Portability:    This code is written for Linux OS
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __AIURSYNTHCORE_H__
+#define __AIURSYNTHCORE_H__
+
+/* caps the core is registered for in the aiur registry */
+#define AIUR_SYNTH_MIME "application/x-aiur-synthetic"
+
+/* the file starts with a space padded text header of this size:
+ *   AIURSYNTH1 tracks=3 samples=2000 min=256 max=65536 dist=uniform
+ *       sync=30 interleave=4,1,1 fragment=0 video=1 file-mode=0
+ *       payload=8388608 image=0
+ * the payload follows the header */
+#define AIUR_SYNTH_MAGIC "AIURSYNTH1"
+#define AIUR_SYNTH_HEADER_SIZE 512
+
+#endif /* __AIURSYNTHCORE_H__ */
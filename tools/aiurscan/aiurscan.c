@@ -0,0 +1,275 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Module Name:    aiurscan.c
+ *
+ * Description:    Media library scanner. Probes the stream info of many
+ *                 files with the aiur parser cores on a pool of worker
+ *                 threads, no pipeline is built, and reports files/sec.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+
+#include "fsl_parser.h"
+#include "aiurprobe.h"
+
+GST_DEBUG_CATEGORY (aiurdemux_debug);
+
+typedef struct
+{
+  guint jobs;
+  guint cache;
+  guint quiet;
+} AiurScanConfig;
+
+typedef struct
+{
+  gchar *location;
+  AiurProbeInfo *info;
+} AiurScanItem;
+
+static void
+print_help ()
+{
+  g_print ("options :\n");
+  g_print ("    --jobs=N            Worker threads, 0 for one per cpu (default 0)\n");
+  g_print ("    --cache=0|1         Use the probe cache next to the index files (default 1)\n");
+  g_print ("    --quiet=0|1         Print the summary only (default 0)\n");
+}
+
+/* returns index of the first path argument, -1 on error */
+static gint
+parse_options (AiurScanConfig * config, gint argc, gchar * argv[])
+{
+  struct
+  {
+    const gchar *name;
+    guint *uint_value;
+  } table[] = {
+    {"--jobs", &config->jobs},
+    {"--cache", &config->cache},
+    {"--quiet", &config->quiet},
+  };
+  gint i, j;
+
+  config->jobs = 0;
+  config->cache = 1;
+  config->quiet = 0;
+
+  for (i = 1; i < argc; i++) {
+    gchar *value = strchr (argv[i], '=');
+    gsize len = value ? (gsize) (value - argv[i]) : strlen (argv[i]);
+
+    if ((strcmp (argv[i], "-h") == 0) || (strcmp (argv[i], "--help") == 0))
+      return -1;
+
+    if (strncmp (argv[i], "--", 2) != 0)
+      break;
+
+    for (j = 0; j < G_N_ELEMENTS (table); j++) {
+      if ((strlen (table[j].name) == len)
+          && (strncmp (argv[i], table[j].name, len) == 0))
+        break;
+    }
+    if ((j == G_N_ELEMENTS (table)) || (value == NULL)) {
+      g_print ("Unknown option %s\n", argv[i]);
+      return -1;
+    }
+
+    *table[j].uint_value = strtoul (value + 1, NULL, 0);
+  }
+
+  if (i == argc) {
+    g_print ("No file or directory given\n");
+    return -1;
+  }
+  if (config->jobs == 0)
+    config->jobs = g_get_num_processors ();
+
+  return i;
+}
+
+/* regular files of path, directories are walked recursively */
+static void
+collect_files (const gchar * path, GPtrArray * items)
+{
+  GDir *dir;
+  const gchar *name;
+
+  if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
+    AiurScanItem *item = g_new0 (AiurScanItem, 1);
+    item->location = g_strdup (path);
+    g_ptr_array_add (items, item);
+    return;
+  }
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (dir))) {
+    gchar *child = g_build_filename (path, name, NULL);
+    if (!g_file_test (child, G_FILE_TEST_IS_SYMLINK))
+      collect_files (child, items);
+    g_free (child);
+  }
+  g_dir_close (dir);
+}
+
+static void
+probe_item (gpointer data, gpointer user_data)
+{
+  AiurScanItem *item = (AiurScanItem *) data;
+  AiurScanConfig *config = (AiurScanConfig *) user_data;
+
+  item->info = aiur_probe_file (item->location, config->cache);
+}
+
+static const gchar *
+track_type_name (guint32 type)
+{
+  switch (type) {
+    case MEDIA_VIDEO:
+      return "video";
+    case MEDIA_AUDIO:
+      return "audio";
+    case MEDIA_TEXT:
+      return "text";
+    default:
+      return "other";
+  }
+}
+
+static void
+print_item (AiurScanItem * item)
+{
+  AiurProbeInfo *info = item->info;
+  guint i;
+
+  if (info == NULL) {
+    g_print ("%s: not recognized\n", item->location);
+    return;
+  }
+
+  g_print ("%s: %s %" GST_TIME_FORMAT "%s, %u tracks%s\n", item->location,
+      info->mime, GST_TIME_ARGS (info->duration),
+      info->seekable ? " seekable" : "", info->n_tracks,
+      info->cached ? " (cached)" : "");
+
+  for (i = 0; i < info->n_tracks; i++) {
+    AiurProbeTrack *track = &info->tracks[i];
+
+    g_print ("  track %u: %s codec %u/%u", i, track_type_name (track->type),
+        track->codec_type, track->codec_sub_type);
+    if (track->type == MEDIA_VIDEO)
+      g_print (" %ux%u %u/%u fps", track->width, track->height,
+          track->fps_n, track->fps_d);
+    else if (track->type == MEDIA_AUDIO)
+      g_print (" %u ch %u Hz %u bits", track->channels, track->rate,
+          track->depth);
+    if (track->lang[0])
+      g_print (" %s", track->lang);
+    if (track->bitrate)
+      g_print (" %u bps", track->bitrate);
+    g_print ("\n");
+  }
+
+  if (info->tags) {
+    gchar *tags = gst_tag_list_to_string (info->tags);
+    g_print ("  tags: %s\n", tags);
+    g_free (tags);
+  }
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  AiurScanConfig config;
+  GThreadPool *pool;
+  GPtrArray *items;
+  gint64 start;
+  gdouble seconds;
+  guint cached = 0, unknown = 0;
+  gint first, i;
+
+  memset (&config, 0, sizeof (config));
+  first = parse_options (&config, argc, argv);
+  if (first < 0) {
+    g_print ("Usage: %s [OPTIONS] FILE|DIRECTORY...\n", argv[0]);
+    print_help ();
+    return 1;
+  }
+
+  gst_init (NULL, NULL);
+  GST_DEBUG_CATEGORY_INIT (aiurdemux_debug, "aiurdemux", 0, "aiur probe");
+
+  if (!aiur_probe_init ()) {
+    g_print ("No parser core registered\n");
+    return 1;
+  }
+
+  items = g_ptr_array_new ();
+  for (i = first; i < argc; i++)
+    collect_files (argv[i], items);
+
+  start = g_get_monotonic_time ();
+
+  pool = g_thread_pool_new (probe_item, &config, config.jobs, TRUE, NULL);
+  for (i = 0; i < items->len; i++)
+    g_thread_pool_push (pool, g_ptr_array_index (items, i), NULL);
+  /* waits for every queued probe */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  seconds = (g_get_monotonic_time () - start) / 1000000.0;
+
+  for (i = 0; i < items->len; i++) {
+    AiurScanItem *item = g_ptr_array_index (items, i);
+
+    if (!config.quiet)
+      print_item (item);
+
+    if (item->info == NULL)
+      unknown++;
+    else if (item->info->cached)
+      cached++;
+
+    aiur_probe_info_free (item->info);
+    g_free (item->location);
+    g_free (item);
+  }
+
+  g_print ("aiurscan %u jobs, probe cache %s\n", config.jobs,
+      config.cache ? "on" : "off");
+  g_print ("  files/sec        : %.1f (%u files in %.3f s)\n",
+      items->len / MAX (seconds, 1e-9), items->len, seconds);
+  g_print ("  from cache       : %u\n", cached);
+  g_print ("  not recognized   : %u\n", unknown);
+
+  g_ptr_array_free (items, TRUE);
+
+  return 0;
+}
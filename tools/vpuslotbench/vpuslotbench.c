@@ -0,0 +1,441 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    vpuslotbench.c
+ *
+ * Description:    Microbenchmark of the per frame bookkeeping of the VPU
+ *                 decoder. A fake VPU wrapper decodes into a set of
+ *                 framebuffers, outputs them out of order from a reorder
+ *                 window and gets them back after downstream held them;
+ *                 the list/hash bookkeeping the decoder used before is
+ *                 timed against GstVpuDecSlots.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gst/gst.h>
+
+#include "gstvpudecslots.h"
+
+typedef struct
+{
+  guint frames;
+  guint buffers;
+  guint reorder;
+  guint hold;
+} VpuSlotBenchConfig;
+
+/* stands for VpuFrameBuffer, the VPU reports frames by pbufVirtY */
+typedef struct
+{
+  guint8 *pbufVirtY;
+} FakeFrameBuffer;
+
+typedef struct
+{
+  FakeFrameBuffer *frames;
+  GstBuffer **buffers;
+  guint n;
+
+  /* framebuffers free to decode into, decoded ones waiting for reorder
+   * and the ones downstream holds, as framebuffer indices */
+  guint *free_fbs;
+  guint n_free;
+  guint *reorder_fbs;
+  guint n_reorder;
+  guint *held_fbs;
+  guint n_held;
+
+  guint32 seed;
+} FakeVpu;
+
+/* bookkeeping under test, called like the decoder calls it */
+typedef struct
+{
+  const gchar *name;
+  void (*init) (gpointer priv, FakeVpu * vpu);
+  void (*input) (gpointer priv, guint32 number);
+  guint (*in_vpu) (gpointer priv);
+  GstBuffer *(*output) (gpointer priv, FakeFrameBuffer * frame,
+      guint32 * number);
+  FakeFrameBuffer *(*release) (gpointer priv, GstBuffer * buffer);
+  void (*clear) (gpointer priv);
+} Bookkeeping;
+
+/* legacy: GList and GHashTable as send_output had them */
+typedef struct
+{
+  GHashTable *frame2gstbuffer_table;
+  GHashTable *gstbuffer2frame_table;
+  GList *system_frame_number_in_vpu;
+  GList *gstbuffer_in_vpudec;
+} LegacyState;
+
+static void
+legacy_init (gpointer priv, FakeVpu * vpu)
+{
+  LegacyState *s = priv;
+  guint i;
+
+  s->frame2gstbuffer_table = g_hash_table_new (NULL, NULL);
+  s->gstbuffer2frame_table = g_hash_table_new (NULL, NULL);
+  s->system_frame_number_in_vpu = NULL;
+  s->gstbuffer_in_vpudec = NULL;
+
+  for (i = 0; i < vpu->n; i++) {
+    s->gstbuffer_in_vpudec = g_list_append (s->gstbuffer_in_vpudec,
+        gst_buffer_ref (vpu->buffers[i]));
+    g_hash_table_replace (s->frame2gstbuffer_table,
+        vpu->frames[i].pbufVirtY, vpu->buffers[i]);
+    g_hash_table_replace (s->gstbuffer2frame_table, vpu->buffers[i],
+        &vpu->frames[i]);
+  }
+}
+
+static void
+legacy_input (gpointer priv, guint32 number)
+{
+  LegacyState *s = priv;
+
+  s->system_frame_number_in_vpu =
+      g_list_append (s->system_frame_number_in_vpu,
+      GUINT_TO_POINTER (number));
+}
+
+static guint
+legacy_in_vpu (gpointer priv)
+{
+  LegacyState *s = priv;
+
+  return g_list_length (s->gstbuffer_in_vpudec);
+}
+
+static GstBuffer *
+legacy_output (gpointer priv, FakeFrameBuffer * frame, guint32 * number)
+{
+  LegacyState *s = priv;
+  gpointer n;
+  GstBuffer *buffer;
+
+  n = g_list_nth_data (s->system_frame_number_in_vpu, 0);
+  *number = GPOINTER_TO_UINT (n);
+  s->system_frame_number_in_vpu =
+      g_list_remove (s->system_frame_number_in_vpu, n);
+  /* latency estimate of send_output */
+  (void) g_list_length (s->system_frame_number_in_vpu);
+
+  buffer = g_hash_table_lookup (s->frame2gstbuffer_table, frame->pbufVirtY);
+  g_hash_table_replace (s->gstbuffer2frame_table, buffer, frame);
+  s->gstbuffer_in_vpudec = g_list_remove (s->gstbuffer_in_vpudec, buffer);
+
+  return buffer;
+}
+
+static FakeFrameBuffer *
+legacy_release (gpointer priv, GstBuffer * buffer)
+{
+  LegacyState *s = priv;
+
+  s->gstbuffer_in_vpudec = g_list_append (s->gstbuffer_in_vpudec, buffer);
+  return g_hash_table_lookup (s->gstbuffer2frame_table, buffer);
+}
+
+static void
+legacy_clear (gpointer priv)
+{
+  LegacyState *s = priv;
+
+  g_list_foreach (s->gstbuffer_in_vpudec, (GFunc) gst_buffer_unref, NULL);
+  g_list_free (s->gstbuffer_in_vpudec);
+  g_list_free (s->system_frame_number_in_vpu);
+  g_hash_table_destroy (s->frame2gstbuffer_table);
+  g_hash_table_destroy (s->gstbuffer2frame_table);
+}
+
+/* slots */
+static void
+slots_init (gpointer priv, FakeVpu * vpu)
+{
+  GstVpuDecSlots *s = priv;
+  guint i;
+
+  gst_vpu_dec_slots_init (s);
+  gst_vpu_dec_slots_register (s, vpu->n);
+  for (i = 0; i < vpu->n; i++)
+    gst_vpu_dec_slots_set (s, i, gst_buffer_ref (vpu->buffers[i]),
+        &vpu->frames[i], vpu->frames[i].pbufVirtY);
+}
+
+static void
+slots_input (gpointer priv, guint32 number)
+{
+  gst_vpu_dec_slots_push_number (priv, number);
+}
+
+static guint
+slots_in_vpu (gpointer priv)
+{
+  return GST_VPU_DEC_SLOTS_IN_VPU ((GstVpuDecSlots *) priv);
+}
+
+static GstBuffer *
+slots_output (gpointer priv, FakeFrameBuffer * frame, guint32 * number)
+{
+  GstVpuDecSlots *s = priv;
+  gint index;
+
+  gst_vpu_dec_slots_pop_number (s, number);
+  (void) GST_VPU_DEC_SLOTS_N_NUMBERS (s);
+
+  index = gst_vpu_dec_slots_find_addr (s, frame->pbufVirtY);
+  if (index < 0)
+    return NULL;
+  s->slots[index].frame = frame;
+  return gst_vpu_dec_slots_take (s, index);
+}
+
+static FakeFrameBuffer *
+slots_release (gpointer priv, GstBuffer * buffer)
+{
+  GstVpuDecSlots *s = priv;
+  gint index;
+
+  index = gst_vpu_dec_slots_find_buffer (s, buffer);
+  if (index < 0)
+    return NULL;
+  gst_vpu_dec_slots_give (s, index);
+  return s->slots[index].frame;
+}
+
+static void
+slots_clear (gpointer priv)
+{
+  gst_vpu_dec_slots_free (priv);
+}
+
+static guint32
+fake_vpu_random (FakeVpu * vpu)
+{
+  vpu->seed = vpu->seed * 1664525u + 1013904223u;
+  return vpu->seed >> 8;
+}
+
+static void
+fake_vpu_init (FakeVpu * vpu, VpuSlotBenchConfig * config)
+{
+  guint i;
+
+  memset (vpu, 0, sizeof (FakeVpu));
+  vpu->n = config->buffers;
+  vpu->frames = g_new0 (FakeFrameBuffer, vpu->n);
+  vpu->buffers = g_new0 (GstBuffer *, vpu->n);
+  vpu->free_fbs = g_new0 (guint, vpu->n);
+  vpu->reorder_fbs = g_new0 (guint, vpu->n);
+  vpu->held_fbs = g_new0 (guint, vpu->n);
+  vpu->seed = 1;
+
+  for (i = 0; i < vpu->n; i++) {
+    /* addresses spaced like real framebuffers */
+    vpu->frames[i].pbufVirtY = (guint8 *) (0x70000000u + i * 0x300000u);
+    vpu->buffers[i] = gst_buffer_new ();
+    vpu->free_fbs[vpu->n_free++] = i;
+  }
+}
+
+static void
+fake_vpu_clear (FakeVpu * vpu)
+{
+  guint i;
+
+  for (i = 0; i < vpu->n; i++)
+    gst_buffer_unref (vpu->buffers[i]);
+  g_free (vpu->frames);
+  g_free (vpu->buffers);
+  g_free (vpu->free_fbs);
+  g_free (vpu->reorder_fbs);
+  g_free (vpu->held_fbs);
+}
+
+/* returns ns per frame, 0 on a bookkeeping mismatch */
+static gdouble
+run (const Bookkeeping * bk, gpointer priv, VpuSlotBenchConfig * config,
+    guint64 * checksum)
+{
+  FakeVpu vpu;
+  guint32 next = 0;
+  gint64 start, end;
+  guint i, pick, fb;
+
+  fake_vpu_init (&vpu, config);
+  bk->init (priv, &vpu);
+  *checksum = 0;
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < config->frames; i++) {
+    GstBuffer *buffer;
+    FakeFrameBuffer *frame;
+    guint32 number;
+
+    (void) bk->in_vpu (priv);
+
+    /* decode one frame into a free framebuffer */
+    bk->input (priv, next++);
+    fb = vpu.free_fbs[--vpu.n_free];
+    vpu.reorder_fbs[vpu.n_reorder++] = fb;
+
+    if (vpu.n_reorder <= config->reorder && vpu.n_free > 0)
+      continue;
+
+    /* output any frame of the reorder window */
+    pick = fake_vpu_random (&vpu) % vpu.n_reorder;
+    fb = vpu.reorder_fbs[pick];
+    vpu.reorder_fbs[pick] = vpu.reorder_fbs[--vpu.n_reorder];
+
+    buffer = bk->output (priv, &vpu.frames[fb], &number);
+    if (buffer != vpu.buffers[fb])
+      goto mismatch;
+    *checksum += number;
+    vpu.held_fbs[vpu.n_held++] = fb;
+
+    /* downstream gives the oldest back */
+    if (vpu.n_held > config->hold || vpu.n_free == 0) {
+      fb = vpu.held_fbs[0];
+      memmove (vpu.held_fbs, vpu.held_fbs + 1,
+          (--vpu.n_held) * sizeof (guint));
+      frame = bk->release (priv, vpu.buffers[fb]);
+      if (frame != &vpu.frames[fb])
+        goto mismatch;
+      vpu.free_fbs[vpu.n_free++] = fb;
+    }
+  }
+  end = g_get_monotonic_time ();
+
+  bk->clear (priv);
+  fake_vpu_clear (&vpu);
+
+  return (end - start) * 1000.0 / MAX (config->frames, 1);
+
+mismatch:
+  g_print ("%s: buffer and framebuffer out of sync at frame %u\n", bk->name,
+      i);
+  bk->clear (priv);
+  fake_vpu_clear (&vpu);
+  return 0;
+}
+
+static void
+print_help ()
+{
+  g_print ("options :\n");
+  g_print ("    --frames=N          Frames to decode (default 2000000)\n");
+  g_print ("    --buffers=N         Framebuffers registered to the VPU (default 32)\n");
+  g_print ("    --reorder=N         Frames the VPU holds for reordering (default 16)\n");
+  g_print ("    --hold=N            Frames held downstream (default 4)\n");
+}
+
+static gboolean
+parse_options (VpuSlotBenchConfig * config, gint argc, gchar * argv[])
+{
+  struct
+  {
+    const gchar *name;
+    guint *uint_value;
+  } table[] = {
+    {"--frames", &config->frames},
+    {"--buffers", &config->buffers},
+    {"--reorder", &config->reorder},
+    {"--hold", &config->hold},
+  };
+  gint i, j;
+
+  config->frames = 2000000;
+  config->buffers = 32;
+  config->reorder = 16;
+  config->hold = 4;
+
+  for (i = 1; i < argc; i++) {
+    gchar *value = strchr (argv[i], '=');
+    gsize len = value ? (gsize) (value - argv[i]) : strlen (argv[i]);
+
+    for (j = 0; j < G_N_ELEMENTS (table); j++) {
+      if ((strlen (table[j].name) == len)
+          && (strncmp (argv[i], table[j].name, len) == 0))
+        break;
+    }
+    if ((j == G_N_ELEMENTS (table)) || (value == NULL)) {
+      g_print ("Unknown option %s\n", argv[i]);
+      return FALSE;
+    }
+
+    *table[j].uint_value = strtoul (value + 1, NULL, 0);
+  }
+
+  if (config->buffers < 2 || config->reorder + config->hold >= config->buffers) {
+    g_print ("reorder + hold must be smaller than buffers\n");
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+gint
+main (gint argc, gchar * argv[])
+{
+  static const Bookkeeping legacy = {
+    "list/hash", legacy_init, legacy_input, legacy_in_vpu, legacy_output,
+    legacy_release, legacy_clear
+  };
+  static const Bookkeeping slots = {
+    "slots", slots_init, slots_input, slots_in_vpu, slots_output,
+    slots_release, slots_clear
+  };
+  VpuSlotBenchConfig config;
+  LegacyState legacy_state;
+  GstVpuDecSlots slots_state;
+  guint64 legacy_sum, slots_sum;
+  gdouble legacy_ns, slots_ns;
+
+  if (!parse_options (&config, argc, argv)) {
+    g_print ("Usage: %s [OPTIONS]\n", argv[0]);
+    print_help ();
+    return 1;
+  }
+
+  gst_init (NULL, NULL);
+
+  legacy_ns = run (&legacy, &legacy_state, &config, &legacy_sum);
+  slots_ns = run (&slots, &slots_state, &config, &slots_sum);
+  if (legacy_ns == 0 || slots_ns == 0)
+    return 1;
+  if (legacy_sum != slots_sum) {
+    g_print ("frame numbers differ: %" G_GUINT64_FORMAT " vs %"
+        G_GUINT64_FORMAT "\n", legacy_sum, slots_sum);
+    return 1;
+  }
+
+  g_print ("vpuslotbench %u frames, %u framebuffers, reorder %u, hold %u\n",
+      config.frames, config.buffers, config.reorder, config.hold);
+  g_print ("  list/hash        : %.1f ns/frame\n", legacy_ns);
+  g_print ("  slots            : %.1f ns/frame\n", slots_ns);
+  g_print ("  speedup          : %.2fx\n", legacy_ns / MAX (slots_ns, 1e-9));
+
+  return 0;
+}